@@ -0,0 +1,170 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// ====== Přehled ======
+// Streamovací CBOR enkodér (RFC 8949) pro strojová API (?fmt=cbor / Accept: application/cbor).
+// - zapisuje přes malý buffer rovnou do sinku (chunk HTTP odpovědi), celá odpověď se nikde nedrží,
+// - mapy/pole neznámé délky (beginMap()/beginArray() + end()) – počet položek není předem potřeba,
+// - čísla jdou binárně v nejkratší podobě (0–23 = 1 B, do 255 = 2 B, do 65535 = 3 B …).
+// API (beginMap/beginArray/key/value/end) odpovídá JsonStringWriter v .ino, takže stejnou
+// šablonu výpisu (např. diagnostiku) lze vyrenderovat do JSONu i do CBORu.
+// CborStream obalí writer do zdroje těla odpovědi (http::BodySource): dokument se generuje po
+// krocích, až když si server data dotahuje, takže velikost výpisu nic nedrží v RAM ani neomezuje.
+// Nepoužívá Arduino typy; value() přijme cokoli s c_str()/length() (String, std::string).
+
+class CborWriter {
+public:
+  using Sink = std::function<void(const uint8_t *data, size_t len)>;
+  static constexpr size_t kBufSize = 512;
+
+  explicit CborWriter(Sink sink) : _sink(std::move(sink)) {}
+  ~CborWriter() { flush(); }
+
+  void beginMap()             { put(0xBF); }
+  void beginArray()           { put(0x9F); }
+  void beginMap(size_t n)     { head(5, n); }   // pevná délka – bez end()
+  void beginArray(size_t n)   { head(4, n); }
+  void end()                  { put(0xFF); }    // ukončí beginMap()/beginArray() bez délky
+
+  void key(const char *k)     { text(k, strlen(k)); }
+  template <typename T>
+  void field(const char *k, const T &v) { key(k); value(v); }
+  void null()                 { put(0xF6); }
+  void value(bool b)          { put(b ? 0xF5 : 0xF4); }
+  void value(const char *s)   { text(s, strlen(s)); }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type value(T v) {
+    if (std::is_signed<T>::value && v < 0) {
+      head(1, static_cast<uint64_t>(-(static_cast<int64_t>(v) + 1)));
+    } else {
+      head(0, static_cast<uint64_t>(v));
+    }
+  }
+
+  template <typename S>
+  auto value(const S &s) -> decltype(s.c_str(), s.length(), void()) { text(s.c_str(), s.length()); }
+
+  void text(const char *s, size_t len) {
+    head(3, len);
+    write(reinterpret_cast<const uint8_t *>(s), len);
+  }
+
+  void bytes(const uint8_t *data, size_t len) {
+    head(2, len);
+    write(data, len);
+  }
+
+  void flush() {
+    if (_len) {
+      _sink(_buf, _len);
+      _total += _len;
+      _len = 0;
+    }
+  }
+
+  size_t bytesWritten() const { return _total + _len; }
+
+private:
+  Sink    _sink;
+  uint8_t _buf[kBufSize];
+  size_t  _len = 0;
+  size_t  _total = 0;
+
+  void put(uint8_t b) {
+    if (_len == kBufSize) flush();
+    _buf[_len++] = b;
+  }
+
+  void write(const uint8_t *data, size_t len) {
+    if (len >= kBufSize) {           // velký blok rovnou, bez kopie přes buffer
+      flush();
+      _sink(data, len);
+      _total += len;
+      return;
+    }
+    if (_len + len > kBufSize) flush();
+    memcpy(_buf + _len, data, len);
+    _len += len;
+  }
+
+  // Hlavička položky: major type (3 b) + délka/hodnota v nejkratším kódování.
+  void head(uint8_t major, uint64_t v) {
+    const uint8_t m = static_cast<uint8_t>(major << 5);
+    uint8_t tmp[9];
+    size_t n;
+    if (v < 24) {
+      tmp[0] = static_cast<uint8_t>(m | v);
+      n = 1;
+    } else if (v <= 0xFF) {
+      tmp[0] = m | 24;
+      tmp[1] = static_cast<uint8_t>(v);
+      n = 2;
+    } else if (v <= 0xFFFF) {
+      tmp[0] = m | 25;
+      n = 3;
+    } else if (v <= 0xFFFFFFFFULL) {
+      tmp[0] = m | 26;
+      n = 5;
+    } else {
+      tmp[0] = m | 27;
+      n = 9;
+    }
+    if (n > 2) {
+      for (size_t i = n - 1; i > 0; --i) {   // big-endian
+        tmp[i] = static_cast<uint8_t>(v);
+        v >>= 8;
+      }
+    }
+    write(tmp, n);
+  }
+};
+
+// CBOR dokument jako BodySource: step(w) se volá, dokud vrací true, a pokaždé dopíše další kus
+// dokumentu (hlavičku, stránku záznamů…). V RAM je jen právě vygenerovaný kus.
+class CborStream {
+public:
+  using Step = std::function<bool(CborWriter &w)>;
+
+  explicit CborStream(Step step)
+      : _step(std::move(step)),
+        _w([this](const uint8_t *data, size_t len) { _pending.insert(_pending.end(), data, data + len); }) {}
+  CborStream(const CborStream &) = delete;
+  CborStream &operator=(const CborStream &) = delete;
+
+  // Rozhraní BodySource: 0 = konec dokumentu.
+  size_t read(uint8_t *buf, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+      if (_off >= _pending.size() && !refill()) break;
+      const size_t chunk = std::min(max - n, _pending.size() - _off);
+      memcpy(buf + n, _pending.data() + _off, chunk);
+      _off += chunk;
+      n += chunk;
+    }
+    return n;
+  }
+
+private:
+  Step                 _step;
+  std::vector<uint8_t> _pending;
+  size_t               _off = 0;
+  bool                 _done = false;
+  CborWriter           _w;     // až za _pending – sink do něj zapisuje i při destrukci
+
+  bool refill() {
+    _pending.clear();
+    _off = 0;
+    while (!_done && _pending.empty()) {   // krok bez výstupu stream neukončí
+      _done = !_step(_w);
+      _w.flush();
+    }
+    return !_pending.empty();
+  }
+};
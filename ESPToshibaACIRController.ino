@@ -1,6 +1,5 @@
 #include <Arduino.h>
 #include <WiFi.h>
-#include <WebServer.h>
 #include <WiFiManager.h>
 #include <Preferences.h>
 #include <LittleFS.h>
@@ -15,33 +14,23 @@
 #define IR_GLOBAL
 #include <IRremote.hpp>
 #include <vector>
-#include <unordered_map>
 #include <ctype.h>
 #include <algorithm>
 #include <type_traits>
 #include <utility>
 #include "ToshibaAC.h"
+#include "EventLog.h"
+#include "IrPipeline.h"
+#include "HttpServer.h"
+#include "PulseCache.h"
+#include "LearnedCatalog.h"
+#include "RawConsensus.h"
+#include "PulseCodec.h"
+#include "MqttClient.h"
+#include "CborWriter.h"
 
 // ======================== Datové typy a pomocné struktury ========================
 
-struct LearnedKey {
-  uint32_t value;
-  uint32_t addr;
-  uint8_t  bits;
-  bool operator==(const LearnedKey &o) const {
-    return value == o.value && addr == o.addr && bits == o.bits;
-  }
-};
-
-struct LearnedKeyHash {
-  size_t operator()(const LearnedKey &k) const {
-    size_t h = static_cast<size_t>(k.value);
-    h ^= (static_cast<size_t>(k.addr) << 1);
-    h ^= (static_cast<size_t>(k.bits) << 3);
-    return h;
-  }
-};
-
 struct IREvent {
   uint32_t ms;
   decode_type_t proto;
@@ -50,17 +39,26 @@ struct IREvent {
   uint32_t command;
   uint32_t value;
   uint32_t flags;
-  int16_t  learnedIndex; // -1 = žádná vazba
+  int32_t  learnedId;    // stabilní id naučeného kódu, -1 = žádná vazba
+  uint32_t seq;          // pořadové číslo v trvalém logu (jednoznačné i po přetečení millis())
 };
 
+struct LearnedSendHandler;
+
 struct LearnedCode {
-  uint32_t value;
-  uint8_t  bits;
-  uint32_t addr;
+  uint32_t id = 0;    // stabilní id ("id" v JSONL), 0 = kód mimo databázi
+  uint32_t value = 0;
+  uint8_t  bits = 0;
+  uint32_t addr = 0;
   String   proto;     // textový štítek protokolu (např. "NEC", "Toshiba-AC", ...)
   String   vendor;
   String   function;
   String   remote;
+  uint32_t flags = 0;
+  // Rozřešeno jednou při načtení cache (resolveLearnedSend) – odesílání ani „neznámý“ test
+  // už se štítkem nepracují.
+  decode_type_t             protoType = UNKNOWN;     // UNKNOWN = štítek neodpovídá podporovanému protokolu
+  const LearnedSendHandler *sendHandler = nullptr;   // nativní odeslání / fallback dle bitů; nullptr = jen RAW
 };
 
 struct LearnedLineDetails {
@@ -72,9 +70,10 @@ struct LearnedLineDetails {
 };
 
 // ======================== Globální proměnné ========================
-WebServer server(80);
+IrWebServer server(80);
 static const int8_t IR_TX_PIN_DEFAULT = 3;   // ESP32-C3: např. 4 (přizpůsob dle zapojení)
 static int8_t g_irTxPin = IR_TX_PIN_DEFAULT;
+static bool g_irTxReady = false;            // IrSender.begin() proběhl (jinak sendRaw nic nevyšle)
 static const uint8_t IR_RX_PIN = 4;         // ESP32-C3: ověřené 4/5/10
 ToshibaACIR toshiba;
 static const int8_t POWER_GND_PIN = -1;
@@ -82,15 +81,19 @@ static const int8_t POWER_VCC_PIN = -1;
 static const uint32_t DUP_FILTER_MS = 120;
 Preferences prefs;                 // NVS namespace: "irrecv"
 static const char* LEARN_FILE = "/learned.jsonl";
+static const char* LEARN_FILE_NEW = "/learned.jsonl.new";   // přepis databáze (update, delete, import)
+// Běžící exporty (/api/export čte LEARN_FILE průběžně): přepis databáze se do jejich konce odmítá,
+// připojení na konec souboru je bezpečné (export dočte i nové řádky).
+static uint8_t g_learnedExportsActive = 0;
+static bool learnedExportActive() { return g_learnedExportsActive > 0; }
 static bool g_showOnlyUnknown = false;
 static const size_t HISTORY_LEN = 10;
 static IREvent history[HISTORY_LEN];
 static size_t histWrite = 0;
 static size_t histCount = 0;
+static IrEventLog g_eventLog;      // trvalý log v LittleFS, history[] je nad ním „hot cache“
 static const uint32_t RAW_EVENT_MATCH_WINDOW_MS = 250;
-static std::vector<uint16_t> g_lastRaw;
-static uint16_t g_lastRawBuffer[RAW_BUFFER_LENGTH];
-static uint16_t g_lastRawLength = 0;
+static std::vector<uint16_t> g_lastRaw;   // až RAW_MAX_PULSES pulzů, odesílá se přímo odsud
 static uint8_t  g_lastRawKhz = 38;   // default
 static bool     g_lastRawValid = false;
 static uint32_t g_lastRawCaptureMs = 0;
@@ -111,8 +114,16 @@ static uint8_t  g_lastDecodeBits = 0;
 static uint32_t g_lastDecodePulseCount = 0;
 static String   g_lastDecodeSource = F("(none)");
 
-// Soubor pro RAW: /learned/raw_<index>.bin  (binárně: [1B khz][2B len LE][2B*len pulzy])
-static String rawPathForIndex(size_t index) {
+// Soubor pro RAW: /learned/id_<id>.bin  (binárně: [1B khz][2B len LE][2B*len pulzy])
+static String rawPathForId(uint32_t id) {
+  String p = F("/learned/id_");
+  p += String(id);
+  p += F(".bin");
+  return p;
+}
+
+// Starší pojmenování podle pořadí řádku v JSONL – jen pro migraci na id.
+static String rawPathForLegacyIndex(size_t index) {
   String p = F("/learned/raw_");
   p += String(index);
   p += F(".bin");
@@ -126,13 +137,13 @@ static bool fsEnsureRawDir() {
   return LittleFS.mkdir("/learned");
 }
 
-static bool fsSaveRawForIndex(size_t index, const uint16_t* buf, uint16_t len, uint8_t khz) {
+static bool fsSaveRawForId(uint32_t id, const uint16_t* buf, uint16_t len, uint8_t khz) {
   if (!fsEnsureRawDir()) {
     Serial.println(F("[FS] Nelze vytvořit adresář /learned pro RAW data."));
     return false;
   }
 
-  File f = LittleFS.open(rawPathForIndex(index), "w");
+  File f = LittleFS.open(rawPathForId(id), "w");
   if (!f) return false;
   f.write(&khz, 1);
   f.write((const uint8_t*)&len, 2);
@@ -141,8 +152,8 @@ static bool fsSaveRawForIndex(size_t index, const uint16_t* buf, uint16_t len, u
   return true;
 }
 
-static bool fsLoadRawForIndex(size_t index, std::vector<uint16_t> &out, uint8_t &khz) {
-  File f = LittleFS.open(rawPathForIndex(index), "r");
+static bool fsLoadRawForId(uint32_t id, std::vector<uint16_t> &out, uint8_t &khz) {
+  File f = LittleFS.open(rawPathForId(id), "r");
   if (!f) return false;
   uint8_t kh; uint16_t len;
   if (f.read(&kh, 1) != 1) { f.close(); return false; }
@@ -155,17 +166,16 @@ static bool fsLoadRawForIndex(size_t index, std::vector<uint16_t> &out, uint8_t
   return true;
 }
 
-static bool fsHasRaw(size_t index) {
-  return LittleFS.exists(rawPathForIndex(index));
+static bool fsHasRawForId(uint32_t id) {
+  return LittleFS.exists(rawPathForId(id));
 }
 
-// Pokud tvá API vrstva nevrací index nově vložené položky, použij getLearnedCount()
-extern size_t getLearnedCount(); // doplň, nebo přepiš dle tvé implementace
+extern size_t getLearnedCount();
 
-// Zavolej hned po IrReceiver.decode() úspěchu (tj. když máš vyplněné decodedIRData).
-// captureLastRawFromReceiver() se postará o bezpečné převzetí posledních pulsů.
+// Volá se ze spotřebitele pipeline pro každý nepotlačený dekódovaný rámec.
+// RAW k rámci převezme captureLastRawFromFrame().
 
-static void addToHistory(const IRData &d, int16_t learnedIndex) {
+static const IREvent &addToHistory(const IRData &d, int32_t learnedId) {
   IREvent e;
   e.ms      = millis();
   e.proto   = d.protocol;
@@ -174,32 +184,116 @@ static void addToHistory(const IRData &d, int16_t learnedIndex) {
   e.command = d.command;
   e.value   = d.decodedRawData;
   e.flags   = d.flags;
-  e.learnedIndex = learnedIndex;
-  history[histWrite] = e;
+  e.learnedId = learnedId;
+
+  IrLogRecord rec = {};
+  rec.uptimeMs     = e.ms;
+  rec.proto        = static_cast<uint16_t>(e.proto);
+  rec.address      = e.address;
+  rec.command      = e.command;
+  rec.value        = e.value;
+  rec.flags        = static_cast<uint16_t>(e.flags);
+  rec.learnedId    = e.learnedId;
+  rec.bits         = e.bits;
+  e.seq = g_eventLog.append(rec);
+
+  const size_t slot = histWrite;
+  history[slot] = e;
   histWrite = (histWrite + 1) % HISTORY_LEN;
   if (histCount < HISTORY_LEN) histCount++;
+  return history[slot];
+}
+
+// Událost z trvalého logu ve tvaru IREvent (pro /api/history_send mimo RAM ring).
+static IREvent eventFromLogRecord(const IrLogRecord &r) {
+  IREvent e;
+  e.ms           = r.uptimeMs;
+  e.proto        = static_cast<decode_type_t>(r.proto);
+  e.bits         = r.bits;
+  e.address      = r.address;
+  e.command      = r.command;
+  e.value        = r.value;
+  e.flags        = r.flags;
+  e.learnedId    = r.learnedId;
+  e.seq          = r.seq;
+  return e;
 }
 
 static bool hasLastUnknown = false;
-static IREvent lastUnknown = {0, UNKNOWN, 0, 0, 0, 0, 0, -1};
+static IREvent lastUnknown = {0, UNKNOWN, 0, 0, 0, 0, 0, -1, 0};
 static uint32_t lastValue = 0;
 static decode_type_t lastProto = UNKNOWN;
 static uint8_t lastBits = 0;
 static uint32_t lastMs = 0;
-static std::vector<LearnedCode> g_learnedCache;
-static std::unordered_map<LearnedKey, int16_t, LearnedKeyHash> g_learnedIndex;
-static bool g_learnedCacheValid = false;
+static bool parseLearnedLine(const String &line, LearnedCode &out);
+// V RAM jen index klíčů + tabulka stránek + LRU několika stránek metadat (viz LearnedCatalog.h)
+static LearnedCatalog<LearnedCode> g_learnedCatalog(LEARN_FILE, parseLearnedLine);
+static PulseBufferCache g_pulseCache;            // RAW připravené k odeslání, klíč = learned id
+static PulseBufferCache::Entry g_pulseUncached;  // buffer větší než rozpočet cache (jen poslední)
 // ===== RAW sniffer (nezávislý na knihovně) =====
 // Vstup je výstup IR demodulátoru (obvykle invertovaný: idle=HIGH, MARK=LOW)
-static const uint16_t RAW_MAX_PULSES = 512;       // stačí pro AC rámce
+static const uint16_t RAW_MAX_PULSES = 1024;      // AC rámec i se 2–3 opakováními
+static const uint16_t RAW_ISR_CODE_BYTES = 1024;  // ISR buffer: 1 B na pulz (dříve 512 × uint16_t)
 static const uint32_t RAW_FRAME_GAP_US = 15000;   // 15 ms = konec rámce
-
-volatile uint16_t g_isrPulses[RAW_MAX_PULSES];
-volatile uint16_t g_isrCount = 0;
+static const uint16_t RAW_GLITCH_US_DEFAULT = 100;   // kratší pulzy = rušení (slunce, zářivky)
+static const uint16_t RAW_GLITCH_US_MAX = 400;       // nejkratší reálné pulzy IR protokolů jsou ~450 µs
+// Předfiltr hotového rámce (jen konstantní počet porovnání, před kopírováním):
+static const uint16_t RAW_MIN_FRAME_PULSES = 12;     // kratší = zbytky rušení / NEC repeat
+static const uint16_t RAW_HEADER_MIN_US = 300;       // první MARK rámce
+static const uint16_t RAW_HEADER_MAX_US = 20000;
+
+volatile uint8_t  g_isrCodes[RAW_ISR_CODE_BYTES];   // 1B kódy pulzů, viz PulseCodec.h
+volatile uint16_t g_isrBytes = 0;          // zapsané bajty v g_isrCodes
+volatile uint16_t g_isrCount = 0;          // zapsané pulzy
 volatile uint32_t g_isrLastEdgeUs = 0;
 volatile int      g_isrLastLevel = -1;  // -1 = neumíme
 volatile bool     g_isrFrameReady = false;
-static uint16_t   g_rawScratch[RAW_MAX_PULSES];
+volatile uint16_t g_isrMinPulseUs = RAW_GLITCH_US_DEFAULT;   // 0 = bez potlačení (NVS "glitch_us")
+volatile uint32_t g_isrPending = 0;       // poslední délka, zatím nezapsaná (může se k ní přičíst glitch)
+volatile bool     g_isrMergeNext = false; // po lichém počtu glitchů patří další interval k pending
+volatile bool     g_isrOverflow = false;  // rámec přetekl g_isrCodes / RAW_MAX_PULSES
+volatile uint32_t g_isrGlitches = 0;
+
+// Statistika předfiltru snifferu (zapisuje jen přijímací task)
+static uint32_t g_snifferFrames = 0;
+static uint32_t g_snifferRejectShort = 0;
+static uint32_t g_snifferRejectLong = 0;
+static uint32_t g_snifferRejectHeader = 0;
+static uint32_t g_snifferRejectedPulses = 0;
+
+// ===== Přijímací pipeline =====
+// task ir-rx (IrRxPipeline):       capture + decode → fronta rámců
+// loop():                          match → history/log → g_irNotify (stejný kontext jako web, bez zámků nad DB)
+// irNotifyTask:                    výpis na Serial (pomalý UART nebrzdí příjem ani web)
+// Vysílání (loop) běží v IrTxScope: task ir-rx zatím stojí a přijímač je zastavený.
+enum class IrFrameKind : uint8_t { Sniffer, Decoded };
+
+// RAW jde frontou v kompaktní podobě (~1 KB na rámec místo 2 KB s uint16_t µs), na µs ho
+// rozbalí až spotřebitel (irFrameRawUs) do jednoho sdíleného bufferu:
+//   Sniffer … kódy PulseCodec.h přímo z g_isrCodes (1 B na pulz, dlouhé mezery 3 B),
+//   Decoded … 8bit ticky IRremote (µs = tick × MICROS_PER_TICK), bez ztráty přesnosti.
+struct IrFrame {
+  IrFrameKind kind;
+  uint32_t    capturedMs;
+  uint32_t    trailingGapUs;   // jen Sniffer
+  IRData      data;            // jen Decoded (rawDataPtr už neplatí – RAW je zkopírován níže)
+  uint16_t    rawLen;          // počet pulzů
+  uint16_t    codeBytes;       // obsazené bajty v codes
+  uint8_t     codes[RAW_ISR_CODE_BYTES];
+};
+static_assert(RAW_ISR_CODE_BYTES >= RAW_BUFFER_LENGTH, "ticky dekodéru se musí vejít do IrFrame::codes");
+
+static const size_t   IR_FRAME_QUEUE_LEN = 6;
+static const size_t   IR_NOTIFY_QUEUE_LEN = 16;
+static const size_t   IR_FRAMES_PER_SERVICE = 4;   // kolik rámců zpracuje loop() na jedno kolo
+typedef IrRxPipeline<IrFrame, IR_FRAME_QUEUE_LEN, IR_FRAMES_PER_SERVICE> IrPipeline;
+static IrRxPoll rawSnifferService(IrFrame &work);
+static IrRxPoll irDecodeService(IrFrame &work);
+static void processIrFrame(const IrFrame &frame);
+static IrPipeline g_irPipeline(rawSnifferService, irDecodeService, processIrFrame);
+typedef IrPipeline::TxScope IrTxScope;   // kolem každého IrSender.send*/toshiba.send
+static BoundedQueue<String, IR_NOTIFY_QUEUE_LEN> g_irNotify;
+static bool           g_irNotifyTaskRunning = false;
 
 // ======================== IRremote kompatibilita ========================
 
@@ -459,22 +553,6 @@ static uint16_t compensateAndStoreDispatch(uint8_t* dest8) {
   return rawLen;
 }
 
-// Zachováme kompatibilní název: vrací µs v 16bit poli (konverze z 8bit ticků)
-static uint16_t compensateAndStoreCompat(uint16_t *dest, uint16_t maxLen) {
-  if (!dest || maxLen == 0) return 0;
-  // dočasné 8bit pole pro ticky
-  uint8_t tmp8[RAW_BUFFER_LENGTH];
-  uint16_t n = compensateAndStoreDispatch(tmp8);
-  if (n > maxLen) n = maxLen;
-  for (uint16_t i = 0; i < n; ++i) {
-    // převod tick → µs (MICROS_PER_TICK definuje IRremote, obvykle 50)
-    uint32_t usec = (uint32_t)tmp8[i] * MICROS_PER_TICK;
-    if (usec > 0xFFFFU) usec = 0xFFFFU;
-    dest[i] = (uint16_t)usec;
-  }
-  return n;
-}
-
 // Pomocné: bezpečné čtení micros v ISR/loop
 static inline uint32_t micros_safe() { return micros(); }
 
@@ -487,7 +565,6 @@ static void finalizeRawCapture(const uint16_t *src, uint16_t count,
   if (!src || count == 0) {
     g_lastRawValid = false;
     g_lastRawKhz = 38;
-    g_lastRawLength = 0;
     g_lastRawSource = F("(missing)");
     g_lastRawCaptureMs = millis();
     return;
@@ -536,22 +613,25 @@ static void finalizeRawCapture(const uint16_t *src, uint16_t count,
   } else {
     g_lastRawSource = F("sniffer");
   }
+}
 
-  if (g_lastRawValid) {
-    const uint16_t toCopy = std::min<uint16_t>((uint16_t)g_lastRaw.size(), (uint16_t)RAW_BUFFER_LENGTH);
-    for (uint16_t i = 0; i < toCopy; ++i) {
-      g_lastRawBuffer[i] = g_lastRaw[i];
-    }
-    g_lastRawLength = toCopy;
-    if (g_lastRaw.size() > RAW_BUFFER_LENGTH) {
-      Serial.println(F("[RAW] Varování: zachycený rámec byl zkrácen kvůli RAW_BUFFER_LENGTH."));
-    }
-  } else {
-    g_lastRawLength = 0;
+// Přečte jeden pulz z g_isrCodes od pozice pos a posune ji.
+static uint16_t isrDecodeAt(uint16_t &pos) { return pulseCodeRead(g_isrCodes, pos); }
+
+static inline void IRAM_ATTR isrCommitPulse(uint32_t dur) {
+  uint16_t pos = g_isrBytes;
+  if (g_isrCount >= RAW_MAX_PULSES || pos + pulseCodeBytes(dur) > RAW_ISR_CODE_BYTES) {
+    g_isrOverflow = true;   // rámec je moc dlouhý, předfiltr ho zahodí
+    return;
   }
+  pulseCodeWrite(g_isrCodes, pos, dur);
+  g_isrBytes = pos;
+  g_isrCount++;
 }
 
-// ISR: ukládá délky pulsů v µs mezi hranami
+// ISR: ukládá délky pulsů mezi hranami (1B kódy, viz isrEncodePulse). Interval kratší než g_isrMinPulseUs je glitch –
+// přičte se k předchozímu pulzu a (po lichém počtu glitchů) i následující interval, protože
+// úroveň se vrátila. Proto se každá délka zapisuje až s další hranou (g_isrPending).
 void IRAM_ATTR irEdgeISR() {
   const uint32_t now = micros_safe();
   int lvl = digitalRead(IR_RX_PIN);    // na ESP32-C3 je to rychlé
@@ -561,42 +641,85 @@ void IRAM_ATTR irEdgeISR() {
     g_isrLastLevel = lvl;
     g_isrLastEdgeUs = now;
     g_isrCount = 0;
+    g_isrBytes = 0;
+    g_isrPending = 0;
+    g_isrMergeNext = false;
+    g_isrOverflow = false;
+    g_isrFrameReady = false;
     return;
   }
 
   uint32_t dur = now - g_isrLastEdgeUs;
   g_isrLastEdgeUs = now;
 
-  if (g_isrCount < RAW_MAX_PULSES) {
-    // saturace na 16-bit
-    if (dur > 0xFFFF) dur = 0xFFFF;
-    g_isrPulses[g_isrCount++] = (uint16_t)dur;
+  if (dur < g_isrMinPulseUs) {
+    g_isrPending += dur;
+    g_isrMergeNext = !g_isrMergeNext;
+    g_isrGlitches++;
+  } else if (g_isrMergeNext) {
+    g_isrPending += dur;
+    g_isrMergeNext = false;
   } else {
-    // přetečeno – rámec už je moc dlouhý, příště se uzavře gapem
+    if (g_isrPending) isrCommitPulse(g_isrPending);
+    g_isrPending = dur;
   }
 
   g_isrLastLevel = lvl;
 }
 
-// Služba pro loop(): uzavře rámec po mezeře a převede do g_lastRaw
-static void rawSnifferService() {
+// Předfiltr: vrací false pro rámec, který nemá smysl kopírovat (jen pár porovnání).
+static bool snifferFramePlausible(uint16_t n, bool overflow) {
+  if (overflow) {
+    g_snifferRejectLong++;
+  } else if (n < RAW_MIN_FRAME_PULSES) {
+    g_snifferRejectShort++;
+  } else {
+    uint16_t pos = 0;
+    const uint16_t mark = isrDecodeAt(pos);
+    const uint16_t space = isrDecodeAt(pos);
+    if (mark >= RAW_HEADER_MIN_US && mark <= RAW_HEADER_MAX_US && space <= RAW_HEADER_MAX_US) return true;
+    g_snifferRejectHeader++;
+  }
+  g_snifferRejectedPulses += n;
+  return false;
+}
+
+// Capture stage (task ir-rx): uzavře rámec po mezeře do pracovního rámce pipeline
+static IrRxPoll rawSnifferService(IrFrame &work) {
   // Pokud proběhly hrany a dlouho žádná nebyla => máme hotový rámec
-  if (g_isrCount > 0 && !g_isrFrameReady) {
+  if (g_isrLastLevel >= 0 && !g_isrFrameReady) {
     uint32_t gap = micros_safe() - g_isrLastEdgeUs;
     if (gap > RAW_FRAME_GAP_US) {
       noInterrupts();
-      uint16_t n = g_isrCount;
+      if (g_isrPending) isrCommitPulse(g_isrPending);
+      g_isrPending = 0;
+      const uint16_t n = g_isrCount;
+      const bool overflow = g_isrOverflow;
+      const bool plausible = snifferFramePlausible(n, overflow);
       uint32_t lastEdge = g_isrLastEdgeUs;
       uint32_t trailingGap = micros_safe() - lastEdge;
-      for (uint16_t i = 0; i < n; i++) g_rawScratch[i] = g_isrPulses[i];
+      const uint16_t bytes = g_isrBytes;
+      if (plausible) {
+        for (uint16_t i = 0; i < bytes; i++) work.codes[i] = g_isrCodes[i];   // bez dekódování
+      }
       g_isrCount = 0;
+      g_isrBytes = 0;
       g_isrLastLevel = -1;
       interrupts();
 
-      finalizeRawCapture(g_rawScratch, n, F("sniffer"), trailingGap);
-      g_isrFrameReady = true;  // jen pro debug; další hrana to zruší
+      // Rušení nepřepíše poslední dobrý g_lastRaw ani nezatíží frontu / loop()
+      if (!plausible) return IrRxPoll::Busy;
+      g_snifferFrames++;
+      work.kind = IrFrameKind::Sniffer;
+      work.capturedMs = millis();
+      work.trailingGapUs = trailingGap;
+      work.rawLen = n;
+      work.codeBytes = bytes;
+      g_isrFrameReady = true;  // první hrana dalšího rámce to zruší
+      return IrRxPoll::Frame;
     }
   }
+  return IrRxPoll::Idle;
 }
 
 static void recordSendDiagnostics(bool ok, const String &method,
@@ -633,22 +756,22 @@ static bool findProtoInHistory(uint32_t value, uint8_t bits, uint32_t addr, deco
 
 void invalidateLearnedCache();
 void ensureLearnedCacheLoaded();
-const LearnedCode* getLearnedByIndex(int16_t idx);
-int16_t findLearnedIndex(uint32_t value, uint8_t bits, uint32_t addr);
-const LearnedCode* findLearnedMatch(const IRData &d, int16_t *outIndex);
+bool getLearnedById(uint32_t id, LearnedCode &out);
+uint32_t learnedIdForOrdinal(uint32_t ordinal);
+int32_t findLearnedId(uint32_t value, uint8_t bits, uint32_t addr);
+bool findLearnedMatch(const IRData &d, LearnedCode &out);
 void refreshLearnedAssociations();
 
 static bool jsonExtractUint32(const String &line, const char *key, uint32_t &out);
 static bool jsonExtractString(const String &line, const char *key, String &out);
 static bool parseRawDurationsArg(const String &arg, std::vector<uint16_t> &out);
 
-String fsReadLearnedAsArrayJSON();
 bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags,
                      const String &protoStr, const String &vendor,
                      const String &functionName, const String &remoteLabel,
                      const std::vector<uint16_t> *rawOpt = nullptr,
-                     uint8_t rawKhz = 38);
-bool fsUpdateLearned(size_t index, const String &protoStr,
+                     uint8_t rawKhz = 38, int quality = -1);
+bool fsUpdateLearned(uint32_t id, const String &protoStr,
                      const String &vendor, const String &functionName, const String &remoteLabel);
 
 // RAW z FS
@@ -692,6 +815,62 @@ String jsonEscape(const String& s) {
   return r;
 }
 
+// Protějšek CborWriter pro JSON do String – stejné API, takže jedna šablona výpisu
+// (writeDiagnostics) vyrenderuje JSON i CBOR.
+class JsonStringWriter {
+public:
+  explicit JsonStringWriter(String &out) : _out(out) {}
+
+  void beginMap()   { open('{', true); }
+  void beginArray() { open('[', false); }
+  void end() {
+    _out += (_mapMask & (1UL << _depth)) ? '}' : ']';
+    _depth--;
+  }
+
+  void key(const char *k) {
+    separate();
+    _out += '"'; _out += k; _out += F("\":");
+    _afterKey = true;
+  }
+  template <typename T>
+  void field(const char *k, const T &v) { key(k); value(v); }
+
+  void null()                 { separate(); _out += F("null"); }
+  void value(bool b)          { separate(); _out += b ? "true" : "false"; }
+  void value(const char *s)   { value(String(s)); }
+  void value(const String &s) { separate(); _out += '"'; _out += jsonEscape(s); _out += '"'; }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type value(T v) {
+    separate();
+    if (std::is_signed<T>::value) _out += static_cast<long>(v);
+    else _out += static_cast<unsigned long>(v);
+  }
+
+private:
+  String  &_out;
+  uint8_t  _depth = 0;
+  uint32_t _mapMask = 0;     // bit = úroveň je objekt
+  uint32_t _itemMask = 0;    // bit = úroveň už má položku (před další patří čárka)
+  bool     _afterKey = false;
+
+  void separate() {
+    if (_afterKey) { _afterKey = false; return; }
+    const uint32_t bit = 1UL << _depth;
+    if (_itemMask & bit) _out += ',';
+    _itemMask |= bit;
+  }
+  void open(char c, bool map) {
+    separate();
+    _out += c;
+    _depth++;
+    const uint32_t bit = 1UL << _depth;
+    _itemMask &= ~bit;
+    if (map) _mapMask |= bit; else _mapMask &= ~bit;
+  }
+};
+
 const __FlashStringHelper* protoName(decode_type_t p) {
   switch (p) {
     case NEC:       return F("NEC");
@@ -710,6 +889,11 @@ const __FlashStringHelper* protoName(decode_type_t p) {
   }
 }
 
+// Název protokolu jako const char* (ESP32: F() řetězce leží v adresovatelné flash).
+static const char *protoLabel(decode_type_t p) {
+  return reinterpret_cast<const char *>(protoName(p));
+}
+
 // === Mapování label -> IRremote dekodér ===
 static decode_type_t parseProtoLabelRelaxed(const String &sIn) {
   String s = sIn; s.trim(); s.toUpperCase();
@@ -727,135 +911,159 @@ static decode_type_t parseProtoLabelRelaxed(const String &sIn) {
   return UNKNOWN;
 }
 
+// === Tabulka odesílačů – parametry se berou z value/bits/addr podle pravidla protokolu ===
+static void sendLearnedNEC(const LearnedCode &e)   { IrSender.sendNEC((unsigned long)e.value, (int)e.bits); }
+static void sendLearnedSony(const LearnedCode &e)  { IrSender.sendSony((unsigned long)e.value, (int)e.bits); }
+static void sendLearnedRC5(const LearnedCode &e)   { IrSender.sendRC5((unsigned long)e.value, (int)e.bits); }
+static void sendLearnedRC6(const LearnedCode &e)   { IrSender.sendRC6((unsigned long)e.value, (int)e.bits); }
+static void sendLearnedJVC(const LearnedCode &e)   { IrSender.sendJVC((unsigned long)e.value, (int)16, false); }
+static void sendLearnedLG(const LearnedCode &e)    { IrSender.sendLG((unsigned long)e.value, (int)e.bits); }
+static void sendLearnedSamsung(const LearnedCode &e) {
+  uint16_t a = (e.addr) ? (uint16_t)e.addr : (uint16_t)(e.value >> 16);
+  uint16_t c = (uint16_t)(e.value & 0xFFFF);
+  IrSender.sendSamsung(a, c, 0);
+}
+static void sendLearnedPanasonic(const LearnedCode &e) { IrSender.sendPanasonic((uint16_t)e.addr, (uint32_t)e.value, 0); }
+static void sendLearnedSharp(const LearnedCode &e)     { IrSender.sendSharp((uint16_t)e.addr, (uint16_t)(e.value & 0xFFFF), 0); }
+
+struct LearnedSendHandler {
+  decode_type_t proto;    // protokol, který handler vysílá (pro diagnostiku)
+  uint8_t       bits;     // u fallbacku délka, pro kterou platí; 0 = nativní položka
+  void        (*send)(const LearnedCode &e);
+  const char   *method;
+};
+
+// 1) nativní protokoly (když je známý label)
+static constexpr LearnedSendHandler kLearnedNativeSend[] = {
+  { NEC,       0, sendLearnedNEC,       "proto-NEC" },
+  { SONY,      0, sendLearnedSony,      "proto-SONY" },
+  { RC5,       0, sendLearnedRC5,       "proto-RC5" },
+  { RC6,       0, sendLearnedRC6,       "proto-RC6" },
+  { JVC,       0, sendLearnedJVC,       "proto-JVC" },
+  { LG,        0, sendLearnedLG,        "proto-LG" },
+  { SAMSUNG,   0, sendLearnedSamsung,   "proto-SAMSUNG" },
+  { PANASONIC, 0, sendLearnedPanasonic, "proto-PANASONIC" },
+  { SHARP,     0, sendLearnedSharp,     "proto-SHARP" },
+};
+
+// 2) HEURISTICKÝ FALLBACK pro UNKNOWN bez RAW – volba podle počtu bitů
+static constexpr LearnedSendHandler kLearnedFallbackSend[] = {
+  { NEC,  32, sendLearnedNEC,  "fallback-NEC" },
+  { SONY, 12, sendLearnedSony, "fallback-SONY" },
+  { SONY, 15, sendLearnedSony, "fallback-SONY" },
+  { JVC,  16, sendLearnedJVC,  "fallback-JVC" },
+  { RC5,  20, sendLearnedRC5,  "fallback-RC5" },
+};
+
+// Doplní protoType/sendHandler; volá se při stavbě cache (a pro dočasné LearnedCode z událostí).
+static void resolveLearnedSend(LearnedCode &e, decode_type_t t) {
+  e.protoType = t;
+  e.sendHandler = nullptr;
+  for (const LearnedSendHandler &h : kLearnedNativeSend) {
+    if (h.proto == t) { e.sendHandler = &h; return; }
+  }
+  for (const LearnedSendHandler &h : kLearnedFallbackSend) {
+    if (h.bits == e.bits) { e.sendHandler = &h; return; }
+  }
+}
+
+static void resolveLearnedSend(LearnedCode &e) {
+  resolveLearnedSend(e, e.proto.length() ? parseProtoLabelRelaxed(e.proto) : UNKNOWN);
+}
+
 // === Core sender – zkus nativní protokol, jinak RAW ===
+// RAW přes globální IrSender; false = vysílač není inicializovaný nebo neplatný buffer
+// (IRremote sendRaw() nic nevrací, jinak by se chyba nedala poznat).
+static bool irSendRawPulses(const uint16_t *raw, size_t count, uint8_t khz, uint8_t repeats) {
+  if (!g_irTxReady || !raw || count < 2 || count > 0xFFFF) return false;
+  IrTxScope tx(g_irPipeline);
+  for (uint8_t r = 0; r <= repeats; r++) {
+    if (r) delay(60);
+    IrSender.sendRaw(raw, static_cast<uint16_t>(count), khz);
+  }
+  return true;
+}
+
+// Toshiba AC má vlastní IRsend, s přijímačem se ale střídá stejně.
+static bool toshibaSend(const ToshibaACIR::State &s) {
+  IrTxScope tx(g_irPipeline);
+  return toshiba.send(s);
+}
+
 static bool irSendLearnedCore(const LearnedCode &e, uint8_t repeats,
                               const std::vector<uint16_t>* rawOpt = nullptr,
                               uint8_t rawKhz = 38) {
-  auto doRepeats = [&](auto &&fnOnce){
-    for (uint8_t r=0; r<=repeats; r++){ fnOnce(); delay(40); }
-    return true;
-  };
-
   const bool hasRaw = rawOpt && !rawOpt->empty();
   const uint8_t rawFreq = rawKhz ? rawKhz : 38;
 
   if (hasRaw) {
-    IrSender.sendRaw(rawOpt->data(), static_cast<uint16_t>(rawOpt->size()), rawFreq);
-    for (uint8_t r = 0; r < repeats; r++) {
-      delay(60);
-      IrSender.sendRaw(rawOpt->data(), static_cast<uint16_t>(rawOpt->size()), rawFreq);
-    }
+    const bool ok = irSendRawPulses(rawOpt->data(), rawOpt->size(), rawFreq, repeats);
     if (rawOpt == &g_lastRaw) {
-      recordSendDiagnostics(true, F("raw-capture"), UNKNOWN, rawOpt->size(), rawFreq);
+      recordSendDiagnostics(ok, F("raw-capture"), UNKNOWN, rawOpt->size(), rawFreq);
     } else {
-      recordSendDiagnostics(true, F("raw-storage"), UNKNOWN, rawOpt->size(), rawFreq);
+      recordSendDiagnostics(ok, F("raw-storage"), UNKNOWN, rawOpt->size(), rawFreq);
     }
-    return true;
+    return ok;
   }
 
-  const decode_type_t t = parseProtoLabelRelaxed(e.proto.length() ? e.proto : String(F("UNKNOWN")));
-
-  // 1) nativní protokoly (když je známý label)
-  switch (t) {
-    case NEC:
-      doRepeats([&]{ IrSender.sendNEC((unsigned long)e.value, (int)e.bits); });
-      recordSendDiagnostics(true, F("proto-NEC"), t, 0, 0);
-      return true;
-    case SONY:
-      doRepeats([&]{ IrSender.sendSony((unsigned long)e.value, (int)e.bits); });
-      recordSendDiagnostics(true, F("proto-SONY"), t, 0, 0);
-      return true;
-    case RC5:
-      doRepeats([&]{ IrSender.sendRC5((unsigned long)e.value, (int)e.bits); });
-      recordSendDiagnostics(true, F("proto-RC5"), t, 0, 0);
-      return true;
-    case RC6:
-      doRepeats([&]{ IrSender.sendRC6((unsigned long)e.value, (int)e.bits); });
-      recordSendDiagnostics(true, F("proto-RC6"), t, 0, 0);
-      return true;
-    case JVC:
-      doRepeats([&]{ IrSender.sendJVC((unsigned long)e.value, (int)16, false); });
-      recordSendDiagnostics(true, F("proto-JVC"), t, 0, 0);
-      return true;
-    case LG:
-      doRepeats([&]{ IrSender.sendLG((unsigned long)e.value, (int)e.bits); });
-      recordSendDiagnostics(true, F("proto-LG"), t, 0, 0);
-      return true;
-    case SAMSUNG: {
-      uint16_t a=(e.addr)?(uint16_t)e.addr:(uint16_t)(e.value>>16);
-      uint16_t c=(uint16_t)(e.value & 0xFFFF);
-      doRepeats([&]{ IrSender.sendSamsung(a,c,0); });
-      recordSendDiagnostics(true, F("proto-SAMSUNG"), t, 0, 0);
-      return true;
-    }
-    case PANASONIC:
-      doRepeats([&]{ IrSender.sendPanasonic((uint16_t)e.addr, (uint32_t)e.value, 0); });
-      recordSendDiagnostics(true, F("proto-PANASONIC"), t, 0, 0);
-      return true;
-    case SHARP:
-      doRepeats([&]{ IrSender.sendSharp((uint16_t)e.addr, (uint16_t)(e.value&0xFFFF), 0); });
-      recordSendDiagnostics(true, F("proto-SHARP"), t, 0, 0);
-      return true;
-    default: break;
+  const LearnedSendHandler *h = e.sendHandler;
+  if (!h) {
+    recordSendDiagnostics(false, F("fallback-failed"), e.protoType, 0, rawFreq);
+    return false;
   }
+  {
+    IrTxScope tx(g_irPipeline);
+    for (uint8_t r = 0; r <= repeats; r++) { h->send(e); delay(40); }
+  }
+  recordSendDiagnostics(true, h->method, h->proto, 0, 0);
+  return true;
+}
 
-  // 2) HEURISTICKÝ FALLBACK pro UNKNOWN bez RAW
-  switch (e.bits) {
-    case 32:
-      if (doRepeats([&]{ IrSender.sendNEC((unsigned long)e.value, 32); })) {
-        recordSendDiagnostics(true, F("fallback-NEC"), NEC, 0, 0);
-        return true;
-      }
-      if (e.addr || (e.value & 0xFFFF)) {
-        uint16_t a = e.addr ? (uint16_t)e.addr : (uint16_t)(e.value >> 16);
-        uint16_t c = (uint16_t)(e.value & 0xFFFF);
-        if (doRepeats([&]{ IrSender.sendSamsung(a, c, 0); })) {
-          recordSendDiagnostics(true, F("fallback-SAMSUNG"), SAMSUNG, 0, 0);
-          return true;
-        }
-      }
-      break;
-
-    case 12: case 15:
-      if (doRepeats([&]{ IrSender.sendSony((unsigned long)e.value, (int)e.bits); })) {
-        recordSendDiagnostics(true, F("fallback-SONY"), SONY, 0, 0);
-        return true;
-      }
-      break;
+// === RAW pro learned id přes LRU cache ===
+// Zdroj: id_<id>.bin, jinak vložené "raw" v JSONL. Cachuje se i výsledek „nemá RAW“, takže
+// opakované odeslání stejného kódu nesahá na flash. nullptr = neznámé id.
+static const PulseBufferCache::Entry *learnedPulsesForId(uint32_t id) {
+  const int32_t key = static_cast<int32_t>(id);
+  if (const PulseBufferCache::Entry *hit = g_pulseCache.get(key)) return hit;
+  LearnedCode e;
+  if (!getLearnedById(id, e)) return nullptr;
 
-    case 16:
-      if (doRepeats([&]{ IrSender.sendJVC((unsigned long)e.value, 16, false); })) {
-        recordSendDiagnostics(true, F("fallback-JVC"), JVC, 0, 0);
-        return true;
-      }
-      break;
+  std::vector<uint16_t> raw;
+  uint8_t khz = 38;
+  if (!fsLoadRawForId(id, raw, khz) || raw.empty()) {
+    uint16_t fq = 38;
+    raw.clear();
+    if (fsReadLearnedRawByValue(e.value, e.bits, e.addr, raw, fq) && !raw.empty()) {
+      khz = static_cast<uint8_t>(std::min<uint16_t>(fq ? fq : 38, 255));
+    } else {
+      raw.clear();
+    }
+  }
+  if (!khz) khz = 38;
 
-    case 20:
-      if (doRepeats([&]{ IrSender.sendRC5((unsigned long)e.value, 20); })) {
-        recordSendDiagnostics(true, F("fallback-RC5"), RC5, 0, 0);
-        return true;
-      }
-      break;
+  if (const PulseBufferCache::Entry *stored = g_pulseCache.put(key, khz, raw.data(), raw.size())) {
+    return stored;
   }
-  recordSendDiagnostics(false, F("fallback-failed"), t, 0, rawFreq);
-  return false;
+  g_pulseUncached.key = key;
+  g_pulseUncached.khz = khz;
+  g_pulseUncached.pulses.swap(raw);
+  return &g_pulseUncached;
 }
 
-// === Odeslání „podle indexu“ – načte případný RAW a zavolá Core ===
-static bool irSendLearnedByIndex(int index, uint8_t repeats) {
-  const LearnedCode* e = getLearnedByIndex(index);
-  if (!e) {
-    recordSendDiagnostics(false, F("index-invalid"), UNKNOWN, 0, 0);
+// === Odeslání „podle id“ – načte případný RAW (cache) a zavolá Core ===
+static bool irSendLearnedById(uint32_t id, uint8_t repeats) {
+  LearnedCode e;
+  if (!getLearnedById(id, e)) {
+    recordSendDiagnostics(false, F("id-invalid"), UNKNOWN, 0, 0);
     return false;
   }
 
-  std::vector<uint16_t> raw;
-  uint8_t khz = 38;
-  if (fsLoadRawForIndex(index, raw, khz)) {
-    return irSendLearnedCore(*e, repeats, &raw, khz);
+  const PulseBufferCache::Entry *p = learnedPulsesForId(id);
+  if (p && !p->pulses.empty()) {
+    return irSendLearnedCore(e, repeats, &p->pulses, p->khz);
   } else {
     // Bez RAW, zkus aspoň nativní dle labelu
-    return irSendLearnedCore(*e, repeats, nullptr, 38);
+    return irSendLearnedCore(e, repeats, nullptr, 38);
   }
 }
 
@@ -872,63 +1080,226 @@ static bool findProtoInHistory(uint32_t value, uint8_t bits, uint32_t addr, deco
 }
 
 void invalidateLearnedCache() {
-  g_learnedCacheValid = false;
-  g_learnedIndex.clear();
+  // offsety stránek se po přepisu souboru posunou; RAW se mažou cíleně podle id
+  g_learnedCatalog.invalidate();
+  g_pulseUncached.pulses.clear();
+}
+
+// Jeden řádek JSONL → LearnedCode (false = není to kód, chybí value/addr).
+static bool parseLearnedLine(const String &line, LearnedCode &entry) {
+  uint32_t tmp = 0;
+  if (!jsonExtractUint32(line, "value", entry.value)) return false;
+  if (!jsonExtractUint32(line, "addr", entry.addr)) return false;
+  if (jsonExtractUint32(line, "bits", tmp)) {
+    entry.bits = static_cast<uint8_t>(tmp & 0xFF);
+  }
+  if (!jsonExtractUint32(line, "id", entry.id)) entry.id = 0;
+  if (!jsonExtractUint32(line, "flags", entry.flags)) entry.flags = 0;
+  jsonExtractString(line, "proto", entry.proto);
+  jsonExtractString(line, "vendor", entry.vendor);
+  jsonExtractString(line, "function", entry.function);
+  jsonExtractString(line, "remote_label", entry.remote);
+  resolveLearnedSend(entry);
+  return true;
 }
 
-void ensureLearnedCacheLoaded() {
-  if (g_learnedCacheValid) return;
-  g_learnedCache.clear();
-  g_learnedIndex.clear();
+// Přepíše (nebo doplní na začátek objektu) "id" v řádku JSONL.
+static String learnedLineWithId(const String &line, uint32_t id) {
+  const int p = line.indexOf(F("\"id\":"));
+  if (p >= 0) {
+    int s = p + 5;
+    int e = s;
+    while (e < (int)line.length() && isdigit(line[e])) e++;
+    return line.substring(0, s) + String(id) + line.substring(e);
+  }
+  const int brace = line.indexOf('{');
+  if (brace < 0) return line;
+  String out = line.substring(0, brace + 1);
+  out += F("\"id\":");
+  out += id;
+  if (line.length() > (unsigned)(brace + 1) && line[brace + 1] != '}') out += ',';
+  out += line.substring(brace + 1);
+  return out;
+}
 
-  File f = LittleFS.open(LEARN_FILE, FILE_READ);
-  if (!f) { g_learnedCacheValid = true; return; }
+// Odebere z řádku JSONL vložené "raw":[...] a "freq" (záloha nese RAW v binárním záznamu).
+// RAW z řádku vrátí v raw/khz – použije se, když kód nemá id_<id>.bin.
+static String learnedLineWithoutRaw(const String &line, std::vector<uint16_t> &raw, uint8_t &khz) {
+  String out = line;
+  raw.clear();
+  const int r = out.indexOf(F(",\"raw\":["));
+  if (r >= 0) {
+    const int end = out.indexOf(']', r);
+    if (end > r) {
+      parseRawDurationsArg(out.substring(r + 8, end), raw);
+      out.remove(r, end + 1 - r);
+    }
+  }
+  const int q = out.indexOf(F(",\"freq\":"));
+  if (q >= 0) {
+    int e = q + 8;
+    while (e < (int)out.length() && isdigit(out[e])) e++;
+    uint32_t fq = strtoul(out.substring(q + 8, e).c_str(), nullptr, 10);
+    khz = static_cast<uint8_t>(fq > 0 && fq < 256 ? fq : 38);
+    out.remove(q, e - q);
+  } else {
+    khz = 38;
+  }
+  return out;
+}
 
-  while (f.available()) {
-    String line = f.readStringUntil('\n');
+// Id se nikdy nepoužije znovu (ani po smazání posledního kódu) – horní mez přidělených je v NVS
+// ("lid"). Rezervuje se po blocích LEARNED_ID_RESERVE_BLOCK, takže učení nezapisuje NVS u každého
+// kódu; po restartu se nepoužitý zbytek bloku přeskočí.
+// persist=false jen pro hromadné operace, které id uloží samy jednou na konci.
+static const uint32_t LEARNED_ID_RESERVE_BLOCK = 16;
+static uint32_t g_learnedIdReserved = 0;
+
+static void persistLearnedIdHighWater(uint32_t id) {
+  if (id <= g_learnedIdReserved) return;
+  g_learnedIdReserved = id;
+  prefs.putUInt("lid", id);
+}
+
+static uint32_t allocLearnedId(bool persist = true) {
+  const uint32_t id = g_learnedCatalog.nextId();
+  g_learnedCatalog.reserveId(id);
+  if (persist && id > g_learnedIdReserved) persistLearnedIdHighWater(id + LEARNED_ID_RESERVE_BLOCK - 1);
+  return id;
+}
+
+// Řádek JSONL, který katalog považuje za položku (má value + addr).
+static bool learnedLineIsEntry(const String &line) {
+  uint32_t tmp = 0;
+  return jsonExtractUint32(line, "value", tmp) && jsonExtractUint32(line, "addr", tmp);
+}
+
+// Řádek může obsahovat slepené objekty "}{" (starší zápis bez odřádkování).
+static void splitGluedObjects(const String &line, std::vector<String> &out) {
+  out.clear();
+  int start = 0;
+  while (start < (int)line.length()) {
+    int glued = line.indexOf(F("}{"), start);
+    String chunk = (glued >= 0) ? line.substring(start, glued + 1) : line.substring(start);
+    start = (glued >= 0) ? glued + 1 : line.length();
+    chunk.trim();
+    if (chunk.length()) out.push_back(chunk);
+  }
+}
+
+// Jednorázový převod starší databáze: každý kód dostane "id" (v pořadí souboru), slepené
+// objekty se rozdělí na samostatné řádky a raw_<pořadí>.bin se přejmenuje na id_<id>.bin.
+// Platná rostoucí id zůstávají; chybějící/nerostoucí dostanou nová nad nejvyšším známým id.
+static bool fsMigrateLearnedIds() {
+  File in = LittleFS.open(LEARN_FILE, FILE_READ);
+  if (!in) return false;
+
+  std::vector<String> chunks;
+  uint32_t lastId = std::max<uint32_t>(g_learnedIdReserved, g_learnedCatalog.nextId() - 1);
+  while (in.available()) {
+    String line = in.readStringUntil('\n');
+    splitGluedObjects(line, chunks);
+    for (const String &c : chunks) {
+      uint32_t id = 0;
+      if (jsonExtractUint32(c, "id", id)) lastId = std::max(lastId, id);
+    }
+  }
+  in.seek(0);
+
+  File out = LittleFS.open(LEARN_FILE_NEW, FILE_WRITE);
+  if (!out) { in.close(); return false; }
+
+  uint32_t keptMax = 0;
+  size_t legacyIndex = 0;
+  uint32_t migrated = 0;
+  bool ok = true;
+  std::vector<std::pair<size_t, uint32_t>> rawMoves;
+
+  while (ok && in.available()) {
+    String line = in.readStringUntil('\n');
     line.trim();
     if (!line.length()) continue;
-
-    LearnedCode entry = {};
-    uint32_t tmp = 0;
-    if (jsonExtractUint32(line, "value", entry.value)) {
-      if (jsonExtractUint32(line, "bits", tmp)) {
-        entry.bits = static_cast<uint8_t>(tmp & 0xFF);
-      }
-      if (jsonExtractUint32(line, "addr", entry.addr)) {
-        jsonExtractString(line, "proto", entry.proto);
-        jsonExtractString(line, "vendor", entry.vendor);
-        jsonExtractString(line, "function", entry.function);
-        jsonExtractString(line, "remote_label", entry.remote);
-        g_learnedCache.push_back(entry);
-        const int16_t idx = static_cast<int16_t>(g_learnedCache.size() - 1);
-        LearnedKey key{ entry.value, entry.addr, entry.bits };
-        g_learnedIndex.emplace(key, idx);
+    // dřívější cache brala z řádku jen první objekt – raw_<N>.bin patří k němu
+    const bool legacyEntry = learnedLineIsEntry(line);
+    splitGluedObjects(line, chunks);
+    for (size_t i = 0; i < chunks.size() && ok; ++i) {
+      String &chunk = chunks[i];
+      if (learnedLineIsEntry(chunk)) {
+        uint32_t id = 0;
+        if (!jsonExtractUint32(chunk, "id", id) || id <= keptMax) {
+          id = ++lastId;
+          chunk = learnedLineWithId(chunk, id);
+        }
+        keptMax = id;
+        if (i == 0 && legacyEntry) rawMoves.push_back({ legacyIndex, id });
+        migrated++;
       }
+      if (out.print(chunk) != chunk.length() || out.print('\n') != 1) ok = false;
     }
+    if (legacyEntry) legacyIndex++;
+  }
+  in.close();
+  out.close();
+
+  if (!ok) {
+    LittleFS.remove(LEARN_FILE_NEW);
+    return false;
+  }
+  LittleFS.remove(LEARN_FILE);
+  if (!LittleFS.rename(LEARN_FILE_NEW, LEARN_FILE)) return false;
+
+  for (const auto &mv : rawMoves) {
+    const String from = rawPathForLegacyIndex(mv.first);
+    if (!LittleFS.exists(from)) continue;
+    const String to = rawPathForId(mv.second);
+    if (LittleFS.exists(to)) LittleFS.remove(to);
+    LittleFS.rename(from.c_str(), to.c_str());
+  }
+  g_learnedCatalog.reserveId(lastId);
+  persistLearnedIdHighWater(lastId);
+
+  Serial.print(F("[FS] Learned databáze převedena na stabilní id: "));
+  Serial.print(migrated);
+  Serial.println(F(" kódů."));
+  return true;
+}
+
+void ensureLearnedCacheLoaded() {
+  if (g_learnedCatalog.built()) return;
+  g_learnedIdReserved = std::max<uint32_t>(g_learnedIdReserved, prefs.getUInt("lid", 0));
+  bool needsMigration = false;
+  bool complete = g_learnedCatalog.build(needsMigration);
+  if (needsMigration && fsMigrateLearnedIds()) {
+    complete = g_learnedCatalog.build(needsMigration);
+  }
+  g_learnedCatalog.reserveId(g_learnedIdReserved);
+  if (!complete) {
+    Serial.print(F("[FS] Learned databáze přesahuje index, nedostupných kódů: "));
+    Serial.println(g_learnedCatalog.skipped());
   }
-  f.close();
-  g_learnedCacheValid = true;
 }
 
-const LearnedCode* getLearnedByIndex(int16_t idx) {
+bool getLearnedById(uint32_t id, LearnedCode &out) {
   ensureLearnedCacheLoaded();
-  if (idx < 0 || (size_t)idx >= g_learnedCache.size()) return nullptr;
-  return &g_learnedCache[idx];
+  return g_learnedCatalog.getById(id, out);
 }
 
-int16_t findLearnedIndex(uint32_t value, uint8_t bits, uint32_t addr) {
+// Kompatibilita se starším API, kde "index" bylo pořadí kódu v databázi. 0 = neexistuje.
+uint32_t learnedIdForOrdinal(uint32_t ordinal) {
   ensureLearnedCacheLoaded();
-  LearnedKey key{ value, addr, bits };
-  auto it = g_learnedIndex.find(key);
-  if (it == g_learnedIndex.end()) return -1;
-  return it->second;
+  LearnedCode e;
+  return g_learnedCatalog.getByOrdinal(ordinal, e) ? e.id : 0;
 }
 
-const LearnedCode* findLearnedMatch(const IRData &d, int16_t *outIndex) {
-  int16_t idx = findLearnedIndex(d.decodedRawData, d.numberOfBits, d.address);
-  if (outIndex) *outIndex = idx;
-  return idx >= 0 ? &g_learnedCache[idx] : nullptr;
+int32_t findLearnedId(uint32_t value, uint8_t bits, uint32_t addr) {
+  ensureLearnedCacheLoaded();
+  LearnedCode e;
+  return g_learnedCatalog.findByKey(value, bits, addr, e) ? static_cast<int32_t>(e.id) : -1;
+}
+
+bool findLearnedMatch(const IRData &d, LearnedCode &out) {
+  ensureLearnedCacheLoaded();
+  return g_learnedCatalog.findByKey(d.decodedRawData, d.numberOfBits, d.address, out);
 }
 
 void refreshLearnedAssociations() {
@@ -985,64 +1356,29 @@ static bool parseRawDurationsArg(const String &arg, std::vector<uint16_t> &out)
   return !out.empty();
 }
 
-String fsReadLearnedAsArrayJSON() {
-  File f = LittleFS.open(LEARN_FILE, FILE_READ);
-  if (!f) return "[]";
-
-  String out;
-  out.reserve(256);
-  out += '[';
-  bool first = true;
-
-  while (f.available()) {
-    String line = f.readStringUntil('\n');
-    line.trim();
-    if (!line.length()) continue;
-
-    int start = 0;
-    while (start < line.length()) {
-      int glued = line.indexOf(F("}{"), start);
-      String chunk;
-      if (glued >= 0) {
-        chunk = line.substring(start, glued + 1);
-        start = glued + 1;
-      } else {
-        chunk = line.substring(start);
-        start = line.length();
-      }
-
-      chunk.trim();
-      if (!chunk.length()) continue;
-
-      if (!first) {
-        out += ',';
-      }
-      out += chunk;
-      first = false;
-    }
-  }
-
-  f.close();
-  out += ']';
-  return out;
-}
-
-
 // Pozn.: RAW je možné přidat dvěma způsoby – buď automaticky (přes g_lastRaw po zachycení rámce),
 // nebo explicitně předáním v parametru rawOpt (např. z API). Funkce se postará o serializaci do
-// JSON i o uložení binární kopie do LittleFS.
+// JSON i o uložení binární kopie do LittleFS. quality >= 0 se zapíše jako "quality" (učení z více stisků).
 bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags,
                      const String &protoStr, const String &vendor,
                      const String &functionName, const String &remoteLabel,
                      const std::vector<uint16_t> *rawOpt,
-                     uint8_t rawKhz) {
+                     uint8_t rawKhz, int quality) {
+  ensureLearnedCacheLoaded();
+  if (g_learnedCatalog.full()) {
+    Serial.println(F("[FS] Learned databáze je plná, kód se neuloží."));
+    return false;
+  }
   File f = LittleFS.open(LEARN_FILE, FILE_APPEND);
   if (!f) return false;
+  const uint32_t offset = static_cast<uint32_t>(f.size());
+  const uint32_t id = allocLearnedId();   // při chybě zápisu id propadne, znovu se nepoužije
 
   String line;
   line.reserve(1024);
   line += '{';
-  line += F("\"ts\":");         line += static_cast<uint32_t>(millis());
+  line += F("\"id\":");         line += id;
+  line += F(",\"ts\":");        line += static_cast<uint32_t>(millis());
   line += F(",\"proto\":\"");   line += protoStr;                   line += '\"';
   line += F(",\"value\":");     line += value;
   line += F(",\"bits\":");      line += static_cast<uint32_t>(bits);
@@ -1075,6 +1411,10 @@ bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags
     line += F(",\"freq\":");
     line += (uint32_t)freqKhz;
   }
+  if (quality >= 0) {           // jen kódy z učení z více stisků (RawConsensus)
+    line += F(",\"quality\":");
+    line += quality;
+  }
 
   line += F("}\n");
 
@@ -1083,18 +1423,18 @@ bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags
   bool ok = (w == line.length());
 
   if (!ok) {
+    invalidateLearnedCache();   // neúplný řádek na konci – index postavit znovu
     return false;
   }
 
-  invalidateLearnedCache();
-  refreshLearnedAssociations();
+  // Index se jen doplní (žádné přečtení celého souboru).
+  LearnedCode entry;
+  parseLearnedLine(line, entry);
+  g_learnedCatalog.noteAppended(entry, offset);
 
   if (rawSource && !rawSource->empty()) {
-    size_t count = getLearnedCount();
-    if (count > 0) {
-      if (!fsSaveRawForIndex(count - 1, rawSource->data(), (uint16_t)rawSource->size(), freqKhz)) {
-        Serial.println(F("[FS] Varování: RAW data se nepodařilo uložit do binárního souboru."));
-      }
+    if (!fsSaveRawForId(id, rawSource->data(), (uint16_t)rawSource->size(), freqKhz)) {
+      Serial.println(F("[FS] Varování: RAW data se nepodařilo uložit do binárního souboru."));
     }
     if (rawSource == &g_lastRaw) {
       g_lastRawValid = false;
@@ -1108,102 +1448,401 @@ bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags
   return true;
 }
 
-bool fsUpdateLearned(size_t index, const String &protoStr,
-                     const String &vendor, const String &functionName, const String &remoteLabel) {
-  File f = LittleFS.open(LEARN_FILE, FILE_READ);
-  if (!f) return false;
-
-  std::vector<String> lines;
-  while (f.available()) {
-    lines.push_back(f.readStringUntil('\n'));
+// Přepíše LEARN_FILE řádek po řádku přes LEARN_FILE_NEW (v RAM je vždy jen jeden řádek).
+// edit(line) vrací false pro řádek, který se má vynechat. found = řádek s daným id existoval.
+template <typename Edit>
+static bool fsRewriteLearned(uint32_t id, bool &found, Edit &&edit) {
+  found = false;
+  if (learnedExportActive()) return false;
+  File in = LittleFS.open(LEARN_FILE, FILE_READ);
+  if (!in) return false;
+  File out = LittleFS.open(LEARN_FILE_NEW, FILE_WRITE);
+  if (!out) { in.close(); return false; }
+
+  bool ok = true;
+  while (ok && in.available()) {
+    String line = in.readStringUntil('\n');
+    line.trim();
+    if (!line.length()) continue;
+    uint32_t lineId = 0;
+    if (!found && jsonExtractUint32(line, "id", lineId) && lineId == id) {
+      found = true;
+      if (!edit(line)) continue;
+    }
+    if (out.print(line) != line.length() || out.print('\n') != 1) ok = false;
   }
-  f.close();
-  if (index >= lines.size()) return false;
+  in.close();
+  out.close();
 
-  for (auto &ln : lines) {
-    ln.trim();
+  if (!ok || !found) {
+    LittleFS.remove(LEARN_FILE_NEW);
+    return false;
   }
+  LittleFS.remove(LEARN_FILE);
+  ok = LittleFS.rename(LEARN_FILE_NEW, LEARN_FILE);
+  invalidateLearnedCache();
+  g_pulseCache.invalidate(static_cast<int32_t>(id));
+  return ok;
+}
 
-  String line = lines[index];
-  if (!line.length()) return false;
-
-  auto replaceString = [&](const char* key, const String &val) {
-    String k = String("\"") + key + String("\":\"");
-    int p = line.indexOf(k);
-    if (p < 0) return;
-    int s = p + k.length();
-    int e = line.indexOf('"', s);
-    if (e < 0) return;
-    line = line.substring(0, s) + jsonEscape(val) + line.substring(e);
+bool fsUpdateLearned(uint32_t id, const String &protoStr,
+                     const String &vendor, const String &functionName, const String &remoteLabel) {
+  ensureLearnedCacheLoaded();
+  auto edit = [&](String &line) {
+    auto replaceString = [&](const char* key, const String &val) {
+      String k = String("\"") + key + String("\":\"");
+      int p = line.indexOf(k);
+      if (p < 0) return;
+      int s = p + k.length();
+      int e = line.indexOf('"', s);
+      if (e < 0) return;
+      line = line.substring(0, s) + jsonEscape(val) + line.substring(e);
+    };
+
+    replaceString("proto", protoStr);
+    replaceString("vendor", vendor);
+    replaceString("function", functionName);
+    replaceString("remote_label", remoteLabel);
+    return true;
   };
 
-  replaceString("proto", protoStr);
-  replaceString("vendor", vendor);
-  replaceString("function", functionName);
-  replaceString("remote_label", remoteLabel);
+  bool found = false;
+  const bool ok = fsRewriteLearned(id, found, edit);
+  refreshLearnedAssociations();
+  return ok;
+}
 
-  lines[index] = line;
+bool fsDeleteLearned(uint32_t id) {
+  ensureLearnedCacheLoaded();
+  bool found = false;
+  const bool ok = fsRewriteLearned(id, found, [](String &) { return false; });
+  if (ok) {
+    // id ostatních kódů (a tedy i jejich RAW soubory) se nemění
+    const String raw = rawPathForId(id);
+    if (LittleFS.exists(raw)) LittleFS.remove(raw);
+  }
+  refreshLearnedAssociations();
+  return ok;
+}
 
-  f = LittleFS.open(LEARN_FILE, FILE_WRITE);
-  if (!f) return false;
-  for (auto &ln : lines) {
-    if (!ln.length()) continue;
-    f.print(ln);
-    f.print('\n');
+// ======================== Záloha / obnova databáze ========================
+// Binární kontejner pro přenos celé learned databáze mezi zařízeními (little-endian):
+//   hlavička: "IRDB" | u8 verze | 3B rezerva
+//   záznam:   u8 'R' | u16 délka metadat | metadata (řádek JSONL) | u8 kHz | u16 počet pulzů | u16×N
+//   konec:    u8 'E' | u32 počet záznamů | u32 CRC32 všech předchozích bajtů
+// Metadata nesou "id" kódu; RAW se páruje podle něj (id_<id>.bin). Import přiděluje id nová.
+// Vložené "raw"/"freq" se z metadat odebírají – RAW jde vždy v binární části záznamu.
+static const uint8_t  BACKUP_VERSION = 1;
+static const char*    BACKUP_TMP_FILE = "/import.tmp";
+static const size_t   BACKUP_HEADER_LEN = 8;
+static const size_t   BACKUP_TRAILER_LEN = 9;
+static const uint16_t BACKUP_MAX_META_LEN = 0xFFFF;   // strop daný u16 délkou v kontejneru
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+  static const uint32_t kNibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i) {
+    crc = kNibble[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+    crc = kNibble[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+// Pull generátor binární zálohy: read() vrací další bajty kontejneru, 0 = konec.
+// Kóduje vždy jen jeden záznam najednou, takže paměť nezávisí na velikosti databáze
+// a HTTP server může export posílat průběžně vedle ostatních spojení.
+class LearnedExportStream {
+public:
+  LearnedExportStream() : _f(LittleFS.open(LEARN_FILE, FILE_READ)) { g_learnedExportsActive++; }
+  ~LearnedExportStream() { g_learnedExportsActive--; }
+  LearnedExportStream(const LearnedExportStream &) = delete;
+  LearnedExportStream &operator=(const LearnedExportStream &) = delete;
+
+  size_t read(uint8_t *buf, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+      if (_off >= _pending.size() && !refill()) break;
+      const size_t chunk = std::min(max - n, _pending.size() - _off);
+      memcpy(buf + n, _pending.data() + _off, chunk);
+      _off += chunk;
+      n += chunk;
+    }
+    return n;
+  }
+
+  uint32_t count() const { return _count; }
+  bool failed() const { return _failed; }
+
+private:
+  enum class Phase : uint8_t { Header, Records, Trailer, Done };
+
+  File                 _f;
+  std::vector<uint8_t> _pending;
+  std::vector<uint16_t> _raw;
+  size_t               _off = 0;
+  uint32_t             _crc = 0;
+  uint32_t             _count = 0;
+  Phase                _phase = Phase::Header;
+  bool                 _failed = false;
+
+  void put(const uint8_t *p, size_t n) { _pending.insert(_pending.end(), p, p + n); }
+  void putU8(uint8_t v)   { _pending.push_back(v); }
+  void putU16(uint16_t v) { putU8((uint8_t)v); putU8((uint8_t)(v >> 8)); }
+  void putU32(uint32_t v) { putU16((uint16_t)v); putU16((uint16_t)(v >> 16)); }
+
+  bool refill() {
+    _pending.clear();
+    _off = 0;
+    switch (_phase) {
+      case Phase::Header:
+        put(reinterpret_cast<const uint8_t*>("IRDB"), 4);
+        putU8(BACKUP_VERSION);
+        putU8(0); putU8(0); putU8(0);
+        _phase = _f ? Phase::Records : Phase::Trailer;
+        break;
+      case Phase::Records:
+        if (nextRecord()) break;
+        if (_failed) return false;
+        _phase = Phase::Trailer;
+        return refill();
+      case Phase::Trailer:
+        putU8('E');
+        putU32(_count);
+        _crc = crc32Update(_crc, _pending.data(), _pending.size());
+        putU32(_crc);   // CRC se do sebe nepočítá
+        _phase = Phase::Done;
+        return true;
+      case Phase::Done:
+        return false;
+    }
+    _crc = crc32Update(_crc, _pending.data(), _pending.size());
+    return true;
   }
-  f.close();
 
-  invalidateLearnedCache();
-  refreshLearnedAssociations();
+  bool nextRecord() {
+    while (_f.available()) {
+      String line = _f.readStringUntil('\n');
+      line.trim();
+      if (!line.length() || !learnedLineIsEntry(line)) continue;
+
+      uint8_t khz = 0;
+      uint32_t id = 0;
+      std::vector<uint16_t> inlineRaw;
+      uint8_t inlineKhz = 38;
+      line = learnedLineWithoutRaw(line, inlineRaw, inlineKhz);
+      if (line.length() > BACKUP_MAX_META_LEN) {
+        // Bez koncového záznamu import zálohu odmítne – raději než tiše vynechat kód.
+        _failed = true;
+        _f.close();
+        _phase = Phase::Done;
+        return false;
+      }
+      _raw.clear();
+      if (!jsonExtractUint32(line, "id", id) || !fsLoadRawForId(id, _raw, khz)) {
+        _raw.swap(inlineRaw);
+        khz = _raw.empty() ? 0 : inlineKhz;
+      }
+
+      _pending.reserve(8 + line.length() + _raw.size() * 2);
+      putU8('R');
+      putU16(static_cast<uint16_t>(line.length()));
+      put(reinterpret_cast<const uint8_t*>(line.c_str()), line.length());
+      putU8(khz);
+      putU16(static_cast<uint16_t>(_raw.size()));
+      for (uint16_t v : _raw) putU16(v);
+      _count++;
+      return true;
+    }
+    _f.close();
+    return false;
+  }
+};
+
+static bool fsReadExact(File &f, uint8_t *dst, size_t n, uint32_t *crc) {
+  if (f.read(dst, n) != n) return false;
+  if (crc) *crc = crc32Update(*crc, dst, n);
   return true;
 }
 
-bool fsDeleteLearned(size_t index) {
-  File f = LittleFS.open(LEARN_FILE, FILE_READ);
-  if (!f) return false;
+static bool fsReadU16(File &f, uint16_t &out, uint32_t *crc) {
+  uint8_t b[2];
+  if (!fsReadExact(f, b, 2, crc)) return false;
+  out = (uint16_t)(b[0] | (b[1] << 8));
+  return true;
+}
 
-  std::vector<String> lines;
-  while (f.available()) {
-    lines.push_back(f.readStringUntil('\n'));
+static bool fsReadU32(File &f, uint32_t &out, uint32_t *crc) {
+  uint8_t b[4];
+  if (!fsReadExact(f, b, 4, crc)) return false;
+  out = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+  return true;
+}
+
+// Projde kontejner záznam po záznamu a každý platný předá onRecord(meta, khz, pulses).
+// CRC se ověřuje až na konci, proto fsImportLearned() nejdřív volá průchod s no-op callbackem.
+template <typename OnRecord>
+static bool fsWalkBackup(const char *path, uint32_t &outCount, String &err, OnRecord &&onRecord) {
+  File f = LittleFS.open(path, FILE_READ);
+  if (!f) { err = F("no data"); return false; }
+
+  const size_t total = f.size();
+  if (total < BACKUP_HEADER_LEN + BACKUP_TRAILER_LEN) { f.close(); err = F("truncated"); return false; }
+
+  uint32_t crc = 0;
+  uint8_t hdr[BACKUP_HEADER_LEN];
+  if (!fsReadExact(f, hdr, sizeof(hdr), &crc) || memcmp(hdr, "IRDB", 4) != 0) {
+    f.close(); err = F("bad magic"); return false;
   }
+  if (hdr[4] != BACKUP_VERSION) { f.close(); err = F("unsupported version"); return false; }
+
+  std::vector<uint16_t> raw;
+  std::vector<char> meta;   // na haldě – volá se z HTTP handleru
+  uint32_t count = 0;
+  for (;;) {
+    uint8_t tag = 0;
+    if (!fsReadExact(f, &tag, 1, &crc)) { f.close(); err = F("truncated"); return false; }
+    if (tag == 'E') break;
+    if (tag != 'R') { f.close(); err = F("bad record"); return false; }
+
+    uint16_t metaLen = 0, rawLen = 0;
+    uint8_t khz = 0;
+    if (!fsReadU16(f, metaLen, &crc) || metaLen == 0 || metaLen > BACKUP_MAX_META_LEN) {
+      f.close(); err = F("bad record"); return false;
+    }
+    meta.resize(metaLen + 1);
+    if (!fsReadExact(f, reinterpret_cast<uint8_t*>(meta.data()), metaLen, &crc) ||
+        !fsReadExact(f, &khz, 1, &crc) ||
+        !fsReadU16(f, rawLen, &crc) || rawLen > RAW_MAX_PULSES) {
+      f.close(); err = F("bad record"); return false;
+    }
+    meta[metaLen] = '\0';
+    raw.resize(rawLen);
+    for (uint16_t i = 0; i < rawLen; ++i) {
+      if (!fsReadU16(f, raw[i], &crc)) { f.close(); err = F("truncated"); return false; }
+    }
+
+    String line(meta.data());
+    if (line.length() != metaLen || line.indexOf('\n') >= 0 || !learnedLineIsEntry(line)) {
+      f.close(); err = F("bad metadata"); return false;
+    }
+    if (!onRecord(line, khz, raw)) { f.close(); err = F("write failed"); return false; }
+    count++;
+  }
+
+  uint32_t declared = 0, storedCrc = 0;
+  bool ok = fsReadU32(f, declared, &crc) && fsReadU32(f, storedCrc, nullptr);
+  const bool atEnd = (f.position() == total);
   f.close();
+  if (!ok || !atEnd) { err = F("truncated"); return false; }
+  if (declared != count) { err = F("count mismatch"); return false; }
+  if (storedCrc != crc) { err = F("crc mismatch"); return false; }
+  outCount = count;
+  return true;
+}
 
-  if (index >= lines.size()) return false;
+// Zkopíruje LEARN_FILE do otevřeného souboru (import v režimu připojení staví novou verzi vedle).
+static bool fsCopyLearnedTo(File &out) {
+  File in = LittleFS.open(LEARN_FILE, FILE_READ);
+  if (!in) return true;   // prázdná databáze
+  uint8_t buf[256];
+  bool ok = true;
+  while (ok && in.available()) {
+    const size_t n = in.read(buf, sizeof(buf));
+    if (n == 0 || out.write(buf, n) != n) ok = false;
+  }
+  in.close();
+  return ok;
+}
 
-  for (auto &ln : lines) {
-    ln.trim();
+// Smaže id_<id>.bin s id < belowId – RAW kódů nahrazené databáze (importované id jsou vždy vyšší).
+// Jména se nejdřív posbírají, mazání během procházení adresáře LittleFS nemá rád.
+static void fsRemoveRawBelowId(uint32_t belowId) {
+  std::vector<uint32_t> stale;
+  File dir = LittleFS.open("/learned");
+  if (dir) {
+    File f = dir.openNextFile();
+    while (f) {
+      String name = f.name();
+      int slash = name.lastIndexOf('/');
+      if (slash >= 0) name = name.substring(slash + 1);
+      if (name.startsWith("id_") && name.endsWith(".bin")) {
+        const uint32_t id = (uint32_t)strtoul(name.c_str() + 3, nullptr, 10);
+        if (id && id < belowId) stale.push_back(id);
+      }
+      f.close();
+      f = dir.openNextFile();
+    }
+    dir.close();
   }
+  for (uint32_t id : stale) LittleFS.remove(rawPathForId(id));
+}
 
-  const size_t oldCount = lines.size();
-  lines.erase(lines.begin() + index);
+// Hromadný import: nejdřív kompletní validace (CRC), pak jediný zápis JSONL a jedno
+// přestavění indexu. replace=true nahradí celou databázi, jinak se záznamy připojí na konec.
+// Nová verze se vždy staví v LEARN_FILE_NEW (při připojení jako kopie + nové řádky) a nad
+// LEARN_FILE se přejmenuje až po úspěchu; při chybě zůstane databáze beze změny a RAW
+// soubory nových id se uklidí. Staré RAW se při nahrazení mažou až po přejmenování.
+// Každý importovaný kód dostane nové id (nad nejvyšším dosud přiděleným), takže se nikdy
+// nepotká s id, na které ukazuje historie událostí.
+bool fsImportLearned(const char *path, bool replace, uint32_t &outCount, String &err) {
+  if (learnedExportActive()) { err = F("export in progress"); return false; }
+  uint32_t count = 0;
+  auto noop = [](const String &, uint8_t, const std::vector<uint16_t> &) { return true; };
+  if (!fsWalkBackup(path, count, err, noop)) return false;
 
-  f = LittleFS.open(LEARN_FILE, FILE_WRITE);
-  if (!f) return false;
-  for (auto &ln : lines) {
-    if (!ln.length()) continue;
-    f.print(ln);
-    f.print('\n');
+  ensureLearnedCacheLoaded();
+  if ((replace ? 0 : g_learnedCatalog.count()) + count > LearnedCatalog<LearnedCode>::kMaxEntries) {
+    err = F("too many codes");
+    return false;
   }
-  f.close();
+  File out = LittleFS.open(LEARN_FILE_NEW, FILE_WRITE);
+  if (!out) { err = F("open failed"); return false; }
+  if (!fsEnsureRawDir()) { out.close(); LittleFS.remove(LEARN_FILE_NEW); err = F("raw dir"); return false; }
+  if (!replace && !fsCopyLearnedTo(out)) {
+    out.close();
+    LittleFS.remove(LEARN_FILE_NEW);
+    err = F("write failed");
+    return false;
+  }
+
+  std::vector<uint32_t> newIds;   // při chybě se jejich RAW soubory uklidí
+  auto apply = [&](const String &meta, uint8_t khz, const std::vector<uint16_t> &raw) {
+    const uint32_t id = allocLearnedId(false);
+    newIds.push_back(id);
+    const String line = learnedLineWithId(meta, id);
+    if (out.print(line) != line.length() || out.print('\n') != 1) return false;
+    if (!raw.empty()) {
+      if (!fsSaveRawForId(id, raw.data(), (uint16_t)raw.size(), khz ? khz : 38)) return false;
+    } else if (fsHasRawForId(id)) {
+      LittleFS.remove(rawPathForId(id));
+    }
+    return true;
+  };
+  bool ok = fsWalkBackup(path, count, err, apply);
+  out.close();
+  persistLearnedIdHighWater(g_learnedCatalog.nextId() - 1);
 
-  // Remove RAW capture for the deleted entry and shift subsequent files down.
-  String target = rawPathForIndex(index);
-  if (LittleFS.exists(target)) {
-    LittleFS.remove(target);
+  if (ok) {
+    ok = LittleFS.rename(LEARN_FILE_NEW, LEARN_FILE);   // přepíše původní soubor
+    if (!ok) err = F("rename failed");
   }
-  for (size_t i = index + 1; i < oldCount; ++i) {
-    String from = rawPathForIndex(i);
-    if (!LittleFS.exists(from)) continue;
-    String to = rawPathForIndex(i - 1);
-    if (LittleFS.exists(to)) {
-      LittleFS.remove(to);
+  if (!ok) {
+    LittleFS.remove(LEARN_FILE_NEW);
+    for (uint32_t id : newIds) {
+      if (fsHasRawForId(id)) LittleFS.remove(rawPathForId(id));
     }
-    LittleFS.rename(from.c_str(), to.c_str());
+  } else if (replace) {
+    fsRemoveRawBelowId(newIds.empty() ? g_learnedCatalog.nextId() : newIds.front());
   }
 
   invalidateLearnedCache();
+  g_pulseCache.clear();
   refreshLearnedAssociations();
-  return true;
+  outCount = ok ? count : 0;
+  return ok;
 }
 
 // ======================== RAW práce ze souboru ========================
@@ -1257,75 +1896,717 @@ static bool fsReadLearnedRawByValue(uint32_t value, uint8_t bits, uint32_t addr,
 // ======================== Odesílání naučeného (RAW-first) ========================
 
 static bool irSendLearned(const LearnedCode &e, uint8_t repeats) {
-  std::vector<uint16_t> raw;
-  uint8_t rawFreq = 38;
-  const std::vector<uint16_t>* rawPtr = nullptr;
-
-  int16_t idx = findLearnedIndex(e.value, e.bits, e.addr);
-  if (idx >= 0) {
-    if (fsLoadRawForIndex(static_cast<size_t>(idx), raw, rawFreq) && !raw.empty()) {
-      rawPtr = &raw;
+  const int32_t id = e.id ? static_cast<int32_t>(e.id) : findLearnedId(e.value, e.bits, e.addr);
+  if (id > 0) {
+    const PulseBufferCache::Entry *p = learnedPulsesForId(static_cast<uint32_t>(id));
+    if (p && !p->pulses.empty()) {
+      return irSendLearnedCore(e, repeats, &p->pulses, p->khz);
     }
+    return irSendLearnedCore(e, repeats, nullptr, 38);
   }
 
-  if (!rawPtr) {
-    uint16_t freqFromJson = rawFreq;
-    if (fsReadLearnedRawByValue(e.value, e.bits, e.addr, raw, freqFromJson) && !raw.empty()) {
-      rawFreq = (freqFromJson > 0)
-                  ? static_cast<uint8_t>(std::min<uint16_t>(freqFromJson, 255))
-                  : static_cast<uint8_t>(38);
-      rawPtr = &raw;
-    }
+  // Kód mimo databázi – zkusit ještě přímé hledání v JSONL (bez id se necachuje)
+  std::vector<uint16_t> raw;
+  uint16_t freqFromJson = 38;
+  if (fsReadLearnedRawByValue(e.value, e.bits, e.addr, raw, freqFromJson) && !raw.empty()) {
+    const uint8_t rawFreq = (freqFromJson > 0)
+                              ? static_cast<uint8_t>(std::min<uint16_t>(freqFromJson, 255))
+                              : static_cast<uint8_t>(38);
+    return irSendLearnedCore(e, repeats, &raw, rawFreq);
   }
-
-  return irSendLearnedCore(e, repeats, rawPtr, rawFreq);
+  return irSendLearnedCore(e, repeats, nullptr, 38);
 }
 
+// Celý rámec z g_lastRaw (dlouhé AC rámce až do RAW_MAX_PULSES, žádná kopie do menšího bufferu).
 static bool irSendLastRaw(uint8_t repeats) {
-  if (!g_lastRawValid || g_lastRawLength < 2) {
+  if (!g_lastRawValid || g_lastRaw.size() < 2) {
     recordSendDiagnostics(false, F("raw-capture-missing"), UNKNOWN, 0, g_lastRawKhz);
     return false;
   }
 
   Serial.print(F("[IR-TX] Posílám poslední zachycený RAW ("));
-  Serial.print(g_lastRawLength);
+  Serial.print((unsigned)g_lastRaw.size());
   Serial.print(F(" pulsů, "));
   Serial.print(g_lastRawKhz);
   Serial.println(F("kHz)"));
 
-  for (uint8_t r = 0; r <= repeats; ++r) {
-    IrSender.sendRaw(g_lastRawBuffer, g_lastRawLength, g_lastRawKhz);
-    if (r < repeats) delay(60);
+  const bool ok = irSendRawPulses(g_lastRaw.data(), g_lastRaw.size(), g_lastRawKhz, repeats);
+  recordSendDiagnostics(ok, F("raw-capture"), UNKNOWN, g_lastRaw.size(), g_lastRawKhz);
+  return ok;
+}
+
+
+// ======================== Dávkové odesílání ========================
+// Jedna dávka = JSON pole položek, např.
+//   [{"index":3,"repeat":1},{"type":"toshiba","power":0},{"raw":[9000,4500,560],"freq":38,"gap":100}]
+// Celá dávka se nejdřív zvaliduje a připraví (včetně načtení RAW z FS), teprve pak se vysílá
+// položka za položkou bez další práce se souborovým systémem.
+// Vysílá se synchronně v loop() (HTTP handler / MQTT callback), proto má dávka strop celkové
+// délky: odhad vysílání + opakování + mezer nad SEND_BATCH_MAX_DURATION_MS se odmítne předem.
+static const size_t   SEND_BATCH_MAX_ITEMS = 32;
+static const uint16_t SEND_BATCH_DEFAULT_GAP_MS = 40;
+static const uint16_t SEND_BATCH_MAX_GAP_MS = 2000;
+static const uint32_t SEND_BATCH_MAX_DURATION_MS = 2500;
+static const uint16_t SEND_BATCH_EST_NATIVE_MS = 120;    // protokolový rámec + delay(40) z handleru
+static const uint16_t SEND_BATCH_EST_TOSHIBA_MS = 200;   // dva rámce + mezera
+
+enum class SendBatchKind : uint8_t { Learned, Toshiba, Raw };
+
+struct SendBatchItem {
+  SendBatchKind kind = SendBatchKind::Learned;
+  int32_t  id = -1;
+  uint8_t  repeats = 0;
+  uint16_t gapMs = SEND_BATCH_DEFAULT_GAP_MS;
+  ToshibaACIR::State ac;
+  std::vector<uint16_t> raw;
+  uint8_t  khz = 38;
+};
+
+struct SendBatchResult {
+  bool   ok;
+  String method;
+};
+
+bool toshibaModeFromString(String m, ToshibaACIR::Mode &out) {
+  m.toLowerCase();
+  if (m == "auto" || m == "fan") out = ToshibaACIR::Mode::AUTO;
+  else if (m == "cool") out = ToshibaACIR::Mode::COOL;
+  else if (m == "heat") out = ToshibaACIR::Mode::HEAT;
+  else if (m == "dry") out = ToshibaACIR::Mode::DRY;
+  else return false;
+  return true;
+}
+
+bool toshibaFanFromString(String f, ToshibaACIR::Fan &out) {
+  f.toLowerCase();
+  if (f == "auto") out = ToshibaACIR::Fan::AUTO;
+  else if (f == "1") out = ToshibaACIR::Fan::F1;
+  else if (f == "2") out = ToshibaACIR::Fan::F2;
+  else if (f == "3") out = ToshibaACIR::Fan::F3;
+  else if (f == "4") out = ToshibaACIR::Fan::F4;
+  else if (f == "5") out = ToshibaACIR::Fan::F5;
+  else return false;
+  return true;
+}
+
+const char *toshibaModeName(ToshibaACIR::Mode m) {
+  switch (m) {
+    case ToshibaACIR::Mode::COOL: return "cool";
+    case ToshibaACIR::Mode::DRY:  return "dry";
+    case ToshibaACIR::Mode::HEAT: return "heat";
+    default:                      return "auto";
   }
+}
+
+const char *toshibaFanName(ToshibaACIR::Fan f) {
+  switch (f) {
+    case ToshibaACIR::Fan::F1: return "1";
+    case ToshibaACIR::Fan::F2: return "2";
+    case ToshibaACIR::Fan::F3: return "3";
+    case ToshibaACIR::Fan::F4: return "4";
+    case ToshibaACIR::Fan::F5: return "5";
+    default:                   return "auto";
+  }
+}
+
+// Poslední úspěšně odeslaný stav AC (IR je jednosměrné – skutečný stav jednotky neznáme).
+static ToshibaACIR::State g_acState;
+static bool     g_acStateValid = false;
+static uint32_t g_acStateChangedMs = 0;
+static uint32_t g_acStateVersion = 0;    // roste s každou změnou (MQTT publikuje jen novou verzi)
+
+void noteToshibaState(const ToshibaACIR::State &s) {
+  if (g_acStateValid && s.powerOn == g_acState.powerOn && s.mode == g_acState.mode &&
+      s.fan == g_acState.fan && s.tempC == g_acState.tempC) {
+    return;
+  }
+  g_acState = s;
+  g_acStateValid = true;
+  g_acStateChangedMs = millis();
+  g_acStateVersion++;
+}
+
+static String toshibaStateJson(const ToshibaACIR::State &s) {
+  String out; out.reserve(64);
+  out += F("{\"power\":"); out += s.powerOn ? 1 : 0;
+  out += F(",\"mode\":\""); out += toshibaModeName(s.mode);
+  out += F("\",\"temp\":"); out += static_cast<uint32_t>(s.tempC);
+  out += F(",\"fan\":\""); out += toshibaFanName(s.fan);
+  out += F("\"}");
+  return out;
+}
+
+// Odstraní bílé znaky mimo řetězce, aby na výsledek šly použít jsonExtract* helpery.
+static String jsonCompact(const String &in) {
+  String out; out.reserve(in.length());
+  bool inStr = false;
+  for (size_t i = 0; i < in.length(); ++i) {
+    char c = in[i];
+    if (inStr) {
+      out += c;
+      if (c == '\\' && i + 1 < in.length()) { out += in[++i]; }
+      else if (c == '"') inStr = false;
+      continue;
+    }
+    if (c == '"') inStr = true;
+    if (!isspace((unsigned char)c)) out += c;
+  }
+  return out;
+}
+
+// Rozdělí (kompaktní) JSON pole objektů na jednotlivé objekty.
+static bool jsonSplitTopLevelObjects(const String &arr, std::vector<String> &out) {
+  out.clear();
+  const size_t n = arr.length();
+  if (n < 2 || arr[0] != '[' || arr[n - 1] != ']') return false;
+  int depth = 0;
+  bool inStr = false;
+  size_t start = 0;
+  for (size_t i = 1; i + 1 < n; ++i) {
+    char c = arr[i];
+    if (inStr) {
+      if (c == '\\') ++i;
+      else if (c == '"') inStr = false;
+      continue;
+    }
+    if (c == '"') {
+      if (depth == 0) return false;
+      inStr = true;
+    } else if (c == '{' || c == '[') {
+      if (depth == 0) {
+        if (c != '{') return false;
+        start = i;
+      }
+      depth++;
+    } else if (c == '}' || c == ']') {
+      if (--depth < 0) return false;
+      if (depth == 0) out.push_back(arr.substring(start, i + 1));
+    } else if (depth == 0 && c != ',') {
+      return false;
+    }
+  }
+  return depth == 0 && !inStr;
+}
 
-  recordSendDiagnostics(true, F("raw-capture"), UNKNOWN, g_lastRawLength, g_lastRawKhz);
+// Hodnota klíče jako text – funguje pro "řetězec" i holý token (číslo, true/false).
+static bool jsonExtractToken(const String &obj, const char *key, String &out) {
+  if (jsonExtractString(obj, key, out)) return true;
+  String k = String("\"") + key + String("\":");
+  int p = obj.indexOf(k);
+  if (p < 0) return false;
+  p += k.length();
+  int e = p;
+  while (e < (int)obj.length() && obj[e] != ',' && obj[e] != '}' && obj[e] != ']') e++;
+  if (e == p) return false;
+  out = obj.substring(p, e);
   return true;
 }
 
+static bool parseSendBatchItem(const String &obj, SendBatchItem &it, String &err) {
+  String type, tok;
+  jsonExtractString(obj, "type", type);
+  type.toLowerCase();
+  if (!type.length()) {
+    if (obj.indexOf(F("\"raw\":")) >= 0) type = F("raw");
+    else if (obj.indexOf(F("\"id\":")) >= 0 || obj.indexOf(F("\"index\":")) >= 0) type = F("learned");
+    else type = F("toshiba");
+  }
+
+  uint32_t v = 0;
+  if (jsonExtractUint32(obj, "repeat", v)) it.repeats = (uint8_t)std::min<uint32_t>(v, 3);
+  if (jsonExtractUint32(obj, "gap", v)) it.gapMs = (uint16_t)std::min<uint32_t>(v, SEND_BATCH_MAX_GAP_MS);
+
+  if (type == "learned") {
+    it.kind = SendBatchKind::Learned;
+    // "id" = stabilní id; "index" = pořadí v databázi (starší klienti)
+    if (jsonExtractUint32(obj, "id", v)) {
+      if (!v || v > 0x7FFFFFFFUL) { err = F("invalid id"); return false; }
+    } else if (jsonExtractUint32(obj, "index", v)) {
+      v = learnedIdForOrdinal(v);
+      if (!v) { err = F("unknown index"); return false; }
+    } else {
+      err = F("missing id"); return false;
+    }
+    it.id = (int32_t)v;
+    LearnedCode e;
+    if (!getLearnedById(v, e)) { err = F("unknown id"); return false; }
+    const PulseBufferCache::Entry *p = learnedPulsesForId(v);
+    if (p && !p->pulses.empty()) {
+      it.raw = p->pulses;
+      it.khz = p->khz;
+    }
+    return true;
+  }
+
+  if (type == "toshiba") {
+    it.kind = SendBatchKind::Toshiba;
+    if (jsonExtractToken(obj, "power", tok)) {
+      tok.toLowerCase();
+      it.ac.powerOn = !(tok == "0" || tok == "false" || tok == "off");
+    }
+    if (jsonExtractToken(obj, "mode", tok) && !toshibaModeFromString(tok, it.ac.mode)) {
+      err = F("invalid mode"); return false;
+    }
+    if (jsonExtractUint32(obj, "temp", v)) it.ac.tempC = (uint8_t)constrain(v, 17U, 30U);
+    if (jsonExtractToken(obj, "fan", tok) && !toshibaFanFromString(tok, it.ac.fan)) {
+      err = F("invalid fan"); return false;
+    }
+    return true;
+  }
+
+  if (type == "raw") {
+    it.kind = SendBatchKind::Raw;
+    int p = obj.indexOf(F("\"raw\":["));
+    int e = (p >= 0) ? obj.indexOf(']', p) : -1;
+    if (e < 0 || !parseRawDurationsArg(obj.substring(p + 6, e + 1), it.raw) || it.raw.size() < 2) {
+      err = F("invalid raw list"); return false;
+    }
+    if (jsonExtractUint32(obj, "freq", v)) it.khz = (uint8_t)constrain(v, 15U, 80U);
+    return true;
+  }
+
+  err = F("unknown type");
+  return false;
+}
+
+// Odhad doby vysílání položky včetně opakování (bez mezery za položkou).
+static uint32_t sendBatchItemAirtimeMs(const SendBatchItem &it) {
+  const uint32_t sends = static_cast<uint32_t>(it.repeats) + 1;
+  if (!it.raw.empty()) {
+    uint32_t us = 0;
+    for (uint16_t d : it.raw) us += d;
+    return sends * ((us + 999) / 1000) + it.repeats * 60UL;
+  }
+  if (it.kind == SendBatchKind::Toshiba) return sends * SEND_BATCH_EST_TOSHIBA_MS + it.repeats * SEND_BATCH_DEFAULT_GAP_MS;
+  return sends * SEND_BATCH_EST_NATIVE_MS;
+}
+
+// Zvaliduje celou dávku; při chybě vrátí index vadné položky v errIndex.
+bool parseSendBatch(const String &body, std::vector<SendBatchItem> &items, String &err, int &errIndex) {
+  items.clear();
+  errIndex = -1;
+  std::vector<String> objs;
+  if (!jsonSplitTopLevelObjects(jsonCompact(body), objs)) { err = F("expected JSON array of objects"); return false; }
+  if (objs.empty()) { err = F("empty batch"); return false; }
+  if (objs.size() > SEND_BATCH_MAX_ITEMS) { err = F("too many items"); return false; }
+
+  items.resize(objs.size());
+  uint32_t totalMs = 0;
+  for (size_t i = 0; i < objs.size(); ++i) {
+    if (!parseSendBatchItem(objs[i], items[i], err)) {
+      errIndex = (int)i;
+      items.clear();
+      return false;
+    }
+    totalMs += sendBatchItemAirtimeMs(items[i]);
+    if (i + 1 < objs.size()) totalMs += items[i].gapMs;
+    if (totalMs > SEND_BATCH_MAX_DURATION_MS) {
+      err = F("batch too long");
+      errIndex = (int)i;
+      items.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void runSendBatch(const std::vector<SendBatchItem> &items, std::vector<SendBatchResult> &results) {
+  results.clear();
+  results.reserve(items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    const SendBatchItem &it = items[i];
+    bool ok = false;
+    switch (it.kind) {
+      case SendBatchKind::Learned: {
+        LearnedCode e;
+        ok = getLearnedById(static_cast<uint32_t>(it.id), e) &&
+             irSendLearnedCore(e, it.repeats, it.raw.empty() ? nullptr : &it.raw, it.khz);
+        break;
+      }
+      case SendBatchKind::Toshiba:
+        ok = true;
+        for (uint8_t r = 0; r <= it.repeats && ok; ++r) {
+          if (r) delay(SEND_BATCH_DEFAULT_GAP_MS);
+          ok = toshibaSend(it.ac);
+        }
+        if (ok) noteToshibaState(it.ac);
+        break;
+      case SendBatchKind::Raw:
+        ok = irSendRawPulses(it.raw.data(), it.raw.size(), it.khz, it.repeats);
+        recordSendDiagnostics(ok, F("raw-batch"), UNKNOWN, it.raw.size(), it.khz);
+        break;
+    }
+    results.push_back({ ok, g_lastSendMethod });
+    if (i + 1 < items.size() && it.gapMs) delay(it.gapMs);
+  }
+}
+
+// Odpověď dávky ve tvaru /api/send_batch (sdílí HTTP i MQTT).
+String sendBatchResultJson(const std::vector<SendBatchResult> &results) {
+  bool allOk = true;
+  String out; out.reserve(32 + results.size() * 40);
+  out += F("{\"results\":[");
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (i) out += ',';
+    out += F("{\"ok\":"); out += results[i].ok ? "true" : "false";
+    out += F(",\"method\":\""); out += jsonEscape(results[i].method); out += F("\"}");
+    allOk = allOk && results[i].ok;
+  }
+  out += F("],\"ok\":"); out += allOk ? "true" : "false";
+  out += '}';
+  return out;
+}
+
+String sendBatchErrorJson(const String &err, int errIndex) {
+  String out = F("{\"ok\":false,\"err\":\"");
+  out += jsonEscape(err);
+  out += F("\",\"item\":"); out += errIndex;
+  out += '}';
+  return out;
+}
+
+// ======================== MQTT most ========================
+// Události a stav AC jdou na broker, příkazy z brokeru stejnou cestou jako /api/send_batch.
+// Topicy (<p> = prefix, NVS "mqtt_prefix", výchozí "irbridge"):
+//   <p>/status         online / offline (retain, last will)
+//   <p>/events         JSON pole událostí; první událost po klidu odchází hned, další v okně
+//                      MQTT_EVENT_WINDOW_MS se slučují do jedné zprávy
+//   <p>/toshiba/state  poslední odeslaný stav AC (retain), až po ustálení MQTT_AC_SETTLE_MS
+//   <p>/cmd/send       naučený kód: 3 nebo {"id":3,"repeat":1}
+//   <p>/cmd/toshiba    {"power":1,"mode":"heat","temp":23,"fan":"3"}, chybějící pole z posledního stavu
+//   <p>/cmd/batch      makro = JSON pole jako /api/send_batch
+//   <p>/cmd/result     výsledek každého příkazu (JSON jako odpověď /api/send_batch + "cmd")
+// Příkazy se z callbacku poll() jen zařadí do fronty a vysílají se z mqttService() po návratu
+// z poll() – dávka blokuje až sekundy a uvnitř poll() by zdržela příjem i keep-alive.
+static const uint16_t MQTT_PORT_DEFAULT = 1883;
+static const uint16_t MQTT_EVENT_WINDOW_MS = 200;
+static const uint16_t MQTT_EVENT_BATCH_MAX = 16;
+static const size_t   MQTT_EVENT_BATCH_BYTES = 2048;
+static const uint16_t MQTT_AC_SETTLE_MS = 300;   // série změn (klikání teploty) = jedna zpráva
+static const size_t   MQTT_CMD_QUEUE_MAX = 4;
+
+struct MqttPendingCmd {
+  String cmd;    // send / toshiba / batch
+  String body;
+};
+
+static mqtt::Client g_mqtt;
+static String   g_mqttPrefix = F("irbridge");
+static String   g_mqttEventBatch;           // rozpracované pole událostí (bez závorek)
+static uint16_t g_mqttEventCount = 0;
+static uint32_t g_mqttEventFlushMs = 0;
+static uint32_t g_mqttAcPublished = 0;      // verze stavu AC, která už odešla
+static uint32_t g_mqttEventsSent = 0;
+static uint32_t g_mqttEventBatches = 0;
+static uint32_t g_mqttCommands = 0;
+static uint32_t g_mqttCommandErrors = 0;
+static uint32_t g_mqttCommandsDropped = 0;
+static std::vector<MqttPendingCmd> g_mqttCmdQueue;
+
+static std::string mqttTopic(const char *suffix) {
+  std::string t(g_mqttPrefix.c_str());
+  t += '/';
+  t += suffix;
+  return t;
+}
+
+static bool mqttEnabled() {
+  return g_mqtt.state() != mqtt::Client::State::Disabled;
+}
+
+// Jeden příkaz jako dávka o jedné položce: holé číslo = id, objekt dostane "type".
+static String mqttSingleItemBatch(const String &body, const char *type) {
+  bool digits = body.length() > 0;
+  for (size_t i = 0; i < body.length() && digits; ++i) digits = isdigit((unsigned char)body[i]);
+  String out = F("[{\"type\":\"");
+  out += type;
+  out += '"';
+  if (digits) {
+    out += F(",\"id\":"); out += body; out += F("}]");
+  } else if (body.length() >= 2 && body[0] == '{' && body[body.length() - 1] == '}') {
+    if (body.length() > 2) out += ',';
+    out += body.substring(1);
+    out += ']';
+  } else {
+    return body;   // parseSendBatch ohlásí chybu
+  }
+  return out;
+}
+
+// Částečný stav AC ({"temp":22}) doplní z naposledy odeslaného stavu.
+static String mqttToshibaWithDefaults(const String &body) {
+  if (!g_acStateValid || body.length() < 2 || body[0] != '{') return body;
+  String extra, tok;
+  if (!jsonExtractToken(body, "power", tok)) { extra += F(",\"power\":"); extra += g_acState.powerOn ? 1 : 0; }
+  if (!jsonExtractToken(body, "mode", tok))  { extra += F(",\"mode\":\""); extra += toshibaModeName(g_acState.mode); extra += '"'; }
+  if (!jsonExtractToken(body, "temp", tok))  { extra += F(",\"temp\":"); extra += static_cast<uint32_t>(g_acState.tempC); }
+  if (!jsonExtractToken(body, "fan", tok))   { extra += F(",\"fan\":\""); extra += toshibaFanName(g_acState.fan); extra += '"'; }
+  if (!extra.length()) return body;
+  if (body.length() == 2) return String('{') + extra.substring(1) + '}';
+  return body.substring(0, body.length() - 1) + extra + '}';
+}
+
+static void mqttPublishResult(const String &cmd, const String &out) {
+  String tagged = F("{\"cmd\":\"");
+  tagged += cmd;
+  tagged += F("\",");
+  tagged += out.substring(1);
+  g_mqtt.publish(mqttTopic("cmd/result"), tagged.c_str());
+}
+
+// Callback z poll(): příkaz se jen zařadí, plná fronta = okamžitá chyba "busy".
+static void mqttOnMessage(const std::string &topic, const std::string &payload) {
+  const std::string base = mqttTopic("cmd/");
+  if (topic.compare(0, base.size(), base) != 0) return;
+  const std::string cmd = topic.substr(base.size());
+  if (cmd != "batch" && cmd != "send" && cmd != "toshiba") return;
+  g_mqttCommands++;
+
+  if (g_mqttCmdQueue.size() >= MQTT_CMD_QUEUE_MAX) {
+    g_mqttCommandErrors++;
+    g_mqttCommandsDropped++;
+    mqttPublishResult(String(cmd.c_str()), sendBatchErrorJson(F("busy"), -1));
+    return;
+  }
+  MqttPendingCmd pc;
+  pc.cmd = cmd.c_str();
+  pc.body = payload.c_str();
+  g_mqttCmdQueue.push_back(pc);
+}
+
+// Provede nejstarší čekající příkaz; volá se z mqttService() mimo poll(). Chybějící pole
+// stavu AC se doplňují až teď, aby navazující příkazy viděly výsledek předchozích.
+static void mqttRunQueuedCommand() {
+  if (g_mqttCmdQueue.empty()) return;
+  const MqttPendingCmd pc = g_mqttCmdQueue.front();
+  g_mqttCmdQueue.erase(g_mqttCmdQueue.begin());
+
+  const String body = jsonCompact(pc.body);
+  String batch;
+  if (pc.cmd == "batch") batch = body;
+  else if (pc.cmd == "send") batch = mqttSingleItemBatch(body, "learned");
+  else batch = mqttSingleItemBatch(mqttToshibaWithDefaults(body), "toshiba");
+
+  std::vector<SendBatchItem> items;
+  String err, out;
+  int errIndex = -1;
+  if (parseSendBatch(batch, items, err, errIndex)) {
+    std::vector<SendBatchResult> results;
+    runSendBatch(items, results);
+    out = sendBatchResultJson(results);
+  } else {
+    g_mqttCommandErrors++;
+    out = sendBatchErrorJson(err, errIndex);
+  }
+  mqttPublishResult(pc.cmd, out);
+}
+
+// Načte konfiguraci z NVS a (znovu) spustí klienta; prázdný host = MQTT vypnuto.
+void mqttBegin() {
+  String host = prefs.getString("mqtt_host", "");
+  String prefix = prefs.getString("mqtt_prefix", "");
+  g_mqttPrefix = prefix.length() ? prefix : String(F("irbridge"));
+
+  mqtt::Config cfg;
+  uint16_t port = MQTT_PORT_DEFAULT;
+  int colon = host.lastIndexOf(':');
+  if (colon > 0) {
+    long p = strtol(host.c_str() + colon + 1, nullptr, 10);
+    if (p > 0 && p <= 65535) port = static_cast<uint16_t>(p);
+    host = host.substring(0, colon);
+  }
+  cfg.host = host.c_str();
+  cfg.port = port;
+  uint8_t mac[6]; WiFi.macAddress(mac);
+  char id[24];
+  snprintf(id, sizeof(id), "irbridge-%02x%02x%02x", mac[3], mac[4], mac[5]);
+  cfg.clientId = id;
+  cfg.user = prefs.getString("mqtt_user", "").c_str();
+  cfg.pass = prefs.getString("mqtt_pass", "").c_str();
+  cfg.statusTopic = mqttTopic("status");
+
+  g_mqtt.begin(cfg);
+  g_mqtt.onMessage(mqttOnMessage);
+  g_mqtt.subscribe(mqttTopic("cmd/send"));
+  g_mqtt.subscribe(mqttTopic("cmd/toshiba"));
+  g_mqtt.subscribe(mqttTopic("cmd/batch"));
+  g_mqttEventBatch = String();
+  g_mqttEventCount = 0;
+  g_mqttCmdQueue.clear();
+  g_mqttAcPublished = 0;   // retain stav AC pošli i novému brokeru
+}
+
+// Volá se z processDecodedFrame pro každou nepotlačenou událost.
+static void mqttQueueEvent(const IREvent &e, const LearnedCode *learned) {
+  if (!mqttEnabled()) return;
+  String &b = g_mqttEventBatch;
+  if (g_mqttEventCount) b += ',';
+  b += F("{\"seq\":"); b += e.seq;
+  b += F(",\"ms\":"); b += e.ms;
+  b += F(",\"proto\":\"");
+  b += jsonEscape(learned && learned->proto.length() ? learned->proto : String(protoName(e.proto)));
+  b += F("\",\"bits\":"); b += static_cast<uint32_t>(e.bits);
+  b += F(",\"addr\":"); b += e.address;
+  b += F(",\"cmd\":"); b += e.command;
+  b += F(",\"value\":"); b += e.value;
+  b += F(",\"flags\":"); b += e.flags;
+  b += F(",\"learned_id\":"); b += e.learnedId;
+  if (learned) {
+    b += F(",\"vendor\":\""); b += jsonEscape(learned->vendor);
+    b += F("\",\"function\":\""); b += jsonEscape(learned->function);
+    b += F("\",\"remote\":\""); b += jsonEscape(learned->remote);
+    b += '"';
+  }
+  b += '}';
+  g_mqttEventCount++;
+}
+
+static void mqttFlushEvents() {
+  String payload; payload.reserve(g_mqttEventBatch.length() + 2);
+  payload += '[';
+  payload += g_mqttEventBatch;
+  payload += ']';
+  g_mqtt.publish(mqttTopic("events"), payload.c_str());
+  g_mqttEventsSent += g_mqttEventCount;
+  g_mqttEventBatches++;
+  g_mqttEventBatch = String();
+  g_mqttEventCount = 0;
+  g_mqttEventFlushMs = millis();
+}
+
+void mqttService() {
+  if (!mqttEnabled()) return;
+  g_mqtt.poll();
+  mqttRunQueuedCommand();
+
+  const uint32_t now = millis();
+  if (g_mqttEventCount &&
+      (now - g_mqttEventFlushMs >= MQTT_EVENT_WINDOW_MS || g_mqttEventCount >= MQTT_EVENT_BATCH_MAX ||
+       g_mqttEventBatch.length() >= MQTT_EVENT_BATCH_BYTES)) {
+    mqttFlushEvents();
+  }
+  if (g_acStateValid && g_acStateVersion != g_mqttAcPublished && now - g_acStateChangedMs >= MQTT_AC_SETTLE_MS) {
+    g_mqtt.publish(mqttTopic("toshiba/state"), toshibaStateJson(g_acState).c_str(), true);
+    g_mqttAcPublished = g_acStateVersion;
+  }
+}
+
+// ======================== Učení z více stisků ========================
+// Režim sbírá RAW rámce ze snifferu (N stisků stejného tlačítka), RawConsensus z nich spočítá
+// kanonický kód a /api/learn_multi/save ho uloží i s kvalitou. Bez aktivity režim sám vyprší.
+
+static const uint32_t LEARN_MULTI_TIMEOUT_MS = 60000;
+
+static RawConsensus g_learnMulti;
+static bool         g_learnMultiActive = false;
+static uint32_t     g_learnMultiLastMs = 0;   // start nebo poslední přijaté zachycení
+// compute() je O(N × pulzů) s řazením; UI se ptá na stav každých 500 ms, takže se výsledek
+// drží, dokud nepřibude zachycení (nebo se režim nespustí znovu).
+static RawConsensus::Result g_learnMultiResult;
+static bool                 g_learnMultiDirty = true;
+
+static const RawConsensus::Result &learnMultiComputed() {
+  if (g_learnMultiDirty) {
+    g_learnMultiResult = g_learnMulti.compute();
+    g_learnMultiDirty = false;
+  }
+  return g_learnMultiResult;
+}
+
+void learnMultiStart(uint8_t presses) {
+  g_learnMulti.reset(presses);
+  g_learnMultiDirty = true;
+  g_learnMultiActive = true;
+  g_learnMultiLastMs = millis();
+  Serial.print(F("[LEARN] Učení z více stisků, počet zachycení: "));
+  Serial.println(g_learnMulti.target());
+}
+
+void learnMultiCancel() {
+  g_learnMulti.reset(0);
+  g_learnMultiDirty = true;
+  g_learnMultiActive = false;
+}
+
+bool learnMultiActive() {
+  if (g_learnMultiActive && millis() - g_learnMultiLastMs > LEARN_MULTI_TIMEOUT_MS) {
+    Serial.println(F("[LEARN] Učení z více stisků vypršelo."));
+    learnMultiCancel();
+  }
+  return g_learnMultiActive;
+}
+
+// Volá pipeline pro každý rámec snifferu. Bere rámec tak, jak ho předal ISR (glitche už odfiltroval),
+// bez heuristik finalizeRawCapture – slučování hlavičky by u některých stisků posunulo páry
+// mark/mezera. Jen lichý počet doplní mezerou za rámcem. Po dosažení cíle se další rámce ignorují.
+static void learnMultiFeed(const uint16_t *src, uint16_t count, uint32_t trailingGapUs) {
+  if (!learnMultiActive() || g_learnMulti.complete()) return;
+  std::vector<uint16_t> raw(src, src + count);
+  if (count & 1) {
+    const uint32_t gap = trailingGapUs ? trailingGapUs : RAW_FRAME_GAP_US;
+    raw.push_back(static_cast<uint16_t>(gap > 0xFFFF ? 0xFFFF : gap));
+  }
+  if (!g_learnMulti.add(raw.data(), raw.size())) return;
+  g_learnMultiDirty = true;
+  g_learnMultiLastMs = millis();
+  Serial.print(F("[LEARN] Zachycení "));
+  Serial.print((unsigned)g_learnMulti.captured());
+  Serial.print('/');
+  Serial.print(g_learnMulti.target());
+  Serial.print(F(", pulzů: "));
+  Serial.println((unsigned)raw.size());
+}
+
+RawConsensus::Result learnMultiResult() { return learnMultiComputed(); }
+
+// {"active","target","captured","ignored","complete"} + odhad výsledku, jakmile jsou 2 zachycení.
+String learnMultiStatusJson() {
+  const bool active = learnMultiActive();
+  String out; out.reserve(192);
+  JsonStringWriter w(out);
+  w.beginMap();
+  w.field("active", active);
+  w.field("target", static_cast<uint32_t>(g_learnMulti.target()));
+  w.field("captured", static_cast<uint32_t>(g_learnMulti.captured()));
+  w.field("ignored", g_learnMulti.ignored());
+  w.field("complete", g_learnMulti.complete());
+  if (active && g_learnMulti.captured() >= 2) {
+    const RawConsensus::Result &r = learnMultiComputed();
+    w.field("ok", r.ok);
+    if (r.ok) {
+      w.field("quality", static_cast<uint32_t>(r.quality));
+      w.field("used", static_cast<uint32_t>(r.used));
+      w.field("rejected", static_cast<uint32_t>(r.rejected));
+      w.field("jitter_permille", static_cast<uint32_t>(r.jitterPermille));
+      w.field("clusters", static_cast<uint32_t>(r.clusters));
+      w.field("len", static_cast<uint32_t>(r.raw.size()));
+    } else {
+      w.field("err", r.err);
+    }
+  }
+  w.end();
+  return out;
+}
 
 // ======================== „Efektivně neznámý“ helper ========================
 
 static bool isEffectivelyUnknown(decode_type_t proto, const LearnedCode *learned) {
   if (proto != UNKNOWN) return false;
   if (!learned) return true;
-  if (learned->proto.length() == 0) return true;
-  decode_type_t lp = parseProtoLabel(learned->proto);
-  return (lp == UNKNOWN);
+  return learned->protoType == UNKNOWN;
 }
 
 static inline bool isEffectivelyUnknown(const IREvent &ev) {
-  int16_t idx = findLearnedIndex(ev.value, ev.bits, ev.address);
-  const LearnedCode* lc = (idx >= 0) ? getLearnedByIndex(idx) : nullptr;
-  return isEffectivelyUnknown(ev.proto, lc);
+  if (ev.proto != UNKNOWN) return false;
+  ensureLearnedCacheLoaded();
+  LearnedCode lc;
+  const bool found = g_learnedCatalog.findByKey(ev.value, ev.bits, ev.address, lc);
+  return isEffectivelyUnknown(ev.proto, found ? &lc : nullptr);
 }
 
 // Pohodlná obálka pro použití s IREvent (kvůli WebUI.h)
 static bool isEffectivelyUnknownEvent(const IREvent &ev) {
-  // zkusit dohledat learned položku
-  const LearnedCode* lc = nullptr;
-  int16_t idx = findLearnedIndex(ev.value, ev.bits, ev.address);
-  if (idx >= 0) lc = getLearnedByIndex(idx);
-  return isEffectivelyUnknown(ev.proto, lc);
+  return isEffectivelyUnknown(ev);
 }
 
 // ======================== WiFi + Web ========================
@@ -1361,58 +2642,59 @@ void wifiSetupWithWiFiManager() {
 
 // ======================== Tisk / JSON pro debug ========================
 
-static void printLine(const IRData &d, bool suppress, const LearnedCode *learned) {
-  Serial.print(d.decodedRawData, HEX);
-  Serial.print(F("  "));
-  Serial.print(protoName(d.protocol));
-  Serial.print(F("  "));
-  Serial.print(d.numberOfBits);
-  Serial.print(F("b  addr:0x"));
-  Serial.print(d.address, HEX);
-  Serial.print(F("  cmd:0x"));
-  Serial.print(d.command, HEX);
-  Serial.print(F("  flags:0x"));
-  Serial.print(d.flags, HEX);
+static void formatLine(String &out, const IRData &d, bool suppress, const LearnedCode *learned) {
+  out += String(d.decodedRawData, HEX);
+  out += F("  ");
+  out += protoName(d.protocol);
+  out += F("  ");
+  out += static_cast<uint32_t>(d.numberOfBits);
+  out += F("b  addr:0x");
+  out += String(d.address, HEX);
+  out += F("  cmd:0x");
+  out += String(d.command, HEX);
+  out += F("  flags:0x");
+  out += String(d.flags, HEX);
   if (learned) {
-    Serial.print(F("  [learned: "));
-    Serial.print(learned->vendor);
-    Serial.print(F(" / "));
-    Serial.print(learned->function);
-    Serial.print(F("]"));
+    out += F("  [learned: ");
+    out += learned->vendor;
+    out += F(" / ");
+    out += learned->function;
+    out += F("]");
   }
-  if (suppress) Serial.print(F("  (dup)"));
-  Serial.println();
-}
-
-static void printJSON(const IRData &d, const LearnedCode *learned) {
-  Serial.print(F("{\"ms\":"));
-  Serial.print((uint32_t)millis());
-  Serial.print(F(",\"proto\":\""));
-  Serial.print(protoName(d.protocol));
-  Serial.print(F("\",\"value\":"));
-  Serial.print(d.decodedRawData);
-  Serial.print(F(",\"bits\":"));
-  Serial.print(d.numberOfBits);
-  Serial.print(F(",\"addr\":"));
-  Serial.print(d.address);
-  Serial.print(F(",\"cmd\":"));
-  Serial.print(d.command);
-  Serial.print(F(",\"flags\":"));
-  Serial.print(d.flags);
+  if (suppress) out += F("  (dup)");
+  out += F("\r\n");
+}
+
+static void formatJSON(String &out, const IRData &d, uint32_t ms, const LearnedCode *learned) {
+  out += F("{\"ms\":");
+  out += ms;
+  out += F(",\"proto\":\"");
+  out += protoName(d.protocol);
+  out += F("\",\"value\":");
+  out += d.decodedRawData;
+  out += F(",\"bits\":");
+  out += static_cast<uint32_t>(d.numberOfBits);
+  out += F(",\"addr\":");
+  out += static_cast<uint32_t>(d.address);
+  out += F(",\"cmd\":");
+  out += static_cast<uint32_t>(d.command);
+  out += F(",\"flags\":");
+  out += static_cast<uint32_t>(d.flags);
   if (learned) {
-    Serial.print(F(",\"learned\":{"));
-    Serial.print(F("\"vendor\":\"")); Serial.print(jsonEscape(learned->vendor)); Serial.print(F("\","));
-    Serial.print(F("\"function\":\"")); Serial.print(jsonEscape(learned->function)); Serial.print(F("\","));
-    Serial.print(F("\"remote\":\"")); Serial.print(jsonEscape(learned->remote)); Serial.print('"');
-    Serial.print(F("}"));
+    out += F(",\"learned\":{");
+    out += F("\"vendor\":\""); out += jsonEscape(learned->vendor); out += F("\",");
+    out += F("\"function\":\""); out += jsonEscape(learned->function); out += F("\",");
+    out += F("\"remote\":\""); out += jsonEscape(learned->remote); out += '"';
+    out += F("}");
   }
-  Serial.println(F("}"));
+  out += F("}\r\n");
 }
 
 // ======================== IR Sender init ========================
 
 static void initIrSender(int8_t pin) {
   g_irTxPin = pin;
+  g_irTxReady = false;
   toshiba.setSendPin(g_irTxPin);
 #if !defined(IR_SEND_PIN)
   if (g_irTxPin < 0) {
@@ -1423,6 +2705,7 @@ static void initIrSender(int8_t pin) {
   // Inicializuj i globální instanci IrSender používanou pro přehrávání naučených kódů.
   // Bez explicitního begin() zůstane neaktivní a sendRaw()/sendNEC atd. nebudou nic vysílat.
   irSenderBeginCompat(g_irTxPin);
+  g_irTxReady = true;
   toshiba.begin();
   Serial.print(F("[IR-TX] Inicializován na pinu ")); Serial.println(g_irTxPin);
 }
@@ -1457,23 +2740,17 @@ static void configureAuxPowerPins() {
 }
 
 // ======================== Sběr RAW (IRremote) ========================
-static void captureLastRawFromReceiver() {
-  uint16_t compensated[RAW_BUFFER_LENGTH];
-  uint16_t len = compensateAndStoreCompat(compensated, RAW_BUFFER_LENGTH);
-
-  if (len == 0) {
+static void captureLastRawFromFrame(const IrFrame &frame, const std::vector<uint16_t> &raw) {
+  if (frame.rawLen == 0) {
     g_lastRawValid = false;
     g_lastRaw.clear();
-    g_lastRawLength = 0;
     g_lastRawKhz = 38;
-    g_lastRawCaptureMs = millis();
+    g_lastRawCaptureMs = frame.capturedMs;
     g_lastRawSource = F("(missing)");
     Serial.println(F("[RAW] Upozornění: pro poslední rámec není dostupný RAW záznam."));
   } else {
-    finalizeRawCapture(compensated, len, F("decoder"), 0, false, 38);
+    finalizeRawCapture(raw.data(), frame.rawLen, F("decoder"), 0, false, 38);
   }
-
-  g_isrFrameReady = false;
 }
 
 // Jednotné mapování labelu na IRremote enum.
@@ -1485,7 +2762,7 @@ static decode_type_t parseProtoLabel(const String &s) {
 // Počet naučených položek pro WebUI (/learn_save připojuje RAW k poslední).
 size_t getLearnedCount() {
   ensureLearnedCacheLoaded();
-  return g_learnedCache.size();
+  return g_learnedCatalog.count();
 }
 
 // ======================== WebUI.h bude používat tyto symboly ========================
@@ -1494,47 +2771,47 @@ extern bool g_showOnlyUnknown;
 extern IREvent history[];
 extern size_t histCount;
 extern size_t histWrite;
-extern String fsReadLearnedAsArrayJSON();
-extern const LearnedCode* getLearnedByIndex(int16_t idx);
-extern int16_t findLearnedIndex(uint32_t value, uint8_t bits, uint32_t addr);
-extern bool fsUpdateLearned(size_t index, const String &protoStr,
+extern bool getLearnedById(uint32_t id, LearnedCode &out);
+extern uint32_t learnedIdForOrdinal(uint32_t ordinal);
+extern int32_t findLearnedId(uint32_t value, uint8_t bits, uint32_t addr);
+extern bool fsUpdateLearned(uint32_t id, const String &protoStr,
                             const String &vendor, const String &functionName, const String &remoteLabel);
 extern bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags,
                             const String &protoStr, const String &vendor,
                             const String &functionName, const String &remoteLabel,
                             const std::vector<uint16_t> *rawOpt,
-                            uint8_t rawKhz);
-extern bool fsDeleteLearned(size_t index);
+                            uint8_t rawKhz, int quality);
+extern bool fsDeleteLearned(uint32_t id);
+extern bool fsImportLearned(const char *path, bool replace, uint32_t &outCount, String &err);
 extern bool isEffectivelyUnknownEvent(const IREvent &ev);
-extern bool irSendByIndex(int16_t idx, uint8_t repeats);
+extern bool irSendById(uint32_t id, uint8_t repeats);
 extern bool irSendEvent(const IREvent &ev, uint8_t repeats);
 
-// Wrapper pro WebUI: odeslání podle indexu
-bool irSendByIndex(int16_t idx, uint8_t repeats) {
-  const LearnedCode* e = getLearnedByIndex(idx);
-  if (!e) return false;
-  return irSendLearned(*e, repeats);
+// Wrapper pro WebUI: odeslání podle id
+bool irSendById(uint32_t id, uint8_t repeats) {
+  return irSendLearnedById(id, repeats);
 }
 
 bool irSendEvent(const IREvent &ev, uint8_t repeats) {
-  if (ev.learnedIndex >= 0) {
-    return irSendLearnedByIndex(ev.learnedIndex, repeats);
+  if (ev.learnedId > 0) {
+    return irSendLearnedById(static_cast<uint32_t>(ev.learnedId), repeats);
   }
 
   LearnedCode tmp{};
   tmp.value = ev.value;
   tmp.bits  = ev.bits;
   tmp.addr  = ev.address;
-  tmp.proto = String(protoName(ev.proto));
+  resolveLearnedSend(tmp, ev.proto);
 
-  std::vector<uint16_t> rawFromStorage;
   uint8_t rawFreq = 38;
   const std::vector<uint16_t>* rawPtr = nullptr;
 
-  int16_t storedIdx = findLearnedIndex(ev.value, ev.bits, ev.address);
-  if (storedIdx >= 0) {
-    if (fsLoadRawForIndex(static_cast<size_t>(storedIdx), rawFromStorage, rawFreq) && !rawFromStorage.empty()) {
-      rawPtr = &rawFromStorage;
+  const int32_t storedId = findLearnedId(ev.value, ev.bits, ev.address);
+  if (storedId > 0) {
+    const PulseBufferCache::Entry *p = learnedPulsesForId(static_cast<uint32_t>(storedId));
+    if (p && !p->pulses.empty()) {
+      rawPtr = &p->pulses;
+      rawFreq = p->khz;
     }
   }
 
@@ -1551,59 +2828,120 @@ bool irSendEvent(const IREvent &ev, uint8_t repeats) {
   return irSendLearnedCore(tmp, repeats, rawPtr, rawFreq);
 }
 
-String buildDiagnosticsJson() {
-  String out; out.reserve(512);
-  out += F("{\"raw\":{");
-  out += F("\"valid\":"); out += g_lastRawValid ? "true" : "false";
-  out += F(",\"source\":\""); out += jsonEscape(g_lastRawSource); out += F("\"");
-  out += F(",\"age_ms\":");
-  if (g_lastRawValid) {
-    out += static_cast<uint32_t>(millis() - g_lastRawCaptureMs);
-  } else {
-    out += 0;
-  }
-  out += F(",\"len\":"); out += static_cast<uint32_t>(g_lastRaw.size());
-  out += F(",\"freq\":"); out += static_cast<uint32_t>(g_lastRawKhz);
+// Diagnostika jako šablona nad writerem – JSON (JsonStringWriter) i CBOR (CborWriter) z jednoho místa.
+template <typename W>
+void writeDiagnostics(W &w) {
+  const uint32_t now = millis();
+  w.beginMap();
+
+  w.key("raw"); w.beginMap();
+  w.field("valid", g_lastRawValid);
+  w.field("source", g_lastRawSource);
+  w.field("age_ms", g_lastRawValid ? static_cast<uint32_t>(now - g_lastRawCaptureMs) : 0U);
+  w.field("len", static_cast<uint32_t>(g_lastRaw.size()));
+  w.field("freq", static_cast<uint32_t>(g_lastRawKhz));
+  const bool hasPreview = g_lastRawValid && !g_lastRaw.empty();
+  const size_t previewLen = hasPreview ? std::min<size_t>(g_lastRaw.size(), 16) : 0;
+  w.key("preview"); w.beginArray();
+  for (size_t i = 0; i < previewLen; ++i) w.value(static_cast<uint32_t>(g_lastRaw[i]));
+  w.end();
+  w.field("preview_truncated", hasPreview && g_lastRaw.size() > previewLen);
+  w.field("decode_valid", g_lastDecodeValid);
+  w.field("decode_age_ms", g_lastDecodeValid ? static_cast<uint32_t>(now - g_lastDecodeMs) : 0U);
+  w.field("decode_proto", protoLabel(g_lastDecodeProto));
+  w.field("decode_bits", static_cast<uint32_t>(g_lastDecodeBits));
+  w.field("decode_len", g_lastDecodePulseCount);
+  w.field("decode_source", g_lastDecodeSource);
+  w.end();
+
+  w.key("send"); w.beginMap();
+  w.field("valid", g_lastSendValid);
+  w.field("ok", g_lastSendOk);
+  w.field("age_ms", g_lastSendValid ? static_cast<uint32_t>(now - g_lastSendMs) : 0U);
+  w.field("method", g_lastSendMethod);
+  w.field("proto", protoLabel(g_lastSendProto));
+  w.field("freq", static_cast<uint32_t>(g_lastSendFreq));
+  w.field("pulses", static_cast<uint32_t>(g_lastSendPulses));
+  w.end();
+
+  w.key("pipeline"); w.beginMap();
+  w.field("rx_task", g_irPipeline.taskRunning());
+  w.field("frames", g_irPipeline.queue().pushed());
+  w.field("frames_dropped", g_irPipeline.queue().dropped());
+  w.field("queue_high_water", static_cast<uint32_t>(g_irPipeline.queue().highWater()));
+  w.field("queue_len", static_cast<uint32_t>(g_irPipeline.queue().capacity()));
+  w.field("notify_dropped", g_irNotify.dropped());
+  w.end();
+
+  w.key("pulse_cache"); w.beginMap();
+  w.field("hits", g_pulseCache.hits());
+  w.field("misses", g_pulseCache.misses());
+  w.field("evictions", g_pulseCache.evictions());
+  w.field("entries", static_cast<uint32_t>(g_pulseCache.entries()));
+  w.field("bytes", static_cast<uint32_t>(g_pulseCache.bytes()));
+  w.end();
+
+  w.key("sniffer"); w.beginMap();
+  w.field("min_pulse_us", static_cast<uint32_t>(g_isrMinPulseUs));
+  w.field("glitches", static_cast<uint32_t>(g_isrGlitches));
+  w.field("frames", g_snifferFrames);
+  w.field("rejected_short", g_snifferRejectShort);
+  w.field("rejected_long", g_snifferRejectLong);
+  w.field("rejected_header", g_snifferRejectHeader);
+  w.field("rejected_pulses", g_snifferRejectedPulses);
+  w.end();
+
+  w.key("catalog"); w.beginMap();
+  w.field("count", g_learnedCatalog.count());
+  w.field("skipped", g_learnedCatalog.skipped());
+  w.field("next_id", g_learnedCatalog.nextId());
+  w.field("pages", static_cast<uint32_t>(g_learnedCatalog.pageCount()));
+  w.field("cached_pages", static_cast<uint32_t>(g_learnedCatalog.cachedPages()));
+  w.field("page_loads", g_learnedCatalog.pageLoads());
+  w.field("index_bytes", static_cast<uint32_t>(g_learnedCatalog.indexBytes()));
+  w.end();
+
+  w.key("http"); w.beginMap();
+  w.field("requests", server.requests());
+  w.field("connections", server.connectionsAccepted());
+  w.field("active", static_cast<uint32_t>(server.activeConnections()));
+  w.field("oversized", server.oversizedResponses());
+  w.end();
+
+  w.key("mqtt"); w.beginMap();
+  const mqtt::Config &mc = g_mqtt.config();
+  String host(mc.host.c_str());
+  if (mc.host.size() && mc.port != MQTT_PORT_DEFAULT) { host += ':'; host += static_cast<uint32_t>(mc.port); }
+  w.field("enabled", mqttEnabled());
+  w.field("connected", g_mqtt.connected());
+  w.field("host", host);
+  w.field("prefix", g_mqttPrefix);
+  w.field("user", String(mc.user.c_str()));
+  w.field("last_error", g_mqtt.lastError());
+  w.field("connects", g_mqtt.connects());
+  w.field("failures", g_mqtt.failures());
+  w.field("backoff_ms", g_mqtt.backoffMs());
+  w.field("published", g_mqtt.published());
+  w.field("received", g_mqtt.received());
+  w.field("queued", static_cast<uint32_t>(g_mqtt.queued()));
+  w.field("queued_bytes", static_cast<uint32_t>(g_mqtt.queuedBytes()));
+  w.field("dropped", g_mqtt.dropped());
+  w.field("events", g_mqttEventsSent);
+  w.field("event_batches", g_mqttEventBatches);
+  w.field("commands", g_mqttCommands);
+  w.field("command_errors", g_mqttCommandErrors);
+  w.field("commands_pending", static_cast<uint32_t>(g_mqttCmdQueue.size()));
+  w.field("commands_dropped", g_mqttCommandsDropped);
+  w.field("dns_lookups", g_mqtt.dnsLookups());
+  w.end();
+
+  w.end();
+}
 
-  out += F(",\"preview\":[");
-  if (g_lastRawValid && !g_lastRaw.empty()) {
-    size_t limit = std::min<size_t>(g_lastRaw.size(), 16);
-    for (size_t i = 0; i < limit; ++i) {
-      if (i) out += ',';
-      out += static_cast<uint32_t>(g_lastRaw[i]);
-    }
-    out += F("]");
-    out += F(",\"preview_truncated\":");
-    out += (g_lastRaw.size() > limit) ? "true" : "false";
-  } else {
-    out += F("]");
-    out += F(",\"preview_truncated\":false");
-  }
-  out += F(",\"decode_valid\":"); out += g_lastDecodeValid ? "true" : "false";
-  out += F(",\"decode_age_ms\":");
-  if (g_lastDecodeValid) {
-    out += static_cast<uint32_t>(millis() - g_lastDecodeMs);
-  } else {
-    out += 0;
-  }
-  out += F(",\"decode_proto\":\""); out += jsonEscape(String(protoName(g_lastDecodeProto))); out += F("\"");
-  out += F(",\"decode_bits\":"); out += static_cast<uint32_t>(g_lastDecodeBits);
-  out += F(",\"decode_len\":"); out += g_lastDecodePulseCount;
-  out += F(",\"decode_source\":\""); out += jsonEscape(g_lastDecodeSource); out += F("\"");
-  out += F("},\"send\":{");
-  out += F("\"valid\":"); out += g_lastSendValid ? "true" : "false";
-  out += F(",\"ok\":"); out += g_lastSendOk ? "true" : "false";
-  out += F(",\"age_ms\":");
-  if (g_lastSendValid) {
-    out += static_cast<uint32_t>(millis() - g_lastSendMs);
-  } else {
-    out += 0;
-  }
-  out += F(",\"method\":\""); out += jsonEscape(g_lastSendMethod); out += F("\"");
-  out += F(",\"proto\":\""); out += jsonEscape(String(protoName(g_lastSendProto))); out += F("\"");
-  out += F(",\"freq\":"); out += static_cast<uint32_t>(g_lastSendFreq);
-  out += F(",\"pulses\":"); out += static_cast<uint32_t>(g_lastSendPulses);
-  out += F("}}");
+String buildDiagnosticsJson() {
+  String out; out.reserve(1536);
+  JsonStringWriter w(out);
+  writeDiagnostics(w);
   return out;
 }
 
@@ -1625,57 +2963,61 @@ String buildRawDumpJson() {
 
 #include "WebUI.h"  // používá výše deklarované symboly
 
-// ======================== SETUP / LOOP ========================
-
-void setup() {
-  Serial.begin(115200);
-  delay(200);
+// ======================== Přijímací pipeline ========================
 
-  Serial.println();
-  Serial.println(F("=== IR Receiver (IRremote) – ESP32-C3 ==="));
-  configureAuxPowerPins();
-  Serial.print(F("IR RX pin: ")); Serial.println(IR_RX_PIN);
+// Decode stage (task ir-rx): IRremote dekodér + kopie RAW, receiver se hned uvolní (resume).
+static IrRxPoll irDecodeService(IrFrame &work) {
+  if (!IrReceiver.decode()) return IrRxPoll::Idle;
 
-  if (!LittleFS.begin(true)) {
-    Serial.println(F("[FS] LittleFS mount selhal (format=true), pokračuji bez learned databáze."));
+  const IRData &d = IrReceiver.decodedIRData;
+  IrRxPoll res = IrRxPoll::Busy;
+  if (!isNoise(d)) {
+    work.kind = IrFrameKind::Decoded;
+    work.capturedMs = millis();
+    work.trailingGapUs = 0;
+    work.data = d;
+    work.rawLen = compensateAndStoreDispatch(work.codes);
+    work.codeBytes = work.rawLen;
+    g_isrFrameReady = false;
+    res = IrRxPoll::Frame;
   }
+  IrReceiver.resume();
+  return res;
+}
 
-  prefs.begin("irrecv", false);
-  g_showOnlyUnknown = prefs.getBool("only_unk", false);
-
-  g_irTxPin = prefs.getInt("tx_pin", IR_TX_PIN_DEFAULT);
-  initIrSender(g_irTxPin);
-
-  wifiSetupWithWiFiManager();
-  startWebServer();
-
-  // IR přijímač
-  IrReceiver.begin(IR_RX_PIN, ENABLE_LED_FEEDBACK);
-  setReceiveToleranceCompat(25);
-  setUnknownThresholdCompat(12);
-  pinMode(IR_RX_PIN, INPUT_PULLUP);              // demodulátor většinou tahá do HIGH
-  attachInterrupt(digitalPinToInterrupt(IR_RX_PIN), irEdgeISR, CHANGE);
-  Serial.println(F("[RAW] Sniffer aktivní (GPIO CHANGE ISR)."));
-
-  Serial.print(F("Protokoly povoleny: "));
-  IrReceiver.printActiveIRProtocols(&Serial);
-  Serial.println();
+// Hooky IrTxScope (volá se pod zámkem pipeline, task ir-rx stojí).
+static void irRxSuspend() {
+  IrReceiver.stop();
 }
 
-void loop() {
-  serviceClient();
-  rawSnifferService();
+// Vlastní vysílání zachycené snifferem se zahodí; další hrana začne nový rámec.
+static void irRxResume() {
+  noInterrupts();
+  g_isrLastLevel = -1;
+  g_isrPending = 0;
+  interrupts();
+  IrReceiver.start();
+}
 
-  if (!IrReceiver.decode()) {
-    delay(1);
-    return;
+static void irNotifyTask(void *) {
+  String line;
+  for (;;) {
+    if (g_irNotify.popWait(line, 1000)) Serial.print(line);
   }
+}
 
-  IRData d = IrReceiver.decodedIRData;
-
-  if (isNoise(d)) { IrReceiver.resume(); serviceClient(); return; }
+static void irNotify(String &&line) {
+  if (g_irNotifyTaskRunning) {
+    g_irNotify.tryPush(std::move(line));
+  } else {
+    Serial.print(line);
+  }
+}
 
-  const uint32_t now = millis();
+// Match + history/log stage (loop): stejná logika jako dřív přímo v loop().
+static void processDecodedFrame(const IrFrame &frame, const std::vector<uint16_t> &raw) {
+  const IRData &d = frame.data;
+  const uint32_t now = frame.capturedMs;
   bool suppress = false;
   if (d.flags & IRDATA_FLAGS_IS_REPEAT) {
     if (now - lastMs < DUP_FILTER_MS &&
@@ -1686,8 +3028,9 @@ void loop() {
     }
   }
 
-  int16_t learnedIndex = -1;
-  const LearnedCode *learned = findLearnedMatch(d, &learnedIndex);
+  LearnedCode learnedCode;
+  const LearnedCode *learned = findLearnedMatch(d, learnedCode) ? &learnedCode : nullptr;
+  const int32_t learnedId = learned ? static_cast<int32_t>(learned->id) : -1;
   const bool effectiveUnknown = isEffectivelyUnknown(d.protocol, learned);
 
   if (effectiveUnknown && !suppress) {
@@ -1699,14 +3042,16 @@ void loop() {
     lastUnknown.command = d.command;
     lastUnknown.value   = d.decodedRawData;
     lastUnknown.flags   = d.flags;
-    lastUnknown.learnedIndex = -1;
+    lastUnknown.learnedId = -1;
   }
 
-  printLine(d, suppress, learned);
+  String note;
+  note.reserve(suppress ? 96 : 320);
+  formatLine(note, d, suppress, learned);
   if (!suppress) {
-    printJSON(d, learned);
-    addToHistory(d, learnedIndex);
-    captureLastRawFromReceiver();
+    formatJSON(note, d, now, learned);
+    mqttQueueEvent(addToHistory(d, learnedId), learned);
+    captureLastRawFromFrame(frame, raw);
 
     g_lastDecodeValid = true;
     g_lastDecodeMs = now;
@@ -1720,12 +3065,103 @@ void loop() {
       g_lastDecodeSource = F("decoder");
     }
   }
+  irNotify(std::move(note));
 
   lastMs   = now;
   lastProto= d.protocol;
   lastBits = d.numberOfBits;
   lastValue= d.decodedRawData;
+}
 
-  IrReceiver.resume();
+// Rozbalí kompaktní RAW rámce na µs; buffer je jeden pro spotřebitele, platí do dalšího rámce.
+static std::vector<uint16_t> g_procRaw;
+
+static const std::vector<uint16_t> &irFrameRawUs(const IrFrame &frame) {
+  g_procRaw.resize(frame.rawLen);
+  if (frame.kind == IrFrameKind::Sniffer) {
+    uint16_t pos = 0;
+    for (uint16_t i = 0; i < frame.rawLen && pos < frame.codeBytes; ++i) g_procRaw[i] = pulseCodeRead(frame.codes, pos);
+  } else {
+    for (uint16_t i = 0; i < frame.rawLen; ++i) g_procRaw[i] = static_cast<uint16_t>(frame.codes[i] * MICROS_PER_TICK);
+  }
+  return g_procRaw;
+}
+
+// Spotřebitel v loop() (IrRxPipeline::consume): jeden rámec z fronty.
+static void processIrFrame(const IrFrame &frame) {
+  const std::vector<uint16_t> &raw = irFrameRawUs(frame);
+  if (frame.kind == IrFrameKind::Sniffer) {
+    finalizeRawCapture(raw.data(), frame.rawLen, F("sniffer"), frame.trailingGapUs);
+    learnMultiFeed(raw.data(), frame.rawLen, frame.trailingGapUs);
+  } else {
+    processDecodedFrame(frame, raw);
+  }
+}
+
+// Bez tasku ir-rx (fallback) běží capture/decode přímo v loop() jako dřív.
+static void irPipelineService() {
+  g_irPipeline.service();
+}
+
+static void startIrPipeline() {
+  g_irNotifyTaskRunning = startPipelineWorker("ir-notify", irNotifyTask, nullptr, 3072, 1);
+  g_irPipeline.setRadioHooks(irRxSuspend, irRxResume);
+  if (!g_irPipeline.startTask("ir-rx", 4096, 5)) {
+    Serial.println(F("[IR] Nelze spustit task ir-rx, příjem poběží v loop()."));
+  }
+}
+
+// ======================== SETUP / LOOP ========================
+
+void setup() {
+  Serial.begin(115200);
+  delay(200);
+
+  Serial.println();
+  Serial.println(F("=== IR Receiver (IRremote) – ESP32-C3 ==="));
+  configureAuxPowerPins();
+  Serial.print(F("IR RX pin: ")); Serial.println(IR_RX_PIN);
+
+  if (!LittleFS.begin(true)) {
+    Serial.println(F("[FS] LittleFS mount selhal (format=true), pokračuji bez learned databáze."));
+  }
+
+  prefs.begin("irrecv", false);
+  g_showOnlyUnknown = prefs.getBool("only_unk", false);
+
+  const uint16_t bootId = static_cast<uint16_t>(prefs.getUShort("boot", 0) + 1);
+  prefs.putUShort("boot", bootId);
+  g_eventLog.begin(bootId, &prefs);
+  ensureLearnedCacheLoaded();   // index katalogu (případně jednorázová migrace na id)
+
+  g_irTxPin = prefs.getInt("tx_pin", IR_TX_PIN_DEFAULT);
+  g_isrMinPulseUs = std::min<uint16_t>(prefs.getUShort("glitch_us", RAW_GLITCH_US_DEFAULT), RAW_GLITCH_US_MAX);
+  initIrSender(g_irTxPin);
+
+  wifiSetupWithWiFiManager();
+  configTime(0, 0, "pool.ntp.org", "time.nist.gov");   // epoch pro časové dotazy do logu
+  startWebServer();
+  mqttBegin();
+
+  // IR přijímač
+  IrReceiver.begin(IR_RX_PIN, ENABLE_LED_FEEDBACK);
+  setReceiveToleranceCompat(25);
+  setUnknownThresholdCompat(12);
+  pinMode(IR_RX_PIN, INPUT_PULLUP);              // demodulátor většinou tahá do HIGH
+  attachInterrupt(digitalPinToInterrupt(IR_RX_PIN), irEdgeISR, CHANGE);
+  Serial.println(F("[RAW] Sniffer aktivní (GPIO CHANGE ISR)."));
+
+  Serial.print(F("Protokoly povoleny: "));
+  IrReceiver.printActiveIRProtocols(&Serial);
+  Serial.println();
+
+  startIrPipeline();
+}
+
+void loop() {
   serviceClient();
+  irPipelineService();
+  mqttService();
+  g_eventLog.service();
+  delay(1);
 }
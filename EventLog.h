@@ -0,0 +1,333 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+// ====== Přehled ======
+// Trvalý log přijatých IR událostí v LittleFS (append-only, rotace po segmentech).
+// - Záznamy mají pevnou délku (IrLogRecord), takže pozice v segmentu = (seq - firstSeq) * velikost.
+// - Segment /evlog/seg_<firstSeq>.bin drží max. kRecordsPerSegment záznamů, nejstarší se maže
+//   po překročení kMaxSegments (omezené místo i opotřebení flash).
+// - Zápisy se dávkují v RAM (kFlushBatch záznamů nebo kFlushIntervalMs), log neflashuje po každé události.
+// - Řídký časový index: pro každý segment RAM drží první/poslední epoch, dotaz na rozsah času
+//   přeskočí celé segmenty a čte jen ty, které rozsah překrývají.
+// - seq je globální pořadové číslo přes restarty – jednoznačný klíč i po přetečení millis().
+//   Dávka v RAM se při restartu ztratí, proto se seq rezervuje po blocích v NVS (kSeqReserveBlock)
+//   a po startu pokračuje za rezervací. Mezeru v segmentu (ztracené seq) vyplní záznamy
+//   s format = kGapFormat, aby pozice v souboru dál odpovídala seq; dotazy je přeskakují.
+
+struct __attribute__((packed)) IrLogRecord {
+  uint32_t seq;
+  uint32_t epoch;        // unix čas v s (0 = čas ještě nebyl synchronizován)
+  uint32_t uptimeMs;     // millis() v okamžiku události
+  uint16_t boot;         // počítadlo startů zařízení
+  uint16_t proto;        // decode_type_t
+  uint32_t address;
+  uint32_t command;
+  uint32_t value;
+  uint16_t flags;        // IRData.flags
+  uint8_t  bits;
+  uint8_t  format;       // kRecordFormat = událost, kGapFormat = výplň mezery v seq
+  int32_t  learnedId;    // stabilní id naučeného kódu, -1 = žádná vazba
+};
+static_assert(sizeof(IrLogRecord) == 36, "IrLogRecord musí mít pevnou délku 36 B");
+
+class IrEventLog {
+public:
+  static constexpr const char* kDir               = "/evlog";
+  static constexpr uint16_t    kRecordsPerSegment = 512;    // 18 KB / segment
+  static constexpr uint8_t     kMaxSegments       = 8;
+  static constexpr uint8_t     kFlushBatch        = 16;
+  static constexpr uint32_t    kFlushIntervalMs   = 60000;
+  static constexpr size_t      kMaxQueryLimit     = 100;
+  static constexpr uint32_t    kMinValidEpoch     = 1600000000UL;
+  static constexpr uint8_t     kRecordFormat      = 1;
+  static constexpr uint8_t     kGapFormat         = 0xFF;
+  static constexpr uint32_t    kSeqReserveBlock   = kFlushBatch;   // 1 zápis do NVS na dávku
+  static constexpr const char* kSeqPrefKey        = "ev_seq";
+
+  // Načte seznam segmentů a pokračuje v číslování seq. bootId ukládá do každého záznamu.
+  // seqStore (volitelné) drží rezervaci seq, aby se čísla ztracené dávky po restartu neopakovala.
+  bool begin(uint16_t bootId, Preferences *seqStore = nullptr);
+
+  // Zařadí událost do dávky; seq/boot/epoch doplní log. Vrací přidělené seq.
+  uint32_t append(IrLogRecord rec);
+
+  // Volat z loop(): zapíše dávku, pokud je v RAM déle než kFlushIntervalMs.
+  void service();
+  bool flush();
+
+  // Stránkovaný dotaz od seq fromSeq; t1/t2 (epoch s) jsou volitelné – 0 = bez omezení.
+  // nextSeq je kurzor pro další stránku (0 = žádná další data).
+  size_t query(uint32_t fromSeq, uint32_t t1, uint32_t t2, size_t limit,
+               std::vector<IrLogRecord> &out, uint32_t &nextSeq);
+  bool findBySeq(uint32_t seq, IrLogRecord &out);
+
+  uint32_t nextSeq() const   { return _nextSeq; }
+  uint32_t oldestSeq() const { return _segs.empty() ? (_pendingCount ? _pending[0].seq : _nextSeq) : _segs.front().firstSeq; }
+  uint32_t flushes() const   { return _flushes; }
+  uint32_t writeErrors() const { return _writeErrors; }
+  bool     ready() const     { return _ready; }
+
+  static uint32_t nowEpoch() {
+    time_t t = time(nullptr);
+    return (t >= (time_t)kMinValidEpoch) ? (uint32_t)t : 0;
+  }
+
+private:
+  struct Segment {
+    uint32_t firstSeq;
+    uint16_t count;
+    uint32_t firstEpoch;   // první nenulový epoch v segmentu (0 = žádný)
+    uint32_t lastEpoch;    // poslední nenulový epoch v segmentu
+    bool     sealed;       // do segmentu se už nepřipisuje (neúplný konec po výpadku, chyba zápisu)
+  };
+
+  std::vector<Segment> _segs;
+  IrLogRecord _pending[kFlushBatch];
+  uint8_t     _pendingCount = 0;
+  uint32_t    _pendingSinceMs = 0;
+  uint32_t    _nextSeq = 1;
+  uint32_t    _seqReserved = 0;     // všechna přidělená seq jsou menší (uloženo v NVS)
+  Preferences *_seqStore = nullptr;
+  uint16_t    _boot = 0;
+  bool        _ready = false;
+  uint32_t    _flushes = 0;
+  uint32_t    _writeErrors = 0;
+
+  static String segPath(uint32_t firstSeq) {
+    String p = kDir;
+    p += F("/seg_");
+    p += firstSeq;
+    p += F(".bin");
+    return p;
+  }
+
+  static void noteEpoch(Segment &s, uint32_t epoch) {
+    if (!epoch) return;
+    if (!s.firstEpoch) s.firstEpoch = epoch;
+    s.lastEpoch = epoch;
+  }
+
+  static bool recordInRange(const IrLogRecord &r, uint32_t t1, uint32_t t2) {
+    if (!t1 && !t2) return true;
+    if (!r.epoch) return false;
+    return (!t1 || r.epoch >= t1) && (!t2 || r.epoch <= t2);
+  }
+
+  void reserveSeq() {
+    if (!_seqStore) return;
+    _seqReserved = _nextSeq + kSeqReserveBlock;
+    _seqStore->putUInt(kSeqPrefKey, _seqReserved);
+  }
+
+  bool writeRecords(const IrLogRecord *recs, size_t n);
+};
+
+// ====== Inline implementace ======
+
+inline bool IrEventLog::begin(uint16_t bootId, Preferences *seqStore) {
+  _boot = bootId;
+  _segs.clear();
+  _pendingCount = 0;
+  _seqStore = seqStore;
+
+  if (!LittleFS.exists(kDir) && !LittleFS.mkdir(kDir)) {
+    Serial.println(F("[LOG] Nelze vytvořit adresář /evlog, trvalý log je vypnut."));
+    _ready = false;
+    return false;
+  }
+
+  File dir = LittleFS.open(kDir);
+  if (dir) {
+    File f = dir.openNextFile();
+    while (f) {
+      String name = f.name();
+      int slash = name.lastIndexOf('/');
+      if (slash >= 0) name = name.substring(slash + 1);
+      if (name.startsWith("seg_") && name.endsWith(".bin")) {
+        Segment s{};
+        s.firstSeq = (uint32_t)strtoul(name.c_str() + 4, nullptr, 10);
+        s.count = (uint16_t)std::min<size_t>(f.size() / sizeof(IrLogRecord), kRecordsPerSegment);
+        // Neúplný záznam na konci (výpadek napájení) – další zápis začne nový segment.
+        s.sealed = (f.size() % sizeof(IrLogRecord)) != 0;
+        IrLogRecord r;
+        for (uint16_t i = 0; i < s.count; ++i) {
+          if (f.read(reinterpret_cast<uint8_t*>(&r), sizeof(r)) != sizeof(r)) break;
+          noteEpoch(s, r.epoch);
+        }
+        if (s.count) _segs.push_back(s);
+      }
+      f.close();
+      f = dir.openNextFile();
+    }
+    dir.close();
+  }
+
+  std::sort(_segs.begin(), _segs.end(),
+            [](const Segment &a, const Segment &b) { return a.firstSeq < b.firstSeq; });
+
+  if (!_segs.empty()) {
+    _nextSeq = _segs.back().firstSeq + _segs.back().count;
+  }
+  if (_seqStore) {
+    // Rezervace z minulého běhu může být za koncem logu (neuložená dávka) – ta seq už byla vydána.
+    _nextSeq = std::max<uint32_t>(_nextSeq, _seqStore->getUInt(kSeqPrefKey, 0));
+    reserveSeq();
+  }
+
+  _ready = true;
+  Serial.print(F("[LOG] Trvalý log: "));
+  Serial.print(_segs.size());
+  Serial.print(F(" segmentů, další seq "));
+  Serial.println(_nextSeq);
+  return true;
+}
+
+inline uint32_t IrEventLog::append(IrLogRecord rec) {
+  rec.seq = _nextSeq++;
+  if (_seqStore && _nextSeq >= _seqReserved) reserveSeq();
+  rec.boot = _boot;
+  rec.epoch = nowEpoch();
+  rec.format = kRecordFormat;
+  if (!_ready) return rec.seq;
+
+  if (_pendingCount == 0) _pendingSinceMs = millis();
+  _pending[_pendingCount++] = rec;
+  if (_pendingCount >= kFlushBatch) flush();
+  return rec.seq;
+}
+
+inline void IrEventLog::service() {
+  if (_pendingCount && (millis() - _pendingSinceMs) >= kFlushIntervalMs) {
+    flush();
+  }
+}
+
+inline bool IrEventLog::flush() {
+  if (!_pendingCount) return true;
+  const bool ok = writeRecords(_pending, _pendingCount);
+  if (ok) _flushes++;
+  else _writeErrors++;
+  // Při chybě dávku zahodíme – log nesmí blokovat příjem ani růst bez omezení.
+  _pendingCount = 0;
+  return ok;
+}
+
+inline bool IrEventLog::writeRecords(const IrLogRecord *recs, size_t n) {
+  size_t done = 0;
+  while (done < n) {
+    if (_segs.empty() || _segs.back().sealed || _segs.back().count >= kRecordsPerSegment) {
+      _segs.push_back(Segment{ recs[done].seq, 0, 0, 0, false });
+      while (_segs.size() > kMaxSegments) {
+        LittleFS.remove(segPath(_segs.front().firstSeq));
+        _segs.erase(_segs.begin());
+      }
+    }
+    Segment &s = _segs.back();
+    // Mezera v seq (dávka ztracená restartem nebo chybou zápisu): krátkou vyplnit,
+    // delší nebo nesedící začne nový segment.
+    const uint32_t expect = s.firstSeq + s.count;
+    uint32_t gap = 0;
+    if (recs[done].seq != expect) {
+      if (recs[done].seq < expect || recs[done].seq - expect >= static_cast<uint32_t>(kRecordsPerSegment - s.count)) {
+        s.sealed = true;
+        continue;
+      }
+      gap = recs[done].seq - expect;
+    }
+    const size_t chunk = std::min<size_t>(n - done, kRecordsPerSegment - s.count - gap);
+
+    File f = LittleFS.open(segPath(s.firstSeq), FILE_APPEND);
+    if (!f) return false;
+    if (gap) {
+      IrLogRecord filler{};
+      filler.format = kGapFormat;
+      filler.learnedId = -1;
+      for (uint32_t i = 0; i < gap; ++i) {
+        filler.seq = expect + i;
+        if (f.write(reinterpret_cast<const uint8_t*>(&filler), sizeof(filler)) != sizeof(filler)) {
+          f.close();
+          s.sealed = true;
+          return false;
+        }
+        s.count++;
+      }
+    }
+    const size_t bytes = chunk * sizeof(IrLogRecord);
+    const size_t w = f.write(reinterpret_cast<const uint8_t*>(recs + done), bytes);
+    f.close();
+    if (w != bytes) {
+      s.sealed = true;  // nepokračovat za případně poškozeným koncem
+      return false;
+    }
+    for (size_t i = 0; i < chunk; ++i) noteEpoch(s, recs[done + i].epoch);
+    s.count += chunk;
+    done += chunk;
+  }
+  return true;
+}
+
+inline size_t IrEventLog::query(uint32_t fromSeq, uint32_t t1, uint32_t t2, size_t limit,
+                                std::vector<IrLogRecord> &out, uint32_t &nextSeq) {
+  out.clear();
+  nextSeq = 0;
+  if (limit == 0 || limit > kMaxQueryLimit) limit = kMaxQueryLimit;
+  const bool timed = (t1 || t2);
+
+  auto take = [&](const IrLogRecord &r) {
+    if (r.seq < fromSeq || r.format == kGapFormat) return true;
+    if (timed && r.epoch && t2 && r.epoch > t2) return false;  // čas roste – dál už nic
+    if (!recordInRange(r, t1, t2)) return true;
+    if (out.size() >= limit) {
+      nextSeq = r.seq;
+      return false;
+    }
+    out.push_back(r);
+    return true;
+  };
+
+  for (const Segment &s : _segs) {
+    if (s.firstSeq + s.count <= fromSeq) continue;
+    if (timed) {
+      if (!s.lastEpoch || (t1 && s.lastEpoch < t1)) continue;
+      if (t2 && s.firstEpoch > t2) return out.size();
+    }
+
+    File f = LittleFS.open(segPath(s.firstSeq), FILE_READ);
+    if (!f) continue;
+    const uint32_t skip = (fromSeq > s.firstSeq) ? (fromSeq - s.firstSeq) : 0;
+    f.seek(skip * sizeof(IrLogRecord));
+    IrLogRecord r;
+    for (uint32_t i = skip; i < s.count; ++i) {
+      if (f.read(reinterpret_cast<uint8_t*>(&r), sizeof(r)) != sizeof(r)) break;
+      if (!take(r)) { f.close(); return out.size(); }
+    }
+    f.close();
+  }
+
+  for (uint8_t i = 0; i < _pendingCount; ++i) {
+    if (!take(_pending[i])) break;
+  }
+  return out.size();
+}
+
+inline bool IrEventLog::findBySeq(uint32_t seq, IrLogRecord &out) {
+  for (uint8_t i = 0; i < _pendingCount; ++i) {
+    if (_pending[i].seq == seq) { out = _pending[i]; return true; }
+  }
+  for (const Segment &s : _segs) {
+    if (seq < s.firstSeq || seq >= s.firstSeq + s.count) continue;
+    File f = LittleFS.open(segPath(s.firstSeq), FILE_READ);
+    if (!f) return false;
+    f.seek((seq - s.firstSeq) * sizeof(IrLogRecord));
+    const bool ok = (f.read(reinterpret_cast<uint8_t*>(&out), sizeof(out)) == sizeof(out)) &&
+                    out.seq == seq && out.format != kGapFormat;
+    f.close();
+    return ok;
+  }
+  return false;
+}
@@ -0,0 +1,932 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ====== Přehled ======
+// Neblokující HTTP/1.1 server nad BSD sockety (lwIP na ESP32, POSIX na Linuxu).
+// - více současných spojení (kMaxConnections), keep-alive a pipelining požadavků,
+// - odpověď se odesílá po částech podle toho, kolik socket přijme (žádné blokování na pomalém klientovi);
+//   handler jen plní frontu spojení (max. kMaxResponseBytes – větší odpověď se zahodí a klient
+//   dostane 500 se zavřením spojení), další požadavky se nezpracují, dokud neodeslaná data
+//   všech spojení nespadnou pod kOutBudget,
+// - velké odpovědi lze generovat průběžně přes BodySource (chunked), bez bufferu celé odpovědi,
+// - těla s upload handlerem se streamují (multipart/form-data i holé tělo).
+//
+// Jádro (namespace http) nepoužívá Arduino typy a přeloží se i na Linuxu (zátěžové testy).
+// IrWebServer níže je tenká Arduino fasáda s API kompatibilním s WebServer (server.on/arg/send...),
+// takže handlery ve WebUI.h i routovací tabulka zůstávají beze změn.
+
+namespace http {
+
+static constexpr size_t   kMaxConnections   = 6;
+static constexpr size_t   kMaxHeadBytes     = 4096;
+static constexpr size_t   kMaxBodyBytes     = 16384;   // těla bez upload handleru se drží v RAM
+static constexpr size_t   kOutHighWater     = 16384;   // nad tím se odeslaný začátek bufferu maže
+static constexpr size_t   kOutLowWater      = 2048;    // pod tím se dotahují data z BodySource
+static constexpr size_t   kMaxResponseBytes = 32768;   // víc najednou z handleru = chyba (patří do BodySource)
+static constexpr size_t   kOutBudget        = 24576;   // neodeslaná data všech spojení, nad tím se čeká
+static constexpr size_t   kSourceChunk      = 1024;
+static constexpr uint32_t kKeepAliveMs      = 5000;
+static constexpr uint32_t kRequestTimeoutMs = 10000;
+static constexpr uint16_t kMaxRequestsPerConnection = 100;
+
+// Pull generátor těla odpovědi: naplní buf (max bajtů) a vrátí počet, 0 = konec.
+using BodySource = std::function<size_t(uint8_t *buf, size_t max)>;
+
+inline uint32_t nowMs() {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+inline char lowerAscii(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; }
+
+inline bool equalsNoCase(const std::string &a, const char *b) {
+  size_t n = strlen(b);
+  if (a.size() != n) return false;
+  for (size_t i = 0; i < n; ++i) if (lowerAscii(a[i]) != lowerAscii(b[i])) return false;
+  return true;
+}
+
+inline std::string trimmed(const std::string &s) {
+  size_t a = 0, b = s.size();
+  while (a < b && (s[a] == ' ' || s[a] == '\t')) a++;
+  while (b > a && (s[b - 1] == ' ' || s[b - 1] == '\t' || s[b - 1] == '\r')) b--;
+  return s.substr(a, b - a);
+}
+
+inline std::string urlDecode(const std::string &in) {
+  std::string out;
+  out.reserve(in.size());
+  auto hex = [](char c) -> int {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = lowerAscii(c);
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+  };
+  for (size_t i = 0; i < in.size(); ++i) {
+    char c = in[i];
+    if (c == '+') {
+      out += ' ';
+    } else if (c == '%' && i + 2 < in.size() && hex(in[i + 1]) >= 0 && hex(in[i + 2]) >= 0) {
+      out += static_cast<char>((hex(in[i + 1]) << 4) | hex(in[i + 2]));
+      i += 2;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+// a=1&b=x%20y → [(a,1),(b,"x y")]
+inline void parseUrlEncoded(const std::string &s, std::vector<std::pair<std::string, std::string>> &out) {
+  size_t p = 0;
+  while (p <= s.size()) {
+    size_t amp = s.find('&', p);
+    if (amp == std::string::npos) amp = s.size();
+    if (amp > p) {
+      std::string kv = s.substr(p, amp - p);
+      size_t eq = kv.find('=');
+      if (eq == std::string::npos) out.emplace_back(urlDecode(kv), std::string());
+      else out.emplace_back(urlDecode(kv.substr(0, eq)), urlDecode(kv.substr(eq + 1)));
+    }
+    p = amp + 1;
+  }
+}
+
+struct Request {
+  std::string method;
+  std::string path;
+  std::string query;
+  std::string version;
+  std::vector<std::pair<std::string, std::string>> headers;  // názvy malými písmeny
+  std::string body;
+  size_t contentLength = 0;
+  bool keepAlive = true;
+
+  const std::string *header(const char *lowerName) const {
+    for (const auto &h : headers) if (h.first == lowerName) return &h.second;
+    return nullptr;
+  }
+};
+
+enum class BodyEvent : uint8_t { Start, Data, End, Aborted };
+
+struct UploadPart {
+  std::string name;
+  std::string filename;
+  std::string contentType;
+};
+
+class Core;
+
+class Connection {
+public:
+  // Zápis odpovědi z handleru – jen do fronty spojení, nikdy neblokuje. Odpověď nad
+  // kMaxResponseBytes se zahodí a po návratu handleru se místo ní pošle 500 a spojení
+  // se zavře (failed() = true, další zápisy se ignorují); velká data patří do setBodySource().
+  void write(const char *data, size_t len);
+  void write(const std::string &s) { write(s.data(), s.size()); }
+
+  // Po návratu handleru se tělo dotahuje z generátoru (chunked = Transfer-Encoding: chunked).
+  void setBodySource(BodySource src, bool chunked) { _source = std::move(src); _sourceChunked = chunked; }
+  void closeAfterResponse() { _closeAfter = true; }
+  bool failed() const { return _dead || _oversized; }
+
+private:
+  friend class Core;
+  enum class State : uint8_t { Head, Body, UploadBody, Streaming };
+  enum class Multipart : uint8_t { None, Preamble, PartHead, Data, Done };
+
+  Core       *_core = nullptr;
+  int         _fd = -1;
+  State       _state = State::Head;
+  std::string _in;
+  std::string _out;
+  size_t      _outOff = 0;
+  BodySource  _source;
+  bool        _sourceChunked = false;
+  bool        _closeAfter = false;
+  bool        _peerClosed = false;
+  bool        _dead = false;
+  bool        _inHandler = false;
+  bool        _oversized = false;   // odpověď handleru přetekla kMaxResponseBytes
+  size_t      _responseStart = 0;   // velikost _out před odpovědí právě běžícího handleru
+  uint32_t    _lastActivity = 0;
+  uint16_t    _served = 0;
+  Request     _req;
+  size_t      _bodyRemaining = 0;
+  // streamovaný upload
+  Multipart   _mp = Multipart::None;
+  std::string _mpDelim;      // "\r\n--boundary"
+  std::string _mpBuf;        // nezpracovaný zbytek multipart těla
+  UploadPart  _part;
+
+  size_t pendingOut() const { return _out.size() - _outOff; }
+};
+
+class Core {
+public:
+  struct Callbacks {
+    virtual ~Callbacks() {}
+    // Po přečtení hlavičky; true = tělo streamovat do onBodyChunk místo držení v RAM.
+    virtual bool onHead(Connection &, const Request &) { return false; }
+    virtual void onBodyChunk(Connection &, const Request &, BodyEvent, const UploadPart &,
+                             const uint8_t *, size_t) {}
+    virtual void onRequest(Connection &, Request &) = 0;
+    // Spojení se zavírá (i uprostřed požadavku) – uvolnění stavu vázaného na spojení.
+    virtual void onClosed(Connection &) {}
+  };
+
+  Core(uint16_t port, Callbacks &cb) : _port(port), _cb(cb) {}
+  ~Core() { stop(); }
+
+  bool begin();
+  void stop();
+  // Neblokující obsluha: přijme spojení, přečte/zpracuje požadavky, odešle co jde.
+  void poll();
+
+  uint32_t requests() const { return _requests; }
+  uint32_t accepted() const { return _accepted; }
+  uint32_t oversized() const { return _oversized; }
+  size_t   activeConnections() const { return _conns.size(); }
+
+  // Jednoduchá chybová odpověď (jádro ji používá pro 4xx/5xx před voláním handleru).
+  static void simpleResponse(Connection &c, int code, const char *reason, bool close);
+
+private:
+  friend class Connection;
+  uint16_t   _port;
+  Callbacks &_cb;
+  int        _listenFd = -1;
+  std::vector<std::unique_ptr<Connection>> _conns;
+  uint32_t   _requests = 0;
+  uint32_t   _accepted = 0;
+  uint32_t   _oversized = 0;
+
+  size_t queuedOut() const {
+    size_t n = 0;
+    for (const auto &c : _conns) n += c->pendingOut();
+    return n;
+  }
+
+  static bool setNonBlocking(int fd) {
+    int fl = fcntl(fd, F_GETFL, 0);
+    return fl >= 0 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) >= 0;
+  }
+
+  void acceptNew();
+  void readAvailable(Connection &c);
+  void process(Connection &c);
+  bool parseHead(Connection &c, size_t headEnd);
+  void feedUpload(Connection &c, const char *data, size_t len);
+  void finishUpload(Connection &c, bool aborted);
+  void dispatch(Connection &c);
+  void writeOut(Connection &c);
+  void closeConn(size_t idx);
+};
+
+// ====== Inline implementace ======
+
+inline void Connection::write(const char *data, size_t len) {
+  if (_dead || _oversized || len == 0) return;
+  if (pendingOut() + len > kMaxResponseBytes) {
+    if (_core) _core->_oversized++;
+    if (!_inHandler) {      // mimo handler (jen krátké chybové odpovědi jádra) – nelze nahradit
+      _dead = true;
+      return;
+    }
+    // Během handleru se nic neodesílá, takže jde zahodit celou dosavadní odpověď.
+    _out.resize(_responseStart);
+    _oversized = true;
+    return;
+  }
+  _out.append(data, len);
+}
+
+inline bool Core::begin() {
+  _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (_listenFd < 0) return false;
+  int one = 1;
+  setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(_listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(_listenFd, kMaxConnections) < 0 || !setNonBlocking(_listenFd)) {
+    close(_listenFd);
+    _listenFd = -1;
+    return false;
+  }
+  return true;
+}
+
+inline void Core::stop() {
+  while (!_conns.empty()) closeConn(_conns.size() - 1);
+  if (_listenFd >= 0) {
+    close(_listenFd);
+    _listenFd = -1;
+  }
+}
+
+inline void Core::poll() {
+  if (_listenFd < 0) return;
+  acceptNew();
+
+  for (size_t i = 0; i < _conns.size();) {
+    Connection &c = *_conns[i];
+    readAvailable(c);
+    process(c);
+    writeOut(c);
+
+    const bool idle = (c._state == Connection::State::Head && c._in.empty() && !c.pendingOut());
+    const uint32_t limit = idle ? kKeepAliveMs : kRequestTimeoutMs;
+    const bool finished = c._closeAfter && !c.pendingOut() && !c._source &&
+                          c._state != Connection::State::Streaming;
+    if (c._dead || finished || (c._peerClosed && !c.pendingOut()) || (nowMs() - c._lastActivity) > limit) {
+      closeConn(i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+inline void Core::acceptNew() {
+  while (_conns.size() < kMaxConnections) {
+    sockaddr_in peer;
+    socklen_t len = sizeof(peer);
+    int fd = accept(_listenFd, reinterpret_cast<sockaddr *>(&peer), &len);
+    if (fd < 0) return;
+    if (!setNonBlocking(fd)) {
+      close(fd);
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::unique_ptr<Connection> c(new Connection());
+    c->_core = this;
+    c->_fd = fd;
+    c->_lastActivity = nowMs();
+    _conns.push_back(std::move(c));
+    _accepted++;
+  }
+}
+
+inline void Core::readAvailable(Connection &c) {
+  if (c._dead || c._peerClosed) return;
+  // Během streamování odpovědi nečteme další požadavky (backpressure pro pipelining).
+  if (c._state == Connection::State::Streaming || c._in.size() >= kMaxHeadBytes + kMaxBodyBytes) return;
+  char buf[1024];
+  for (;;) {
+    ssize_t n = recv(c._fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      c._in.append(buf, static_cast<size_t>(n));
+      c._lastActivity = nowMs();
+      if (c._in.size() >= kMaxHeadBytes + kMaxBodyBytes) return;
+    } else if (n == 0) {
+      c._peerClosed = true;
+      return;
+    } else {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c._dead = true;
+      return;
+    }
+  }
+}
+
+inline void Core::process(Connection &c) {
+  while (!c._dead && !c._closeAfter) {
+    switch (c._state) {
+      case Connection::State::Streaming:
+        return;
+
+      case Connection::State::Head: {
+        // Backpressure: nový požadavek až po odeslání předchozí odpovědi a v rámci rozpočtu.
+        if (c.pendingOut() > kOutLowWater || queuedOut() > kOutBudget) return;
+        size_t end = c._in.find("\r\n\r\n");
+        if (end == std::string::npos) {
+          if (c._in.size() > kMaxHeadBytes) simpleResponse(c, 431, "Request Header Fields Too Large", true);
+          return;
+        }
+        if (!parseHead(c, end)) return;
+        break;
+      }
+
+      case Connection::State::Body:
+        if (c._in.size() < c._req.contentLength) return;
+        c._req.body.assign(c._in, 0, c._req.contentLength);
+        c._in.erase(0, c._req.contentLength);
+        dispatch(c);
+        break;
+
+      case Connection::State::UploadBody: {
+        const size_t n = std::min(c._in.size(), c._bodyRemaining);
+        if (n) {
+          feedUpload(c, c._in.data(), n);
+          c._in.erase(0, n);
+          c._bodyRemaining -= n;
+        }
+        if (c._bodyRemaining > 0) {
+          if (c._peerClosed) finishUpload(c, true);
+          return;
+        }
+        finishUpload(c, false);
+        dispatch(c);
+        break;
+      }
+    }
+  }
+}
+
+inline bool Core::parseHead(Connection &c, size_t headEnd) {
+  Request &r = c._req;
+  r = Request();
+  const std::string head = c._in.substr(0, headEnd);
+  c._in.erase(0, headEnd + 4);
+
+  size_t lineEnd = head.find("\r\n");
+  const std::string line = head.substr(0, lineEnd);
+  size_t sp1 = line.find(' ');
+  size_t sp2 = (sp1 == std::string::npos) ? std::string::npos : line.find(' ', sp1 + 1);
+  if (sp2 == std::string::npos) {
+    simpleResponse(c, 400, "Bad Request", true);
+    return false;
+  }
+  r.method = line.substr(0, sp1);
+  std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  r.version = line.substr(sp2 + 1);
+  size_t q = target.find('?');
+  r.path = urlDecode(target.substr(0, q));
+  if (q != std::string::npos) r.query = target.substr(q + 1);
+
+  size_t pos = (lineEnd == std::string::npos) ? head.size() : lineEnd + 2;
+  while (pos < head.size()) {
+    size_t e = head.find("\r\n", pos);
+    if (e == std::string::npos) e = head.size();
+    const std::string h = head.substr(pos, e - pos);
+    size_t colon = h.find(':');
+    if (colon != std::string::npos) {
+      std::string name = h.substr(0, colon);
+      for (auto &ch : name) ch = lowerAscii(ch);
+      r.headers.emplace_back(name, trimmed(h.substr(colon + 1)));
+    }
+    pos = e + 2;
+  }
+
+  const std::string *conn = r.header("connection");
+  if (r.version == "HTTP/1.0") r.keepAlive = conn && equalsNoCase(*conn, "keep-alive");
+  else r.keepAlive = !(conn && equalsNoCase(*conn, "close"));
+  if (++c._served >= kMaxRequestsPerConnection) r.keepAlive = false;
+
+  if (r.header("transfer-encoding")) {
+    simpleResponse(c, 501, "Not Implemented", true);
+    return false;
+  }
+  const std::string *cl = r.header("content-length");
+  r.contentLength = cl ? strtoul(cl->c_str(), nullptr, 10) : 0;
+  const std::string *expect = r.header("expect");
+  if (expect && equalsNoCase(*expect, "100-continue") && r.contentLength > c._in.size()) {
+    c.write("HTTP/1.1 100 Continue\r\n\r\n", 25);
+  }
+
+  const bool upload = _cb.onHead(c, r);
+  if (c._closeAfter) return false;   // handler požadavek odmítl už podle hlavičky
+  if (upload) {
+    c._bodyRemaining = r.contentLength;
+    c._part = UploadPart();
+    c._mp = Connection::Multipart::None;
+    const std::string *ct = r.header("content-type");
+    size_t b = ct ? ct->find("boundary=") : std::string::npos;
+    if (b != std::string::npos) {
+      std::string boundary = ct->substr(b + 9);
+      size_t semi = boundary.find(';');
+      if (semi != std::string::npos) boundary.erase(semi);
+      if (boundary.size() >= 2 && boundary.front() == '"') boundary = boundary.substr(1, boundary.size() - 2);
+      c._mpDelim = "\r\n--" + boundary;
+      c._mpBuf.clear();
+      c._mp = Connection::Multipart::Preamble;
+    } else {
+      _cb.onBodyChunk(c, r, BodyEvent::Start, c._part, nullptr, 0);
+    }
+    c._state = Connection::State::UploadBody;
+    return true;
+  }
+
+  if (r.contentLength > kMaxBodyBytes) {
+    simpleResponse(c, 413, "Payload Too Large", true);
+    return false;
+  }
+  c._state = Connection::State::Body;
+  return true;
+}
+
+// Streamový parser multipart/form-data: do handleru posílá jen obsah první části se souborem
+// (případně první části vůbec). Drží zpět jen tolik bajtů, kolik je dlouhý oddělovač.
+inline void Core::feedUpload(Connection &c, const char *data, size_t len) {
+  const Request &r = c._req;
+  if (c._mp == Connection::Multipart::None) {
+    _cb.onBodyChunk(c, r, BodyEvent::Data, c._part, reinterpret_cast<const uint8_t *>(data), len);
+    return;
+  }
+
+  std::string &pending = c._mpBuf;
+  pending.append(data, len);
+
+  for (;;) {
+    if (c._mp == Connection::Multipart::Preamble) {
+      // první oddělovač nemá úvodní CRLF
+      const std::string first = c._mpDelim.substr(2) + "\r\n";
+      size_t p = pending.find(first);
+      if (p == std::string::npos) {
+        if (pending.size() > first.size()) pending.erase(0, pending.size() - first.size());
+        return;
+      }
+      pending.erase(0, p + first.size());
+      c._mp = Connection::Multipart::PartHead;
+    }
+    if (c._mp == Connection::Multipart::PartHead) {
+      size_t e = pending.find("\r\n\r\n");
+      if (e == std::string::npos) {
+        if (pending.size() > kMaxHeadBytes) { c._mp = Connection::Multipart::Done; pending.clear(); }
+        return;
+      }
+      const std::string hdr = pending.substr(0, e);
+      pending.erase(0, e + 4);
+      c._part = UploadPart();
+      auto attr = [&](const char *key) {
+        std::string k = std::string(key) + "=\"";
+        size_t a = hdr.find(k);
+        if (a == std::string::npos) return std::string();
+        a += k.size();
+        size_t z = hdr.find('"', a);
+        return hdr.substr(a, z == std::string::npos ? std::string::npos : z - a);
+      };
+      c._part.name = attr("name");
+      c._part.filename = attr("filename");
+      size_t ct = hdr.find("Content-Type:");
+      if (ct != std::string::npos) {
+        size_t z = hdr.find("\r\n", ct);
+        c._part.contentType = trimmed(hdr.substr(ct + 13, z == std::string::npos ? std::string::npos : z - ct - 13));
+      }
+      _cb.onBodyChunk(c, r, BodyEvent::Start, c._part, nullptr, 0);
+      c._mp = Connection::Multipart::Data;
+    }
+    if (c._mp == Connection::Multipart::Data) {
+      size_t p = pending.find(c._mpDelim);
+      if (p == std::string::npos) {
+        const size_t keep = c._mpDelim.size();
+        if (pending.size() > keep) {
+          const size_t n = pending.size() - keep;
+          _cb.onBodyChunk(c, r, BodyEvent::Data, c._part, reinterpret_cast<const uint8_t *>(pending.data()), n);
+          pending.erase(0, n);
+        }
+        return;
+      }
+      if (p) _cb.onBodyChunk(c, r, BodyEvent::Data, c._part, reinterpret_cast<const uint8_t *>(pending.data()), p);
+      _cb.onBodyChunk(c, r, BodyEvent::End, c._part, nullptr, 0);
+      c._mp = Connection::Multipart::Done;
+    }
+    if (c._mp == Connection::Multipart::Done) {
+      pending.clear();  // další části formuláře ignorujeme
+      return;
+    }
+  }
+}
+
+inline void Core::finishUpload(Connection &c, bool aborted) {
+  if (c._mp == Connection::Multipart::None) {
+    _cb.onBodyChunk(c, c._req, aborted ? BodyEvent::Aborted : BodyEvent::End, c._part, nullptr, 0);
+  } else if (c._mp != Connection::Multipart::Done) {
+    // tělo skončilo uprostřed části (nebo žádná část nebyla)
+    if (c._mp == Connection::Multipart::Data) {
+      _cb.onBodyChunk(c, c._req, BodyEvent::Aborted, c._part, nullptr, 0);
+    }
+    c._mp = Connection::Multipart::Done;
+  }
+  if (aborted) c._dead = true;
+}
+
+inline void Core::dispatch(Connection &c) {
+  _requests++;
+  c._source = nullptr;
+  if (c._outOff > 0 && c._outOff == c._out.size()) { c._out.clear(); c._outOff = 0; }
+  c._responseStart = c._out.size();
+  c._inHandler = true;
+  _cb.onRequest(c, c._req);
+  c._inHandler = false;
+  if (c._oversized) {
+    c._oversized = false;
+    c._source = nullptr;
+    simpleResponse(c, 500, "Response Too Large", true);
+  }
+  if (!c._req.keepAlive) c._closeAfter = true;
+  c._state = c._source ? Connection::State::Streaming : Connection::State::Head;
+  c._lastActivity = nowMs();
+}
+
+inline void Core::writeOut(Connection &c) {
+  while (!c._dead) {
+    if (c._source && c.pendingOut() < kOutLowWater) {
+      uint8_t tmp[kSourceChunk];
+      size_t n = c._source(tmp, sizeof(tmp));
+      if (c._sourceChunked) {
+        char hdr[12];
+        int h = snprintf(hdr, sizeof(hdr), "%x\r\n", static_cast<unsigned>(n));
+        c._out.append(hdr, static_cast<size_t>(h));
+        if (n) c._out.append(reinterpret_cast<const char *>(tmp), n);
+        c._out.append("\r\n", 2);
+      } else if (n) {
+        c._out.append(reinterpret_cast<const char *>(tmp), n);
+      }
+      if (n == 0) {
+        c._source = nullptr;
+        c._state = Connection::State::Head;
+        process(c);  // případné pipelinované požadavky čekající v _in
+      }
+    }
+
+    if (!c.pendingOut()) return;
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    ssize_t n = send(c._fd, c._out.data() + c._outOff, c.pendingOut(), flags);
+    if (n > 0) {
+      c._outOff += static_cast<size_t>(n);
+      c._lastActivity = nowMs();
+      if (c._outOff == c._out.size()) {
+        c._out.clear();
+        c._outOff = 0;
+      } else if (c._outOff > kOutHighWater) {
+        c._out.erase(0, c._outOff);
+        c._outOff = 0;
+      }
+    } else {
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) c._dead = true;
+      return;
+    }
+  }
+}
+
+inline void Core::simpleResponse(Connection &c, int code, const char *reason, bool close) {
+  char buf[160];
+  int n = snprintf(buf, sizeof(buf),
+                   "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %u\r\nConnection: %s\r\n\r\n%s",
+                   code, reason, static_cast<unsigned>(strlen(reason)), close ? "close" : "keep-alive", reason);
+  c.write(buf, static_cast<size_t>(n));
+  if (close) c.closeAfterResponse();
+}
+
+inline void Core::closeConn(size_t idx) {
+  Connection &c = *_conns[idx];
+  if (c._state == Connection::State::UploadBody) finishUpload(c, true);
+  _cb.onClosed(c);
+  if (c._fd >= 0) close(c._fd);
+  _conns.erase(_conns.begin() + idx);
+}
+
+}  // namespace http
+
+#if defined(ARDUINO)
+#include <Arduino.h>
+#include <WebServer.h>   // jen typy HTTPMethod / HTTPUpload / CONTENT_LENGTH_UNKNOWN (sdílené s WiFiManagerem)
+
+// Fasáda kompatibilní s WebServer: handlery volají server.arg()/send()/sendContent() jako dřív.
+class IrWebServer : private http::Core::Callbacks {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+
+  explicit IrWebServer(uint16_t port) : _core(port, *this) {}
+
+  void on(const char *uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+  void on(const char *uri, HTTPMethod method, THandlerFunction fn) { on(uri, method, fn, nullptr); }
+  void on(const char *uri, HTTPMethod method, THandlerFunction fn, THandlerFunction upload) {
+    _routes.push_back(Route{ uri, method, fn, upload });
+  }
+
+  void begin() {
+    if (!_core.begin()) Serial.println(F("[NET] HTTP server: bind/listen selhal."));
+  }
+  void handleClient() { _core.poll(); }
+
+  // --- požadavek ---
+  bool hasArg(const String &name) const { return findArg(name) != nullptr; }
+  String arg(const String &name) const {
+    const std::string *v = findArg(name);
+    return v ? String(v->c_str()) : String();
+  }
+  bool hasHeader(const String &name) const { return headerPtr(name) != nullptr; }
+  String header(const String &name) const {
+    const std::string *v = headerPtr(name);
+    return v ? String(v->c_str()) : String();
+  }
+  void collectHeaders(const char **, size_t) {}   // hlavičky se drží vždy
+  HTTPMethod method() const { return _method; }
+  String uri() const { return _req ? String(_req->path.c_str()) : String(); }
+  HTTPUpload &upload() { return _upload; }
+
+  // --- odpověď ---
+  void sendHeader(const String &name, const String &value, bool first = false) {
+    std::string h = std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+    if (first) _extraHeaders.insert(0, h);
+    else _extraHeaders += h;
+  }
+  void setContentLength(size_t len) {
+    _contentLength = len;
+    _contentLengthSet = true;
+  }
+
+  void send(int code, const char *contentType = nullptr, const String &content = String()) {
+    sendRaw(code, contentType, content.c_str(), content.length());
+  }
+  void send(int code, const String &contentType, const String &content) {
+    sendRaw(code, contentType.c_str(), content.c_str(), content.length());
+  }
+  void sendContent(const String &content) { sendContent(content.c_str(), content.length()); }
+  void sendContent(const char *data, size_t len) {
+    if (!_conn || _headOnly) return;
+    if (!_chunked) {
+      _conn->write(data, len);
+      return;
+    }
+    if (_chunkedDone) return;
+    char hdr[12];
+    int h = snprintf(hdr, sizeof(hdr), "%x\r\n", static_cast<unsigned>(len));
+    _conn->write(hdr, static_cast<size_t>(h));
+    if (len) _conn->write(data, len);
+    _conn->write("\r\n", 2);
+    if (len == 0) _chunkedDone = true;
+  }
+
+  // Velká odpověď generovaná průběžně – server si data dotahuje, jak je klient odebírá.
+  void sendStream(int code, const char *contentType, http::BodySource source) {
+    if (!_conn || _responded) return;
+    writeHead(code, contentType, CONTENT_LENGTH_UNKNOWN);
+    if (!_headOnly) _conn->setBodySource(std::move(source), true);
+    _chunkedDone = true;
+  }
+
+  uint32_t requests() const { return _core.requests(); }
+  uint32_t connectionsAccepted() const { return _core.accepted(); }
+  size_t   activeConnections() const { return _core.activeConnections(); }
+  uint32_t oversizedResponses() const { return _core.oversized(); }
+
+private:
+  struct Route {
+    String           uri;
+    HTTPMethod       method;
+    THandlerFunction fn;
+    THandlerFunction upload;
+  };
+
+  http::Core               _core;
+  std::vector<Route>       _routes;
+  // kontext právě obsluhovaného požadavku
+  http::Connection        *_conn = nullptr;
+  const http::Request     *_req = nullptr;
+  const Route             *_route = nullptr;
+  HTTPMethod               _method = HTTP_GET;
+  std::vector<std::pair<std::string, std::string>> _args;
+  std::string              _extraHeaders;
+  size_t                   _contentLength = 0;
+  bool                     _contentLengthSet = false;
+  bool                     _responded = false;
+  bool                     _chunked = false;
+  bool                     _chunkedDone = false;
+  bool                     _headOnly = false;   // HEAD: hlavičky jako u GET (i Content-Length), bez těla
+  HTTPUpload               _upload;
+  // Upload handlery pracují se sdíleným stavem (HTTPUpload, dočasný soubor), proto
+  // najednou běží jen jeden upload; další dostane 409, dokud první požadavek neskončí.
+  const http::Connection  *_uploadConn = nullptr;
+
+  static HTTPMethod parseMethod(const std::string &m) {
+    if (m == "GET") return HTTP_GET;
+    if (m == "POST") return HTTP_POST;
+    if (m == "PUT") return HTTP_PUT;
+    if (m == "DELETE") return HTTP_DELETE;
+    if (m == "PATCH") return HTTP_PATCH;
+    if (m == "HEAD") return HTTP_HEAD;
+    if (m == "OPTIONS") return HTTP_OPTIONS;
+    return HTTP_ANY;
+  }
+
+  static const char *reasonPhrase(int code) {
+    switch (code) {
+      case 200: return "OK";
+      case 204: return "No Content";
+      case 302: return "Found";
+      case 400: return "Bad Request";
+      case 404: return "Not Found";
+      case 409: return "Conflict";
+      case 413: return "Payload Too Large";
+      case 500: return "Internal Server Error";
+      case 501: return "Not Implemented";
+      case 503: return "Service Unavailable";
+      default:  return "OK";
+    }
+  }
+
+  const std::string *findArg(const String &name) const {
+    for (const auto &a : _args) if (a.first == name.c_str()) return &a.second;
+    return nullptr;
+  }
+
+  const std::string *headerPtr(const String &name) const {
+    if (!_req) return nullptr;
+    std::string n(name.c_str());
+    for (auto &ch : n) ch = http::lowerAscii(ch);
+    return _req->header(n.c_str());
+  }
+
+  // HEAD obslouží i GET route (RFC 9110: stejné hlavičky jako GET).
+  const Route *findRoute(const http::Request &r) const {
+    const HTTPMethod m = parseMethod(r.method);
+    for (const Route &rt : _routes) {
+      if (r.path != rt.uri.c_str()) continue;
+      if (rt.method == HTTP_ANY || rt.method == m || (m == HTTP_HEAD && rt.method == HTTP_GET)) return &rt;
+    }
+    return nullptr;
+  }
+
+  void beginContext(http::Connection &c, const http::Request &r) {
+    _conn = &c;
+    _req = &r;
+    _route = findRoute(r);
+    _method = parseMethod(r.method);
+    _args.clear();
+    http::parseUrlEncoded(r.query, _args);
+    _extraHeaders.clear();
+    _contentLength = 0;
+    _contentLengthSet = false;
+    _responded = false;
+    _chunked = false;
+    _chunkedDone = false;
+    _headOnly = (_method == HTTP_HEAD);
+  }
+
+  void writeHead(int code, const char *contentType, size_t length) {
+    std::string h;
+    h.reserve(160 + _extraHeaders.size());
+    char line[48];
+    snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", code, reasonPhrase(code));
+    h += line;
+    if (contentType && *contentType) { h += "Content-Type: "; h += contentType; h += "\r\n"; }
+    if (length == CONTENT_LENGTH_UNKNOWN) {
+      h += "Transfer-Encoding: chunked\r\n";
+      _chunked = true;
+    } else {
+      snprintf(line, sizeof(line), "Content-Length: %u\r\n", static_cast<unsigned>(length));
+      h += line;
+    }
+    h += _req && _req->keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    h += _extraHeaders;
+    h += "\r\n";
+    _conn->write(h);
+    _extraHeaders.clear();
+    _responded = true;
+  }
+
+  void sendRaw(int code, const char *contentType, const char *body, size_t len) {
+    if (!_conn || _responded) return;
+    const size_t declared = _contentLengthSet ? _contentLength : len;
+    writeHead(code, contentType, declared);
+    if (_headOnly) {
+      _chunkedDone = true;
+    } else if (_chunked) {
+      if (len) sendContent(body, len);   // WebServer tělo u chunked posílá jako první chunk
+    } else if (len) {
+      _conn->write(body, len);
+    }
+  }
+
+  // --- http::Core::Callbacks ---
+  bool onHead(http::Connection &c, const http::Request &r) override {
+    beginContext(c, r);
+    if (!_route || !_route->upload) return false;
+    if (_uploadConn && _uploadConn != &c) {
+      http::Core::simpleResponse(c, 409, "Upload already in progress", true);
+      return false;
+    }
+    _uploadConn = &c;
+    return true;
+  }
+
+  void onClosed(http::Connection &c) override {
+    if (_uploadConn == &c) _uploadConn = nullptr;
+  }
+
+  void onBodyChunk(http::Connection &c, const http::Request &r, http::BodyEvent ev,
+                   const http::UploadPart &part, const uint8_t *data, size_t len) override {
+    // mezi bloky těla mohlo jiné spojení přepsat kontext požadavku
+    if (_req != &r || _conn != &c) beginContext(c, r);
+    if (!_route || !_route->upload) return;
+    switch (ev) {
+      case http::BodyEvent::Start:
+        _upload.status = UPLOAD_FILE_START;
+        _upload.filename = String(part.filename.c_str());
+        _upload.name = String(part.name.c_str());
+        _upload.type = String(part.contentType.c_str());
+        _upload.totalSize = 0;
+        _upload.currentSize = 0;
+        _route->upload();
+        break;
+      case http::BodyEvent::Data:
+        while (len) {
+          const size_t n = std::min(len, static_cast<size_t>(HTTP_UPLOAD_BUFLEN));
+          memcpy(_upload.buf, data, n);
+          _upload.status = UPLOAD_FILE_WRITE;
+          _upload.currentSize = n;
+          _upload.totalSize += n;
+          _route->upload();
+          data += n;
+          len -= n;
+        }
+        break;
+      case http::BodyEvent::End:
+      case http::BodyEvent::Aborted:
+        _upload.status = (ev == http::BodyEvent::End) ? UPLOAD_FILE_END : UPLOAD_FILE_ABORTED;
+        _upload.currentSize = 0;
+        _route->upload();
+        break;
+    }
+  }
+
+  void onRequest(http::Connection &c, http::Request &r) override {
+    if (_req != &r || _conn != &c) beginContext(c, r);
+    if (!r.body.empty()) {
+      const std::string *ct = r.header("content-type");
+      if (ct && ct->find("application/x-www-form-urlencoded") != std::string::npos) {
+        http::parseUrlEncoded(r.body, _args);
+      }
+      _args.emplace_back("plain", r.body);
+    }
+
+    if (!_route) {
+      send(404, "text/plain", F("Not found"));
+    } else {
+      _route->fn();
+      if (!_responded) send(500, "text/plain", F("No response"));
+      if (_chunked && !_chunkedDone) sendContent("", 0);
+    }
+    if (_uploadConn == &c) _uploadConn = nullptr;
+    _conn = nullptr;
+    _req = nullptr;
+    _route = nullptr;
+  }
+};
+#endif  // ARDUINO
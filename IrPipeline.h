@@ -0,0 +1,229 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+// ====== Přehled ======
+// Stavební kameny přijímací pipeline (capture/decode → match → history/log → notify).
+// Záměrně bez závislosti na Arduino/IRremote – hlavička se přeloží i na hostu (std::thread),
+// na ESP32 běží nad FreeRTOS (std::mutex/condition_variable jsou v ESP-IDF nad pthread).
+// - BoundedQueue      … fronta rámců/řádků mezi tasky, producent nikdy neblokuje,
+// - IrRxPipeline      … producent (rx task: sniffer + dekodér) → fronta → spotřebitel v loop(),
+//                       TxScope drží producenta stranou po dobu vysílání,
+// - startPipelineWorker/pipelineYield … task/vlákno podle platformy.
+
+// Omezená FIFO fronta s pevnou kapacitou (bez alokací za běhu).
+// Producent nikdy neblokuje – při plné frontě položku zahodí a započítá do dropped().
+template <typename T, size_t N>
+class BoundedQueue {
+public:
+  static_assert(N > 0, "BoundedQueue musí mít nenulovou kapacitu");
+
+  bool tryPush(const T &item) {
+    return emplace([&item](T &slot) { slot = item; });
+  }
+
+  // Přesun (String, vektory) – při plné frontě zůstane item nedotčený.
+  bool tryPush(T &&item) {
+    return emplace([&item](T &slot) { slot = std::move(item); });
+  }
+
+  bool tryPop(T &out) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return popLocked(out);
+  }
+
+  // Čeká nejvýše timeoutMs na položku (pro spotřebitele ve vlastním tasku).
+  bool popWait(T &out, uint32_t timeoutMs) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (!_cv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return _count > 0; })) {
+      return false;
+    }
+    return popLocked(out);
+  }
+
+  size_t   size() const      { std::lock_guard<std::mutex> lock(_mutex); return _count; }
+  size_t   capacity() const  { return N; }
+  uint32_t pushed() const    { return _pushed; }
+  uint32_t dropped() const   { return _dropped; }
+  size_t   highWater() const { return _highWater; }
+
+private:
+  template <typename Assign>
+  bool emplace(Assign assign) {
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (_count == N) {
+        _dropped++;
+        return false;
+      }
+      assign(_items[(_head + _count) % N]);
+      _count++;
+      _pushed++;
+      if (_count > _highWater) _highWater = _count;
+    }
+    _cv.notify_one();
+    return true;
+  }
+
+  bool popLocked(T &out) {
+    if (_count == 0) return false;
+    out = std::move(_items[_head]);
+    _head = (_head + 1) % N;
+    _count--;
+    return true;
+  }
+
+  T        _items[N];
+  size_t   _head = 0;
+  size_t   _count = 0;
+  size_t   _highWater = 0;
+  volatile uint32_t _pushed = 0;
+  volatile uint32_t _dropped = 0;
+  mutable std::mutex _mutex;
+  std::condition_variable _cv;
+};
+
+// Spustí fn(arg) ve vlastním vlákně: FreeRTOS task na ESP32, std::thread jinde.
+inline bool startPipelineWorker(const char *name, void (*fn)(void *), void *arg,
+                                uint32_t stackBytes, uint8_t priority) {
+#if defined(ESP32)
+  return xTaskCreate(fn, name, stackBytes, arg, priority, nullptr) == pdPASS;
+#else
+  (void)name; (void)stackBytes; (void)priority;
+  std::thread(fn, arg).detach();
+  return true;
+#endif
+}
+
+// Krátké uvolnění CPU v pracovní smyčce.
+inline void pipelineYield(uint32_t ms) {
+#if defined(ESP32)
+  vTaskDelay(pdMS_TO_TICKS(ms ? ms : 1));
+#else
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms ? ms : 1));
+#endif
+}
+
+// Výsledek jednoho obsloužení zdroje rámců.
+enum class IrRxPoll : uint8_t {
+  Idle,    // nic nového (producent může uvolnit CPU)
+  Busy,    // zdroj pracoval, rámec ale nevznikl (šum, odmítnutý rámec)
+  Frame,   // pracovní rámec je hotový – jde do fronty
+};
+
+// Přijímací pipeline: producent (vlastní task) obslouží oba zdroje – sniffer a dekodér – nad
+// jedním pracovním rámcem a hotový rámec zkopíruje do fronty; spotřebitel v loop() jich za kolo
+// zpracuje nejvýš PerService. Bez tasku běží obě strany v loop() (service()).
+// Typ rámce a jednotlivé kroky dodá sketch, tady je jen pořadí, fronta a zámek rádia.
+// Producent běží pod zámkem rádia; TxScope ho drží po dobu vysílání a přes hooky zastaví
+// přijímač, takže decode()/resume() nikdy neběží souběžně se send*() z loop().
+template <typename Frame, size_t QueueLen, size_t PerService>
+class IrRxPipeline {
+public:
+  using Source = IrRxPoll (*)(Frame &work);
+  using Sink   = void (*)(const Frame &frame);
+  using Hook   = void (*)();
+
+  IrRxPipeline(Source capture, Source decode, Sink process)
+      : _capture(capture), _decode(decode), _process(process) {}
+
+  // suspend se volá před vysíláním (už pod zámkem), resume po něm.
+  void setRadioHooks(Hook suspend, Hook resume) {
+    _suspend = suspend;
+    _resume = resume;
+  }
+
+  bool startTask(const char *name, uint32_t stackBytes, uint8_t priority) {
+    _stop = false;
+    _taskRunning = startPipelineWorker(name, taskMain, this, stackBytes, priority);
+    return _taskRunning;
+  }
+
+  // Ukončí task po dokončení rozpracovaného kola (host testy; na zařízení task běží stále).
+  void stopTask() {
+    _stop = true;
+    while (_taskRunning) pipelineYield(1);
+  }
+
+  bool taskRunning() const { return _taskRunning; }
+
+  // Jedno kolo producenta; false = oba zdroje byly bez práce.
+  bool produce() {
+    std::lock_guard<std::mutex> lock(_radio);
+    const IrRxPoll a = _capture(_work);
+    if (a == IrRxPoll::Frame) _queue.tryPush(_work);
+    const IrRxPoll b = _decode(_work);
+    if (b == IrRxPoll::Frame) _queue.tryPush(_work);
+    return a != IrRxPoll::Idle || b != IrRxPoll::Idle;
+  }
+
+  // Spotřebitel (loop): nejvýš PerService rámců, ať web nečeká. Vrací počet zpracovaných.
+  size_t consume() {
+    size_t n = 0;
+    while (n < PerService && _queue.tryPop(_proc)) {
+      _process(_proc);
+      n++;
+    }
+    return n;
+  }
+
+  // Obsluha z loop(): bez tasku i capture/decode (fallback), pak spotřebitel.
+  size_t service() {
+    if (!_taskRunning) produce();
+    return consume();
+  }
+
+  const BoundedQueue<Frame, QueueLen> &queue() const { return _queue; }
+
+  // Vysílání: po dobu života objektu producent neběží a přijímač stojí.
+  class TxScope {
+  public:
+    explicit TxScope(IrRxPipeline &p) : _p(p), _lock(p._radio) {
+      if (_p._suspend) _p._suspend();
+    }
+    ~TxScope() {
+      if (_p._resume) _p._resume();
+    }
+    TxScope(const TxScope &) = delete;
+    TxScope &operator=(const TxScope &) = delete;
+
+  private:
+    IrRxPipeline &_p;
+    std::lock_guard<std::mutex> _lock;
+  };
+
+private:
+  Source _capture;
+  Source _decode;
+  Sink   _process;
+  Hook   _suspend = nullptr;
+  Hook   _resume = nullptr;
+  BoundedQueue<Frame, QueueLen> _queue;
+  Frame  _work;    // pracovní rámec producenta
+  Frame  _proc;    // pracovní rámec spotřebitele
+  std::mutex _radio;
+  std::atomic<bool> _taskRunning{false};
+  std::atomic<bool> _stop{false};
+
+  static void taskMain(void *arg) {
+    IrRxPipeline *p = static_cast<IrRxPipeline *>(arg);
+    while (!p->_stop) {
+      if (!p->produce()) pipelineYield(1);
+    }
+    p->_taskRunning = false;
+#if defined(ESP32)
+    vTaskDelete(nullptr);   // FreeRTOS task se nesmí vrátit
+#endif
+  }
+};
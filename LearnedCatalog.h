@@ -0,0 +1,276 @@
+#pragma once
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <algorithm>
+#include <vector>
+
+// ====== Přehled ======
+// Stránkovaný katalog naučených kódů nad JSONL souborem (jeden kód = jeden řádek s "id").
+// V RAM je jen:
+// - index klíčů: 16bit hash (value, bits, addr) + pořadí řádku, seřazeno podle hashe (4 B / kód),
+// - tabulka stránek: offset v souboru a první id každé stránky kPageSize kódů,
+// - LRU kPageCache načtených stránek s plnými metadaty.
+// Ostatní se čte z flash na vyžádání. Soubor je seřazen podle id (nová id jen rostou), takže
+// hledání podle id je binární vyhledávání ve stránkách a ordinal → stránka je prosté dělení.
+// Entry musí mít členy id, value, bits, addr; parse() vrací false pro řádky, které nejsou kódem.
+// Index má strop kMaxEntries kódů; build() kódy nad ním nezaindexuje, ale ohlásí je (skipped())
+// a započítá jejich id, aby se nepoužila znovu. Při full() má volající nové kódy odmítnout.
+
+template <typename Entry>
+class LearnedCatalog {
+public:
+  static constexpr uint16_t kPageSize   = 32;
+  static constexpr uint8_t  kPageCache  = 4;
+  static constexpr uint32_t kMaxEntries = 0xFFFF;   // ordinal v indexu klíčů je 16bit
+
+  typedef bool (*ParseFn)(const String &line, Entry &out);
+
+  LearnedCatalog(const char *path, ParseFn parse) : _path(path), _parse(parse) {}
+
+  // Projde soubor a postaví index. needsMigration = chybí/nerostoucí "id" nebo slepené řádky.
+  // false = soubor má víc než kMaxEntries kódů, zbytek (skipped()) není dostupný přes index.
+  bool build(bool &needsMigration);
+  void invalidate() { _built = false; _pages.clear(); _keys.clear(); _cache.clear(); _count = 0; _skipped = 0; }
+  bool built() const { return _built; }
+
+  uint32_t count() const  { return _count; }
+  uint32_t skipped() const { return _skipped; }
+  bool     full() const   { return _count >= kMaxEntries; }
+  uint32_t nextId() const { return _nextId; }
+  void     reserveId(uint32_t id) { if (id >= _nextId) _nextId = id + 1; }
+
+  bool getById(uint32_t id, Entry &out);
+  bool getByOrdinal(uint32_t ordinal, Entry &out);
+  bool findByKey(uint32_t value, uint8_t bits, uint32_t addr, Entry &out);
+  // Pořadí prvního kódu s id >= id (count() = žádný) – stránkování podle id bez průchodu souborem.
+  uint32_t ordinalForId(uint32_t id);
+
+  // Zápis nového řádku na konec souboru už proběhl; offset = velikost souboru před zápisem.
+  void noteAppended(const Entry &e, uint32_t offset);
+
+  // Sekvenční průchod všemi kódy (dotazy s filtrem) – nepoužívá ani nezahlcuje cache stránek.
+  template <typename Fn>
+  void scan(Fn &&fn) const;
+
+  size_t pageCount() const   { return _pages.size(); }
+  size_t cachedPages() const { return _cache.size(); }
+  size_t indexBytes() const  { return _keys.capacity() * sizeof(KeySlot) + _pages.capacity() * sizeof(PageInfo); }
+  uint32_t pageLoads() const { return _pageLoads; }
+
+  static uint16_t keyHash(uint32_t value, uint8_t bits, uint32_t addr) {
+    uint32_t h = value * 0x9E3779B1u;
+    h ^= (addr + 0x7F4A7C15u + (h << 6) + (h >> 2));
+    h ^= static_cast<uint32_t>(bits) * 0x85EBCA77u;
+    return static_cast<uint16_t>(h ^ (h >> 16));
+  }
+
+private:
+  struct KeySlot {
+    uint16_t hash;
+    uint16_t ordinal;
+  };
+  struct PageInfo {
+    uint32_t offset;
+    uint32_t firstId;
+  };
+  struct CachedPage {
+    uint32_t           page;
+    uint32_t           lastUse;
+    std::vector<Entry> items;
+  };
+
+  const char             *_path;
+  ParseFn                 _parse;
+  bool                    _built = false;
+  uint32_t                _count = 0;
+  uint32_t                _skipped = 0;
+  uint32_t                _nextId = 1;
+  uint32_t                _tick = 0;
+  uint32_t                _pageLoads = 0;
+  std::vector<KeySlot>    _keys;
+  std::vector<PageInfo>   _pages;
+  std::vector<CachedPage> _cache;
+
+  const Entry *entryAt(uint32_t ordinal);
+  const CachedPage *loadPage(uint32_t page);
+  static bool keyLess(const KeySlot &a, const KeySlot &b) { return a.hash < b.hash; }
+};
+
+// ====== Inline implementace ======
+
+template <typename Entry>
+bool LearnedCatalog<Entry>::build(bool &needsMigration) {
+  invalidate();
+  needsMigration = false;
+  File f = LittleFS.open(_path, FILE_READ);
+  if (!f) {
+    _built = true;
+    return true;
+  }
+
+  uint32_t lastId = 0;
+  Entry e;
+  while (f.available()) {
+    const uint32_t offset = static_cast<uint32_t>(f.position());
+    String line = f.readStringUntil('\n');
+    line.trim();
+    if (!line.length()) continue;
+    if (line.indexOf(F("}{")) >= 0) needsMigration = true;
+    e = Entry();
+    if (!_parse(line, e)) continue;
+    if (e.id == 0 || e.id <= lastId) needsMigration = true;
+    lastId = std::max<uint32_t>(lastId, e.id);
+    if (_count >= kMaxEntries) {
+      _skipped++;
+      continue;
+    }
+
+    if (_count % kPageSize == 0) _pages.push_back(PageInfo{ offset, e.id });
+    _keys.push_back(KeySlot{ keyHash(e.value, e.bits, e.addr), static_cast<uint16_t>(_count) });
+    _count++;
+  }
+  f.close();
+
+  std::stable_sort(_keys.begin(), _keys.end(), keyLess);
+  _keys.shrink_to_fit();    // rezerva po zdvojování kapacity by u tisíců kódů byla desítky KB
+  _pages.shrink_to_fit();
+  reserveId(lastId);
+  _built = true;
+  return _skipped == 0;
+}
+
+template <typename Entry>
+const typename LearnedCatalog<Entry>::CachedPage *LearnedCatalog<Entry>::loadPage(uint32_t page) {
+  for (CachedPage &c : _cache) {
+    if (c.page == page) {
+      c.lastUse = ++_tick;
+      return &c;
+    }
+  }
+  if (page >= _pages.size()) return nullptr;
+
+  File f = LittleFS.open(_path, FILE_READ);
+  if (!f) return nullptr;
+  f.seek(_pages[page].offset);
+  const uint32_t want = std::min<uint32_t>(kPageSize, _count - page * kPageSize);
+  std::vector<Entry> items;
+  items.reserve(want);
+  Entry e;
+  while (items.size() < want && f.available()) {
+    String line = f.readStringUntil('\n');
+    line.trim();
+    e = Entry();
+    if (line.length() && _parse(line, e)) items.push_back(e);
+  }
+  f.close();
+  _pageLoads++;
+
+  if (_cache.size() >= kPageCache) {
+    size_t oldest = 0;
+    for (size_t i = 1; i < _cache.size(); ++i) {
+      if (_cache[i].lastUse < _cache[oldest].lastUse) oldest = i;
+    }
+    _cache.erase(_cache.begin() + oldest);
+  }
+  _cache.push_back(CachedPage{ page, ++_tick, std::move(items) });
+  return &_cache.back();
+}
+
+template <typename Entry>
+const Entry *LearnedCatalog<Entry>::entryAt(uint32_t ordinal) {
+  if (ordinal >= _count) return nullptr;
+  const CachedPage *p = loadPage(ordinal / kPageSize);
+  const uint32_t slot = ordinal % kPageSize;
+  return (p && slot < p->items.size()) ? &p->items[slot] : nullptr;
+}
+
+template <typename Entry>
+bool LearnedCatalog<Entry>::getByOrdinal(uint32_t ordinal, Entry &out) {
+  const Entry *e = entryAt(ordinal);
+  if (!e) return false;
+  out = *e;
+  return true;
+}
+
+template <typename Entry>
+bool LearnedCatalog<Entry>::getById(uint32_t id, Entry &out) {
+  if (!id || _pages.empty()) return false;
+  // poslední stránka s firstId <= id
+  auto it = std::upper_bound(_pages.begin(), _pages.end(), id,
+                             [](uint32_t v, const PageInfo &p) { return v < p.firstId; });
+  if (it == _pages.begin()) return false;
+  const CachedPage *p = loadPage(static_cast<uint32_t>((it - _pages.begin()) - 1));
+  if (!p) return false;
+  auto e = std::lower_bound(p->items.begin(), p->items.end(), id,
+                            [](const Entry &x, uint32_t v) { return x.id < v; });
+  if (e == p->items.end() || e->id != id) return false;
+  out = *e;
+  return true;
+}
+
+template <typename Entry>
+uint32_t LearnedCatalog<Entry>::ordinalForId(uint32_t id) {
+  auto it = std::upper_bound(_pages.begin(), _pages.end(), id,
+                             [](uint32_t v, const PageInfo &p) { return v < p.firstId; });
+  if (it == _pages.begin()) return 0;
+  const uint32_t page = static_cast<uint32_t>((it - _pages.begin()) - 1);
+  const CachedPage *p = loadPage(page);
+  if (!p) return _count;
+  auto e = std::lower_bound(p->items.begin(), p->items.end(), id,
+                            [](const Entry &x, uint32_t v) { return x.id < v; });
+  return std::min<uint32_t>(page * kPageSize + static_cast<uint32_t>(e - p->items.begin()), _count);
+}
+
+template <typename Entry>
+bool LearnedCatalog<Entry>::findByKey(uint32_t value, uint8_t bits, uint32_t addr, Entry &out) {
+  const KeySlot probe{ keyHash(value, bits, addr), 0 };
+  auto range = std::equal_range(_keys.begin(), _keys.end(), probe, keyLess);
+  for (auto it = range.first; it != range.second; ++it) {
+    const Entry *e = entryAt(it->ordinal);
+    if (e && e->value == value && e->bits == bits && e->addr == addr) {
+      out = *e;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename Entry>
+void LearnedCatalog<Entry>::noteAppended(const Entry &e, uint32_t offset) {
+  if (!_built || _count >= kMaxEntries) {
+    invalidate();
+    return;
+  }
+  const uint32_t ordinal = _count;
+  if (ordinal % kPageSize == 0) _pages.push_back(PageInfo{ offset, e.id });
+  const KeySlot slot{ keyHash(e.value, e.bits, e.addr), static_cast<uint16_t>(ordinal) };
+  _keys.insert(std::upper_bound(_keys.begin(), _keys.end(), slot, keyLess), slot);
+  _count++;
+  reserveId(e.id);
+
+  // poslední stránka v cache by byla neúplná
+  const uint32_t page = ordinal / kPageSize;
+  for (size_t i = 0; i < _cache.size(); ++i) {
+    if (_cache[i].page == page) {
+      _cache.erase(_cache.begin() + i);
+      break;
+    }
+  }
+}
+
+template <typename Entry>
+template <typename Fn>
+void LearnedCatalog<Entry>::scan(Fn &&fn) const {
+  File f = LittleFS.open(_path, FILE_READ);
+  if (!f) return;
+  Entry e;
+  while (f.available()) {
+    String line = f.readStringUntil('\n');
+    line.trim();
+    e = Entry();
+    if (line.length() && _parse(line, e)) {
+      if (!fn(e)) break;
+    }
+  }
+  f.close();
+}
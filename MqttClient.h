@@ -0,0 +1,539 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// ====== Přehled ======
+// Minimální neblokující MQTT 3.1.1 klient nad BSD sockety (lwIP na ESP32, POSIX na Linuxu).
+// - PUBLISH s QoS 0 (volitelně retain), SUBSCRIBE s QoS 0, keep-alive (PINGREQ), last will,
+// - navázání spojení ani čtení/zápis neblokují loop(): poll() jen posune stavový automat,
+// - po výpadku se připojuje znovu s exponenciálním odstupem (kReconnectMinMs..kReconnectMaxMs),
+// - zprávy během výpadku (i při zahlceném socketu) čekají v omezené frontě; retain zprávy se
+//   stejným topicem se slučují (drží se jen poslední stav), při přetečení se zahazují nejstarší.
+// Odběry se po každém (re)connectu obnoví. Data už předaná socketu se při výpadku ztratí (QoS 0).
+// DNS (getaddrinfo) blokuje loop(), proto se adresa brokeru drží v cache a překládá se znovu
+// nejvýš jednou za kDnsRefreshMs (i po neúspěchu); mezi tím se použije poslední známá adresa,
+// bez ní pokus hned selže. Číselná IP se nepřekládá.
+// Jádro nepoužívá Arduino typy a přeloží se i na Linuxu (test proti lokálnímu brokeru).
+
+namespace mqtt {
+
+static constexpr size_t   kMaxPacketBytes   = 16384;   // větší příchozí zpráva = chyba spojení
+static constexpr size_t   kQueueMaxMessages = 32;
+static constexpr size_t   kQueueMaxBytes    = 8192;
+static constexpr size_t   kOutHighWater     = 4096;    // nad tím se publish řadí do fronty
+static constexpr uint32_t kConnectTimeoutMs = 5000;    // TCP connect + CONNACK
+static constexpr uint32_t kReconnectMinMs   = 1000;
+static constexpr uint32_t kReconnectMaxMs   = 60000;
+static constexpr uint32_t kDnsRefreshMs     = 300000;  // nejkratší odstup dvou DNS dotazů
+
+struct Config {
+  std::string host;            // prázdné = klient vypnutý
+  uint16_t    port = 1883;
+  std::string clientId;
+  std::string user;            // prázdné = bez přihlášení
+  std::string pass;
+  std::string statusTopic;     // last will "offline" / po CONNACK "online" (retain); prázdné = bez
+  uint16_t    keepAliveS = 30;
+};
+
+using MessageHandler = std::function<void(const std::string &topic, const std::string &payload)>;
+
+inline uint32_t nowMs() {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+class Client {
+public:
+  enum class State : uint8_t { Disabled, Backoff, Connecting, AwaitConnAck, Connected };
+
+  Client() {}
+  ~Client() { closeSocket(); }
+
+  // (Re)konfigurace; běžící spojení se ukončí a naváže podle nové konfigurace.
+  // Zruší i dosavadní odběry – subscribe() se volá po begin().
+  void begin(const Config &cfg);
+  void stop();
+  void poll();
+
+  // Odběr se pamatuje a obnoví po každém připojení.
+  void subscribe(const std::string &filter);
+  void onMessage(MessageHandler handler) { _handler = std::move(handler); }
+
+  // false = zpráva zahozena (klient vypnutý / větší než celá fronta); jinak odeslána nebo ve frontě.
+  bool publish(const std::string &topic, const std::string &payload, bool retain = false);
+
+  State state() const        { return _state; }
+  bool  connected() const    { return _state == State::Connected; }
+  const Config &config() const { return _cfg; }
+
+  uint32_t published() const  { return _published; }
+  uint32_t received() const   { return _received; }
+  uint32_t dropped() const    { return _dropped; }
+  uint32_t connects() const   { return _connects; }
+  uint32_t failures() const   { return _failures; }
+  uint32_t dnsLookups() const { return _dnsLookups; }
+  size_t   queued() const     { return _queue.size(); }
+  size_t   queuedBytes() const { return _queueBytes; }
+  uint32_t backoffMs() const  { return _backoffMs; }
+  const char *lastError() const { return _lastError; }
+
+private:
+  struct Pending {
+    std::string topic;
+    std::string payload;
+    bool        retain;
+  };
+
+  Config                   _cfg;
+  State                    _state = State::Disabled;
+  int                      _fd = -1;
+  std::string              _in;
+  std::string              _out;
+  size_t                   _outOff = 0;
+  std::deque<Pending>      _queue;
+  size_t                   _queueBytes = 0;
+  std::vector<std::string> _subs;
+  MessageHandler           _handler;
+  uint16_t                 _packetId = 0;
+  uint32_t                 _stateSince = 0;
+  uint32_t                 _nextAttempt = 0;
+  uint32_t                 _backoffMs = kReconnectMinMs;
+  uint32_t                 _lastTx = 0;
+  uint32_t                 _pingSentAt = 0;
+  bool                     _pingOutstanding = false;
+  const char              *_lastError = "";
+
+  uint32_t _published = 0;
+  uint32_t _received = 0;
+  uint32_t _dropped = 0;
+  uint32_t _connects = 0;
+  uint32_t _failures = 0;
+  uint32_t _dnsLookups = 0;
+  // cache DNS: adresa pro _dnsHost, další dotaz až po _dnsNextMs
+  std::string _dnsHost;
+  in_addr     _dnsAddr{};
+  bool        _dnsValid = false;
+  uint32_t    _dnsNextMs = 0;
+
+  static bool setNonBlocking(int fd) {
+    int fl = fcntl(fd, F_GETFL, 0);
+    return fl >= 0 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) >= 0;
+  }
+  static void appendU16(std::string &s, uint16_t v) {
+    s += static_cast<char>(v >> 8);
+    s += static_cast<char>(v & 0xFF);
+  }
+  static void appendStr(std::string &s, const std::string &v) {
+    appendU16(s, static_cast<uint16_t>(v.size()));
+    s += v;
+  }
+  static void appendPacket(std::string &out, uint8_t type, const std::string &body);
+  uint16_t nextPacketId() { if (++_packetId == 0) _packetId = 1; return _packetId; }
+
+  bool resolve(in_addr &out);
+  void startConnect();
+  void sendConnect();
+  void sendSubscribe(const std::vector<std::string> &filters);
+  void writePublish(const std::string &topic, const std::string &payload, bool retain);
+  void enqueue(const std::string &topic, const std::string &payload, bool retain);
+  void drainQueue();
+  bool readAvailable();                              // true = broker zavřel spojení
+  void processInput();
+  void handlePacket(uint8_t header, const char *body, size_t len);
+  void writeOut();
+  void fail(const char *why);
+  void closeSocket();
+  void setState(State s) { _state = s; _stateSince = nowMs(); }
+};
+
+// ====== Inline implementace ======
+
+inline void Client::appendPacket(std::string &out, uint8_t type, const std::string &body) {
+  out += static_cast<char>(type);
+  size_t len = body.size();
+  do {                                   // Remaining Length: 7 bitů na bajt, MSB = pokračování
+    uint8_t b = len & 0x7F;
+    len >>= 7;
+    if (len) b |= 0x80;
+    out += static_cast<char>(b);
+  } while (len);
+  out += body;
+}
+
+inline void Client::begin(const Config &cfg) {
+  stop();
+  _cfg = cfg;
+  _subs.clear();
+  _backoffMs = kReconnectMinMs;
+  if (_cfg.host.empty()) return;
+  setState(State::Backoff);
+  _nextAttempt = nowMs();
+}
+
+inline void Client::stop() {
+  if (_state == State::Connected) {
+    if (!_cfg.statusTopic.empty()) writePublish(_cfg.statusTopic, "offline", true);
+    _out.append("\xE0\x00", 2);          // DISCONNECT: broker nepošle last will
+    writeOut();
+  }
+  closeSocket();
+  setState(State::Disabled);
+}
+
+inline void Client::subscribe(const std::string &filter) {
+  for (const std::string &s : _subs) if (s == filter) return;
+  _subs.push_back(filter);
+  if (_state == State::Connected) sendSubscribe(std::vector<std::string>{ filter });
+}
+
+inline bool Client::publish(const std::string &topic, const std::string &payload, bool retain) {
+  if (_state == State::Disabled) return false;
+  if (_state == State::Connected && _queue.empty() && _out.size() - _outOff < kOutHighWater) {
+    writePublish(topic, payload, retain);
+    writeOut();
+    return true;
+  }
+  if (topic.size() + payload.size() > kQueueMaxBytes) {
+    _dropped++;
+    return false;
+  }
+  enqueue(topic, payload, retain);
+  return true;
+}
+
+inline void Client::writePublish(const std::string &topic, const std::string &payload, bool retain) {
+  std::string body;
+  body.reserve(2 + topic.size() + payload.size());
+  appendStr(body, topic);
+  body += payload;
+  appendPacket(_out, retain ? 0x31 : 0x30, body);
+  _published++;
+}
+
+inline void Client::enqueue(const std::string &topic, const std::string &payload, bool retain) {
+  if (retain) {
+    for (Pending &p : _queue) {
+      if (p.retain && p.topic == topic) {
+        _queueBytes = _queueBytes - p.payload.size() + payload.size();
+        p.payload = payload;
+        return;
+      }
+    }
+  }
+  _queue.push_back(Pending{ topic, payload, retain });
+  _queueBytes += topic.size() + payload.size();
+  while (_queue.size() > kQueueMaxMessages || _queueBytes > kQueueMaxBytes) {
+    _queueBytes -= _queue.front().topic.size() + _queue.front().payload.size();
+    _queue.pop_front();
+    _dropped++;
+  }
+}
+
+inline void Client::drainQueue() {
+  while (!_queue.empty() && _out.size() - _outOff < kOutHighWater) {
+    Pending &p = _queue.front();
+    writePublish(p.topic, p.payload, p.retain);
+    _queueBytes -= p.topic.size() + p.payload.size();
+    _queue.pop_front();
+  }
+}
+
+inline void Client::poll() {
+  const uint32_t now = nowMs();
+  switch (_state) {
+    case State::Disabled:
+      return;
+    case State::Backoff:
+      if (static_cast<int32_t>(now - _nextAttempt) >= 0) startConnect();
+      return;
+    case State::Connecting: {
+      fd_set wfds;
+      FD_ZERO(&wfds);
+      FD_SET(_fd, &wfds);
+      timeval tv = { 0, 0 };
+      if (select(_fd + 1, nullptr, &wfds, nullptr, &tv) > 0) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+          fail("connect");
+          return;
+        }
+        sendConnect();
+      } else if (now - _stateSince > kConnectTimeoutMs) {
+        fail("connect timeout");
+      }
+      return;
+    }
+    case State::AwaitConnAck:
+    case State::Connected:
+      break;
+  }
+
+  const bool eof = readAvailable();
+  if (_fd < 0) return;
+  processInput();                                    // i CONNACK s odmítnutím těsně před zavřením
+  if (_fd < 0) return;
+  if (eof) {
+    fail("closed by broker");
+    return;
+  }
+
+  if (_state == State::AwaitConnAck) {
+    if (now - _stateSince > kConnectTimeoutMs) fail("connack timeout");
+  } else {
+    const uint32_t keepAliveMs = static_cast<uint32_t>(_cfg.keepAliveS) * 1000;
+    if (keepAliveMs) {
+      if (_pingOutstanding && now - _pingSentAt > keepAliveMs) {
+        fail("ping timeout");
+        return;
+      }
+      if (!_pingOutstanding && now - _lastTx >= keepAliveMs / 2) {
+        _out.append("\xC0\x00", 2);      // PINGREQ
+        _pingOutstanding = true;
+        _pingSentAt = now;
+      }
+    }
+    drainQueue();
+  }
+  writeOut();
+}
+
+inline void Client::startConnect() {
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(_cfg.port);
+  if (inet_pton(AF_INET, _cfg.host.c_str(), &addr.sin_addr) != 1 && !resolve(addr.sin_addr)) {
+    fail("dns");
+    return;
+  }
+
+  _fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (_fd < 0 || !setNonBlocking(_fd)) {
+    fail("socket");
+    return;
+  }
+  int one = 1;
+  setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  setState(State::Connecting);
+  if (connect(_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0) {
+    sendConnect();
+  } else if (errno != EINPROGRESS) {
+    fail("connect");
+  }
+}
+
+inline bool Client::resolve(in_addr &out) {
+  const uint32_t now = nowMs();
+  if (_dnsHost != _cfg.host) {
+    _dnsHost = _cfg.host;
+    _dnsValid = false;
+  } else if (static_cast<int32_t>(now - _dnsNextMs) < 0) {
+    if (_dnsValid) out = _dnsAddr;
+    return _dnsValid;
+  }
+  _dnsNextMs = now + kDnsRefreshMs;
+  _dnsLookups++;
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *res = nullptr;
+  if (getaddrinfo(_cfg.host.c_str(), nullptr, &hints, &res) == 0 && res) {
+    _dnsAddr = reinterpret_cast<sockaddr_in *>(res->ai_addr)->sin_addr;
+    _dnsValid = true;
+    freeaddrinfo(res);
+  }
+  // neúspěšný dotaz nechá starou adresu – broker mohl zůstat na stejné IP
+  if (_dnsValid) out = _dnsAddr;
+  return _dnsValid;
+}
+
+inline void Client::sendConnect() {
+  const bool will = !_cfg.statusTopic.empty();
+  uint8_t flags = 0x02;                              // clean session
+  if (will) flags |= 0x04 | 0x20;                    // will, QoS 0, retain
+  if (!_cfg.user.empty()) flags |= 0x80 | (_cfg.pass.empty() ? 0 : 0x40);
+
+  std::string body;
+  appendStr(body, "MQTT");
+  body += static_cast<char>(4);                      // protocol level 3.1.1
+  body += static_cast<char>(flags);
+  appendU16(body, _cfg.keepAliveS);
+  appendStr(body, _cfg.clientId);
+  if (will) {
+    appendStr(body, _cfg.statusTopic);
+    appendStr(body, "offline");
+  }
+  if (!_cfg.user.empty()) {
+    appendStr(body, _cfg.user);
+    if (!_cfg.pass.empty()) appendStr(body, _cfg.pass);
+  }
+  appendPacket(_out, 0x10, body);
+  setState(State::AwaitConnAck);
+  writeOut();
+}
+
+inline void Client::sendSubscribe(const std::vector<std::string> &filters) {
+  if (filters.empty()) return;
+  std::string body;
+  appendU16(body, nextPacketId());
+  for (const std::string &f : filters) {
+    appendStr(body, f);
+    body += static_cast<char>(0);                    // požadovaná QoS 0
+  }
+  appendPacket(_out, 0x82, body);
+}
+
+inline bool Client::readAvailable() {
+  char buf[512];
+  for (;;) {
+    ssize_t n = recv(_fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      _in.append(buf, static_cast<size_t>(n));
+      if (_in.size() > kMaxPacketBytes + 8) {
+        fail("packet too large");
+        return false;
+      }
+    } else if (n == 0) {
+      return true;
+    } else {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) fail("recv");
+      return false;
+    }
+  }
+}
+
+inline void Client::processInput() {
+  while (_fd >= 0 && _in.size() >= 2) {
+    size_t len = 0, pos = 1;
+    uint32_t mult = 1;
+    for (;;) {
+      if (pos >= _in.size()) return;                 // neúplná délka
+      const uint8_t b = static_cast<uint8_t>(_in[pos++]);
+      len += (b & 0x7F) * mult;
+      if (!(b & 0x80)) break;
+      mult <<= 7;
+      if (pos > 4) {
+        fail("bad length");
+        return;
+      }
+    }
+    if (len > kMaxPacketBytes) {
+      fail("packet too large");
+      return;
+    }
+    if (_in.size() < pos + len) return;
+    const uint8_t header = static_cast<uint8_t>(_in[0]);
+    const std::string body = _in.substr(pos, len);
+    _in.erase(0, pos + len);
+    handlePacket(header, body.data(), body.size());
+  }
+}
+
+inline void Client::handlePacket(uint8_t header, const char *body, size_t len) {
+  switch (header >> 4) {
+    case 2:                                          // CONNACK
+      if (_state != State::AwaitConnAck || len < 2 || body[1] != 0) {
+        fail(len >= 2 && body[1] == 5 ? "not authorized" : "connack refused");
+        return;
+      }
+      setState(State::Connected);
+      _connects++;
+      _backoffMs = kReconnectMinMs;
+      _pingOutstanding = false;
+      _lastError = "";
+      sendSubscribe(_subs);
+      if (!_cfg.statusTopic.empty()) writePublish(_cfg.statusTopic, "online", true);
+      drainQueue();
+      return;
+    case 3: {                                        // PUBLISH
+      if (len < 2) return;
+      const size_t tlen = (static_cast<uint8_t>(body[0]) << 8) | static_cast<uint8_t>(body[1]);
+      const uint8_t qos = (header >> 1) & 0x03;
+      size_t p = 2 + tlen;
+      if (p > len) return;
+      if (qos) {
+        if (p + 2 > len) return;
+        if (qos == 1) {                              // PUBACK (odebíráme s QoS 0, ale broker může poslat víc)
+          _out += '\x40';
+          _out += '\x02';
+          _out.append(body + p, 2);
+        }
+        p += 2;
+      }
+      _received++;
+      if (_handler) _handler(std::string(body + 2, tlen), std::string(body + p, len - p));
+      return;
+    }
+    case 13:                                         // PINGRESP
+      _pingOutstanding = false;
+      return;
+    default:                                         // SUBACK a ostatní se ignorují
+      return;
+  }
+}
+
+inline void Client::writeOut() {
+  while (_fd >= 0 && _outOff < _out.size()) {
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+    ssize_t n = send(_fd, _out.data() + _outOff, _out.size() - _outOff, flags);
+    if (n > 0) {
+      _outOff += static_cast<size_t>(n);
+      _lastTx = nowMs();
+    } else {
+      if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) fail("send");
+      break;
+    }
+  }
+  if (_outOff == _out.size()) {
+    _out.clear();
+    _outOff = 0;
+  } else if (_outOff > kOutHighWater) {
+    _out.erase(0, _outOff);
+    _outOff = 0;
+  }
+}
+
+inline void Client::fail(const char *why) {
+  closeSocket();
+  _lastError = why;
+  _failures++;
+  setState(State::Backoff);
+  _nextAttempt = nowMs() + _backoffMs;
+  _backoffMs = (_backoffMs >= kReconnectMaxMs / 2) ? kReconnectMaxMs : _backoffMs * 2;
+}
+
+inline void Client::closeSocket() {
+  if (_fd >= 0) {
+    close(_fd);
+    _fd = -1;
+  }
+  _in.clear();
+  _out.clear();
+  _outOff = 0;
+  _pingOutstanding = false;
+}
+
+}  // namespace mqtt
@@ -0,0 +1,94 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// ====== Přehled ======
+// LRU cache odesílacích bufferů (RAW pulzy připravené pro IrSender.sendRaw) podle learned indexu.
+// - Paměť je omezená počtem položek i součtem bajtů pulzů; při překročení se vyhazuje nejdéle nepoužitá.
+// - Ukládá i „negativní“ výsledek (kód nemá RAW), aby se opakovaně neprocházel flash / JSONL.
+// - Bez zámků: používá se jen z loop() (HTTP handlery, dávky), ne z přijímacího tasku.
+// - Položky leží ve std::vector a mazání přesouvá poslední na uvolněné místo: ukazatel z get()/put()
+//   platí jen do dalšího put(), invalidate() nebo clear() – jen na jedno odeslání, neukládat.
+
+class PulseBufferCache {
+public:
+  static constexpr size_t kMaxEntries = 20;
+  static constexpr size_t kMaxBytes   = 16384;
+
+  struct Entry {
+    int32_t               key;
+    uint8_t               khz;
+    uint32_t              lastUse;
+    std::vector<uint16_t> pulses;   // prázdné = kód nemá RAW
+  };
+
+  // Vrací položku (a posune ji na začátek LRU), nebo nullptr při miss.
+  const Entry *get(int32_t key) {
+    for (Entry &e : _entries) {
+      if (e.key != key) continue;
+      e.lastUse = ++_tick;
+      _hits++;
+      return &e;
+    }
+    _misses++;
+    return nullptr;
+  }
+
+  // Vloží/nahradí položku. Buffer větší než celý rozpočet se necachuje (vrací nullptr).
+  // Vrácený ukazatel zneplatní další put()/invalidate()/clear() (viz přehled).
+  const Entry *put(int32_t key, uint8_t khz, const uint16_t *pulses, size_t count) {
+    invalidate(key);
+    const size_t bytes = count * sizeof(uint16_t);
+    if (bytes > kMaxBytes) return nullptr;
+    while (!_entries.empty() && (_entries.size() >= kMaxEntries || _bytes + bytes > kMaxBytes)) {
+      evictOldest();
+    }
+    _entries.push_back(Entry{ key, khz, ++_tick, std::vector<uint16_t>(pulses, pulses + count) });
+    _bytes += bytes;
+    return &_entries.back();
+  }
+
+  void invalidate(int32_t key) {
+    for (size_t i = 0; i < _entries.size(); ++i) {
+      if (_entries[i].key == key) {
+        eraseAt(i);
+        return;
+      }
+    }
+  }
+
+  void clear() {
+    _entries.clear();
+    _bytes = 0;
+  }
+
+  uint32_t hits() const      { return _hits; }
+  uint32_t misses() const    { return _misses; }
+  uint32_t evictions() const { return _evictions; }
+  size_t   entries() const   { return _entries.size(); }
+  size_t   bytes() const     { return _bytes; }
+
+private:
+  std::vector<Entry> _entries;
+  size_t   _bytes = 0;
+  uint32_t _tick = 0;
+  uint32_t _hits = 0;
+  uint32_t _misses = 0;
+  uint32_t _evictions = 0;
+
+  void evictOldest() {
+    size_t oldest = 0;
+    for (size_t i = 1; i < _entries.size(); ++i) {
+      if (_entries[i].lastUse < _entries[oldest].lastUse) oldest = i;
+    }
+    eraseAt(oldest);
+    _evictions++;
+  }
+
+  void eraseAt(size_t i) {
+    _bytes -= _entries[i].pulses.size() * sizeof(uint16_t);
+    _entries[i] = std::move(_entries.back());
+    _entries.pop_back();
+  }
+};
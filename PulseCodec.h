@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#if defined(ESP32)
+#include <esp_attr.h>
+#endif
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// ====== Přehled ======
+// Kódování délek pulzů v ISR bufferu snifferu (1 B na běžný pulz místo uint16_t).
+// Kód pulzu (kvazi-logaritmická škála, chyba kvantizace max. ±3,1 %):
+//   0–31    … přímo µs,
+//   32–254  … 4bit mantisa m (16–31) s exponentem e: µs = m << e, kód = 32 + (e-1)*16 + (m-16),
+//   0xFF    … escape, za ním 2 B přesné délky (big-endian, saturace 0xFFFF).
+// Escape se používá od RAW_CODE_ESCAPE_US – jen dlouhé mezery / rušení, běžné pulzy mají 1 B.
+// Zápis běží v přerušení (IRAM_ATTR), čtení v přijímacím tasku. Bez Arduino typů (host testy).
+
+static const uint8_t  RAW_CODE_ESCAPE = 0xFF;
+static const uint32_t RAW_CODE_ESCAPE_US = 16384;
+
+// µs → 1B kód, zaokrouhlení na nejbližší hodnotu. Bez __builtin_clz – ESP32-C3 nemá instrukci
+// a volání libgcc by z IRAM skočilo do flash.
+static inline uint8_t IRAM_ATTR isrEncodePulse(uint32_t us) {
+  if (us < 32) return static_cast<uint8_t>(us);
+  uint8_t e = 0;
+  for (uint32_t v = us; v >= 32; v >>= 1) e++;
+  uint32_t m = (us + (1UL << (e - 1))) >> e;
+  if (m == 32) { m = 16; e++; }
+  return static_cast<uint8_t>(32 + (e - 1) * 16 + (m - 16));
+}
+
+static inline uint16_t decodePulseCode(uint8_t code) {
+  if (code < 32) return code;
+  const uint8_t e = static_cast<uint8_t>((code - 32) / 16 + 1);
+  const uint32_t us = static_cast<uint32_t>(16 + (code - 32) % 16) << e;
+  return static_cast<uint16_t>(us > 0xFFFF ? 0xFFFF : us);
+}
+
+// Počet bajtů, které pulz zabere v bufferu.
+static inline uint8_t IRAM_ATTR pulseCodeBytes(uint32_t us) {
+  return us >= RAW_CODE_ESCAPE_US ? 3 : 1;
+}
+
+// Zapíše pulz od pozice pos a posune ji; místo (pulseCodeBytes) kontroluje volající.
+static inline void IRAM_ATTR pulseCodeWrite(volatile uint8_t *buf, uint16_t &pos, uint32_t us) {
+  if (us < RAW_CODE_ESCAPE_US) {
+    buf[pos++] = isrEncodePulse(us);
+    return;
+  }
+  const uint16_t sat = static_cast<uint16_t>(us > 0xFFFF ? 0xFFFF : us);   // saturace na 16-bit
+  buf[pos++] = RAW_CODE_ESCAPE;
+  buf[pos++] = static_cast<uint8_t>(sat >> 8);
+  buf[pos++] = static_cast<uint8_t>(sat);
+}
+
+// Přečte jeden pulz od pozice pos a posune ji.
+static inline uint16_t pulseCodeRead(const volatile uint8_t *buf, uint16_t &pos) {
+  const uint8_t code = buf[pos++];
+  if (code != RAW_CODE_ESCAPE) return decodePulseCode(code);
+  const uint16_t us = static_cast<uint16_t>((buf[pos] << 8) | buf[pos + 1]);
+  pos += 2;
+  return us;
+}
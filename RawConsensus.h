@@ -0,0 +1,178 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+// ====== Přehled ======
+// Učení z více stisků: z N zachycení stejného tlačítka spočítá jeden „čistý“ RAW kód.
+// - zachycení se seskupí podle počtu pulzů, použije se nejčetnější délka (kratší = repeat/šum),
+// - odlehlá zachycení (přehozený bit, rušení) se vyřadí podle odchylky od mediánu po pozicích,
+// - z přijatých se po pozicích vezme medián a hodnoty se zvlášť pro marky a mezery shluknou
+//   a přichytí na medián shluku (560/1690 µs místo 548, 571, 1702 …),
+// - kvalita 0–100 = podíl přijatých zachycení × zbytkový jitter vůči výslednému kódu.
+// Poslední mezera (mezera za rámcem) se jen mediánuje – neshlukuje se a nezapočítává do jitteru.
+// Bez Arduino typů; používá se jen z loop() (sniffer větev pipeline + HTTP handlery).
+
+class RawConsensus {
+public:
+  static constexpr size_t  kMaxCaptures   = 8;
+  static constexpr size_t  kMinPulses     = 8;     // kratší rámce (repeat kódy, šum) se ignorují
+  static constexpr uint8_t kMaxDevPercent = 40;    // jedna pozice dál od mediánu = jiný kód
+  static constexpr uint8_t kAvgDevPercent = 12;    // průměrná odchylka zachycení nad = rušení
+  static constexpr uint8_t kClusterPercent = 25;   // šířka shluku vůči jeho nejmenší hodnotě
+  static constexpr uint16_t kClusterMinUs = 80;
+
+  struct Result {
+    bool                  ok = false;
+    const char           *err = nullptr;
+    std::vector<uint16_t> raw;
+    uint8_t               quality = 0;        // 0–100
+    uint8_t               used = 0;           // zachycení ve výsledku
+    uint8_t               rejected = 0;       // jiná délka + odlehlá
+    uint16_t              jitterPermille = 0; // průměrná relativní odchylka přijatých vůči výsledku
+    uint16_t              clusters = 0;
+  };
+
+  void reset(uint8_t target) {
+    _captures.clear();
+    _target = std::max<uint8_t>(2, std::min<uint8_t>(target, kMaxCaptures));
+    _ignored = 0;
+  }
+
+  // false = zachycení se nepřidalo (příliš krátké nebo už je jich dost).
+  bool add(const uint16_t *raw, size_t count) {
+    if (!raw || count < kMinPulses) {
+      _ignored++;
+      return false;
+    }
+    if (complete()) return false;
+    _captures.emplace_back(raw, raw + count);
+    return true;
+  }
+
+  uint8_t  target() const   { return _target; }
+  size_t   captured() const { return _captures.size(); }
+  uint32_t ignored() const  { return _ignored; }
+  bool     complete() const { return _captures.size() >= _target; }
+
+  Result compute() const {
+    Result r;
+    const size_t total = _captures.size();
+    if (total < 2) {
+      r.err = "need at least 2 captures";
+      return r;
+    }
+
+    // 1) nejčetnější délka (při shodě delší – zkrácený rámec je častější chyba než prodloužený)
+    size_t bestLen = 0, bestCount = 0;
+    for (const auto &c : _captures) {
+      size_t n = 0;
+      for (const auto &o : _captures) n += (o.size() == c.size());
+      if (n > bestCount || (n == bestCount && c.size() > bestLen)) {
+        bestLen = c.size();
+        bestCount = n;
+      }
+    }
+    std::vector<const std::vector<uint16_t> *> group;
+    for (const auto &c : _captures) {
+      if (c.size() == bestLen) group.push_back(&c);
+    }
+
+    // 2) vyřazení odlehlých vůči mediánu skupiny, pak medián z přijatých
+    std::vector<uint16_t> med = positionMedian(group, bestLen);
+    std::vector<const std::vector<uint16_t> *> accepted;
+    for (const auto *c : group) {
+      if (withinTolerance(*c, med)) accepted.push_back(c);
+    }
+    if (accepted.size() < 2) {
+      r.err = "captures disagree";
+      r.rejected = static_cast<uint8_t>(total - accepted.size());
+      return r;
+    }
+    if (accepted.size() != group.size()) med = positionMedian(accepted, bestLen);
+
+    // 3) shluky zvlášť pro marky (sudé pozice) a mezery (liché), bez koncové mezery
+    const size_t body = bestLen - 1;
+    r.raw = med;
+    for (size_t parity = 0; parity < 2; ++parity) {
+      std::vector<size_t> pos;
+      for (size_t i = parity; i < body; i += 2) pos.push_back(i);
+      std::sort(pos.begin(), pos.end(), [&](size_t a, size_t b) { return med[a] < med[b]; });
+
+      size_t start = 0;
+      while (start < pos.size()) {
+        const uint32_t lo = med[pos[start]];
+        const uint32_t width = std::max<uint32_t>(lo * kClusterPercent / 100, kClusterMinUs);
+        size_t end = start + 1;
+        while (end < pos.size() && med[pos[end]] <= lo + width) ++end;
+
+        // zástupce shluku = medián všech vzorků ze všech přijatých zachycení
+        std::vector<uint16_t> samples;
+        samples.reserve((end - start) * accepted.size());
+        for (size_t k = start; k < end; ++k) {
+          for (const auto *c : accepted) samples.push_back((*c)[pos[k]]);
+        }
+        const uint16_t snap = median(samples);
+        for (size_t k = start; k < end; ++k) r.raw[pos[k]] = snap;
+        r.clusters++;
+        start = end;
+      }
+    }
+
+    // 4) kvalita
+    uint64_t devSum = 0, devCount = 0;
+    for (const auto *c : accepted) {
+      for (size_t i = 0; i < body; ++i) {
+        const uint32_t ref = std::max<uint16_t>(r.raw[i], 1);
+        const uint32_t d = (*c)[i] > r.raw[i] ? (*c)[i] - r.raw[i] : r.raw[i] - (*c)[i];
+        devSum += static_cast<uint64_t>(d) * 1000 / ref;
+        devCount++;
+      }
+    }
+    r.jitterPermille = static_cast<uint16_t>(devCount ? devSum / devCount : 0);
+    r.used = static_cast<uint8_t>(accepted.size());
+    r.rejected = static_cast<uint8_t>(total - accepted.size());
+    // 30 % průměrné odchylky = nulová kvalita; typický ovladač má 2–5 %
+    const uint32_t jitterScore = r.jitterPermille >= 300 ? 0 : 300 - r.jitterPermille;
+    r.quality = static_cast<uint8_t>(jitterScore * 100 * accepted.size() / (300 * total));
+    r.ok = true;
+    return r;
+  }
+
+private:
+  std::vector<std::vector<uint16_t>> _captures;
+  uint8_t  _target = 5;
+  uint32_t _ignored = 0;
+
+  static uint16_t median(std::vector<uint16_t> &v) {
+    const size_t mid = v.size() / 2;
+    std::nth_element(v.begin(), v.begin() + mid, v.end());
+    if (v.size() & 1) return v[mid];
+    const uint16_t hi = v[mid];
+    const uint16_t lo = *std::max_element(v.begin(), v.begin() + mid);
+    return static_cast<uint16_t>((static_cast<uint32_t>(lo) + hi + 1) / 2);
+  }
+
+  static std::vector<uint16_t> positionMedian(const std::vector<const std::vector<uint16_t> *> &caps,
+                                              size_t len) {
+    std::vector<uint16_t> out(len), col(caps.size());
+    for (size_t i = 0; i < len; ++i) {
+      for (size_t k = 0; k < caps.size(); ++k) col[k] = (*caps[k])[i];
+      out[i] = median(col);
+    }
+    return out;
+  }
+
+  static bool withinTolerance(const std::vector<uint16_t> &c, const std::vector<uint16_t> &med) {
+    const size_t body = med.size() - 1;
+    uint64_t devSum = 0;
+    for (size_t i = 0; i < body; ++i) {
+      const uint32_t ref = std::max<uint32_t>(med[i], kClusterMinUs);
+      const uint32_t d = c[i] > med[i] ? c[i] - med[i] : med[i] - c[i];
+      if (d * 100 > ref * kMaxDevPercent) return false;
+      devSum += static_cast<uint64_t>(d) * 100 / ref;
+    }
+    return devSum <= static_cast<uint64_t>(kAvgDevPercent) * body;
+  }
+};
@@ -12,25 +12,33 @@
 // - extern int8_t g_irTxPin;
 // - extern const size_t HISTORY_LEN;
 // - extern volatile size_t histWrite, histCount;
-// - struct IREvent { uint32_t ms,value,address,command; uint8_t bits,flags; decode_type_t proto; int learnedIndex; };
+// - struct IREvent { uint32_t ms,value,address,command; uint8_t bits,flags; decode_type_t proto; int32_t learnedId; };
 // - extern IREvent history[];
 // - extern bool hasLastUnknown; extern IREvent lastUnknown;
 // - extern String jsonEscape(const String&);
 // - extern const __FlashStringHelper* protoName(decode_type_t);
 // - extern bool isEffectivelyUnknown(const IREvent& e);
 extern ToshibaACIR toshiba;
-// - struct LearnedCode { uint32_t value, addr; uint8_t bits, flags; String proto,vendor,function,remote; };
-// - extern const LearnedCode* getLearnedByIndex(int idx);
+// - struct LearnedCode { uint32_t id, value, addr, flags; uint8_t bits; String proto,vendor,function,remote; decode_type_t protoType; ... };
+// - extern bool getLearnedById(uint32_t id, LearnedCode &out); extern uint32_t learnedIdForOrdinal(uint32_t ordinal);
+// - LearnedCatalog<LearnedCode> g_learnedCatalog (scan / getByOrdinal / ordinalForId pro stránkovaný výpis);
 // - extern bool fsAppendLearned(uint32_t value, uint8_t bits, uint32_t addr, uint32_t flags,
 //                               const String& proto, const String& vendor, const String& function,
-//                               const String& remote, const std::vector<uint16_t>* rawOpt, uint8_t rawKhz);
-// - extern String fsReadLearnedAsArrayJSON();
-// - extern bool fsUpdateLearned(size_t index, const String& proto, const String& vendor, const String& function, const String& remote);
+//                               const String& remote, const std::vector<uint16_t>* rawOpt, uint8_t rawKhz, int quality);
+// - extern bool fsUpdateLearned(uint32_t id, const String& proto, const String& vendor, const String& function, const String& remote);
 // - extern bool irSendLearned(const LearnedCode &e, uint8_t repeats);
-// - extern bool fsDeleteLearned(size_t index);
+// - extern bool fsDeleteLearned(uint32_t id);
+// - class LearnedExportStream (pull read(buf, max)); extern bool fsImportLearned(path, replace, count, err);
 // - extern bool irSendEvent(const IREvent &ev, uint8_t repeats);
 // - extern decode_type_t parseProtoLabel(const String&);
 // - extern void initIrSender(int8_t txPin);
+// - volatile uint16_t g_isrMinPulseUs; RAW_GLITCH_US_MAX (potlačení glitchů v ISR snifferu)
+// - extern void noteToshibaState(const ToshibaACIR::State &s); extern void mqttBegin();
+// - extern String sendBatchResultJson(results); extern String sendBatchErrorJson(err, errIndex);
+// - template <W> void writeDiagnostics(W &w) (JsonStringWriter / CborWriter); const char *protoLabel(decode_type_t);
+// - extern void learnMultiStart(uint8_t); extern void learnMultiCancel(); extern bool learnMultiActive();
+//   extern RawConsensus::Result learnMultiResult(); extern String learnMultiStatusJson();
+// - extern bool learnedExportActive();
 
 inline void handleRoot() {
   String html;
@@ -76,12 +84,20 @@ inline void handleRoot() {
     "<div class='row'>"
       "<label><input id='onlyUnk' type='checkbox'> Jen <b>UNKNOWN</b></label>"
       "<span style='margin-left:12px'>TX pin: <input id='txPin' type='number' min='0' max='19'></span>"
+      "<span style='margin-left:12px' title='Kratší pulzy přijímač bere jako rušení (0 = vypnuto)'>Min. puls (µs): <input id='minPulse' type='number' min='0' max='400'></span>"
       "<button id='saveBtn' class='btn'>Uložit</button>"
       "<a class='btn' href='/learn'>Učit kód</a>"
       "<a class='btn' href='/learned'>Naučené kódy</a>"
       "<a class='btn' href='/api/history'>API /history</a>"
       "<a class='btn' href='/api/learned'>API /learned</a>"
     "</div>"
+    "<div class='row'>"
+      "<span>MQTT broker: <input id='mqttHost' type='text' placeholder='host[:port] (prázdné = vypnuto)'></span>"
+      "<span style='margin-left:12px'>Prefix: <input id='mqttPrefix' type='text' placeholder='irbridge'></span>"
+      "<span style='margin-left:12px'>Uživatel: <input id='mqttUser' type='text'></span>"
+      "<span style='margin-left:12px'>Heslo: <input id='mqttPass' type='password' placeholder='beze změny'></span>"
+      "<span style='margin-left:12px' id='mqttState' class='muted'>–</span>"
+    "</div>"
   );
 
   html += F(
@@ -180,6 +196,9 @@ inline void handleRoot() {
         "<label>Výrobce:</label><input type='text' name='vendor' placeholder='např. Toshiba' required>"
         "<label>Funkce:</label><input type='text' name='function' placeholder='např. Power, TempUp' required>"
         "<label>Ovladač (volit.):</label><input type='text' name='remote_label' placeholder='např. Klima Obývák'>"
+        "<div class='row'><button type='button' class='btn' id='multiBtn'>Učit z více stisků</button>"
+          "<input type='number' id='multiN' min='2' max='8' value='5' title='Počet stisků'>"
+          "<span class='muted' id='multiState'></span></div>"
         "<div style='margin-top:10px;display:flex;gap:8px;justify-content:flex-end'>"
           "<button type='button' class='btn' id='cancelBtn'>Zrušit</button>"
           "<button type='submit' class='btn' id='saveLearn'>Uložit</button>"
@@ -193,6 +212,10 @@ inline void handleRoot() {
     "const toast=document.getElementById('toast');"
     "const onlyUnk=document.getElementById('onlyUnk');"
     "const txPin=document.getElementById('txPin');"
+    "const minPulse=document.getElementById('minPulse');"
+    "const mqttHost=document.getElementById('mqttHost');const mqttPrefix=document.getElementById('mqttPrefix');"
+    "const mqttUser=document.getElementById('mqttUser');const mqttPass=document.getElementById('mqttPass');"
+    "const mqttState=document.getElementById('mqttState');let mqttLoaded=false;"
     "const saveBtn=document.getElementById('saveBtn');"
     "const modal=document.getElementById('learnModal');"
     "const form=document.getElementById('learnForm');"
@@ -221,9 +244,17 @@ inline void handleRoot() {
     "function showToast(msg,ok=true){toast.textContent=msg;toast.className=ok?'ok':'err';toast.style.display='block';setTimeout(()=>toast.style.display='none',2000)}"
     "function toHex(n){return '0x'+(Number(n)>>>0).toString(16).toUpperCase()}"
     "function fmtAge(ms){if(!ms||ms<0)return '–';if(ms<1000)return ms+' ms';if(ms<60000)return (ms/1000).toFixed(1)+' s';return (ms/60000).toFixed(1)+' min'}"
-    "function openLearn(v,b,a,f,p){form.value.value=v;form.bits.value=b;form.addr.value=a;form.flags.value=f;form.proto.value=p;modal.style.display='flex'}"
-    "cancelBtn.onclick=()=>{modal.style.display='none'};"
-    "modal.addEventListener('click',e=>{if(e.target===modal)modal.style.display='none'});"
+    "const multiBtn=document.getElementById('multiBtn');const multiN=document.getElementById('multiN');const multiState=document.getElementById('multiState');"
+    "let multiOn=false,multiTimer=null;"
+    "function openLearn(v,b,a,f,p){form.value.value=v;form.bits.value=b;form.addr.value=a;form.flags.value=f;form.proto.value=p;multiState.textContent='';modal.style.display='flex'}"
+    "function closeLearn(){modal.style.display='none';if(multiOn){multiOn=false;clearTimeout(multiTimer);fetch('/api/learn_multi/cancel',{method:'POST'}).catch(()=>{});}}"
+    "async function pollMulti(){if(!multiOn)return;try{const r=await fetch('/api/learn_multi/status');const j=await r.json();"
+      "if(!j.active){multiOn=false;multiState.textContent='Učení vypršelo.';return;}"
+      "let t='Stiskněte tlačítko: '+j.captured+'/'+j.target;if(j.ok)t+=' · kvalita '+j.quality+' %';else if(j.err)t+=' · '+j.err;"
+      "multiState.textContent=t;}catch(err){}multiTimer=setTimeout(pollMulti,500);}"
+    "multiBtn.onclick=async()=>{try{const b=new URLSearchParams();b.set('n',multiN.value||'5');await fetch('/api/learn_multi/start',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:b});multiOn=true;pollMulti();}catch(err){showToast('Chyba připojení',false)}};"
+    "cancelBtn.onclick=closeLearn;"
+    "modal.addEventListener('click',e=>{if(e.target===modal)closeLearn()});"
     "rawSendBtn.onclick=async()=>{rawSendBtn.disabled=true;let rep=parseInt(rawRepeat.value||'0',10);if(isNaN(rep))rep=0;rep=Math.max(0,Math.min(3,rep));try{const r=await fetch('/api/raw_send?repeat='+rep);const j=await r.json();if(j.ok){showToast('RAW odeslán.');}else{showToast(j.err||'Odeslání RAW selhalo',false);}}catch(err){showToast('Chyba odeslání RAW',false);}rawSendBtn.disabled=false;loadDiag();};"
 
     "const syncToshibaTemp=()=>{if(toshTemp&&toshTempVal)toshTempVal.textContent=toshTemp.value+' °C';};"
@@ -235,9 +266,9 @@ inline void handleRoot() {
       "document.getElementById('saveLearn').disabled=true;"
       "const fd=new FormData(form);"
       "const body=new URLSearchParams(fd);"
-      "try{const r=await fetch('/api/learn_save',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body});"
+      "try{const r=await fetch(multiOn?'/api/learn_multi/save':'/api/learn_save',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body});"
            "const j=await r.json();"
-           "if(j.ok){showToast('Uloženo.');modal.style.display='none';loadHistory(); loadDiag();}"
+           "if(j.ok){showToast(j.quality!==undefined?'Uloženo (kvalita '+j.quality+' %).':'Uloženo.');multiOn=false;clearTimeout(multiTimer);modal.style.display='none';loadHistory(); loadDiag();}"
            "else{showToast(j.err||'Uložení selhalo',false)}"
       "}catch(err){showToast('Chyba připojení',false)}"
       "document.getElementById('saveLearn').disabled=false;"
@@ -259,7 +290,7 @@ inline void handleRoot() {
             "td(toHex(e.addr)); td(toHex(e.cmd)); td(toHex(e.value)); td(e.flags);"
             "const act=document.createElement('td');"
             "const sendBtn=document.createElement('button');sendBtn.className='btn';sendBtn.textContent='Odeslat';"
-            "sendBtn.onclick=async()=>{sendBtn.disabled=true;try{const r=await fetch('/api/history_send?ms='+e.ms);const j=await r.json();if(j.ok){showToast('Odesláno.');}else{showToast(j.err||'Odeslání selhalo',false);}}catch(err){showToast('Chyba odeslání',false);}sendBtn.disabled=false;loadDiag();};"
+            "sendBtn.onclick=async()=>{sendBtn.disabled=true;try{const r=await fetch('/api/history_send?seq='+e.seq);const j=await r.json();if(j.ok){showToast('Odesláno.');}else{showToast(j.err||'Odeslání selhalo',false);}}catch(err){showToast('Chyba odeslání',false);}sendBtn.disabled=false;loadDiag();};"
             "act.appendChild(sendBtn);"
             "if(e.proto.includes('UNKNOWN')||(!e.learned&&e.learned_proto==='')){"
               "const b=document.createElement('button');b.className='btn';b.textContent='Učit';b.style.marginLeft='6px';"
@@ -279,6 +310,12 @@ inline void handleRoot() {
     "async function loadDiag(){"
       "try{const r=await fetch('/api/diag');const j=await r.json();"
           "const rawHas=j.raw.valid; const rawDecode=j.raw.decode_valid;"
+          "if(j.sniffer&&minPulse.value===''&&document.activeElement!==minPulse)minPulse.value=j.sniffer.min_pulse_us;"
+          "if(j.mqtt){"
+            "if(!mqttLoaded){mqttHost.value=j.mqtt.host||'';mqttPrefix.value=j.mqtt.prefix||'';mqttUser.value=j.mqtt.user||'';mqttLoaded=true;}"
+            "mqttState.textContent=!j.mqtt.enabled?'vypnuto':(j.mqtt.connected?'připojeno':('odpojeno'+(j.mqtt.last_error?' ('+j.mqtt.last_error+')':'')));"
+            "mqttState.className=j.mqtt.connected?'status-ok':(j.mqtt.enabled?'status-err':'muted');"
+          "}"
           "if(rawHas){"
             "rawState.textContent='Zachyceno';"
             "rawState.className='status-ok';"
@@ -323,6 +360,8 @@ inline void handleRoot() {
       "try{const p=new URLSearchParams();"
           "p.set('only_unk',onlyUnk.checked?'1':'0');"
           "if(txPin.value!=='') p.set('tx_pin',txPin.value);"
+          "if(minPulse.value!=='') p.set('glitch_us',minPulse.value);"
+          "if(mqttLoaded){p.set('mqtt_host',mqttHost.value.trim());p.set('mqtt_prefix',mqttPrefix.value.trim());p.set('mqtt_user',mqttUser.value);if(mqttPass.value!=='')p.set('mqtt_pass',mqttPass.value);}"
           "const r=await fetch('/settings',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:p});"
           "if(r.status===302||r.ok){showToast('Nastavení uloženo'); loadHistory(); loadDiag();}"
           "else showToast('Uložení nastavení selhalo',false);"
@@ -358,26 +397,146 @@ inline void handleSettingsPost() {
     }
   }
 
+  if (server.hasArg("glitch_us") && server.arg("glitch_us").length() > 0) {
+    long us = strtol(server.arg("glitch_us").c_str(), nullptr, 10);
+    if (us >= 0 && us <= RAW_GLITCH_US_MAX) {
+      g_isrMinPulseUs = static_cast<uint16_t>(us);   // ISR si novou mez vezme u další hrany
+      prefs.putUShort("glitch_us", static_cast<uint16_t>(us));
+    }
+  }
+
+  // MQTT: klient se restartuje jen při změně (prázdný host = vypnuto)
+  bool mqttChanged = false;
+  auto storeMqtt = [&](const char *arg, const char *key, bool trim) {
+    if (!server.hasArg(arg)) return;
+    String v = server.arg(arg);
+    if (trim) v.trim();
+    if (v == prefs.getString(key, "")) return;
+    prefs.putString(key, v);
+    mqttChanged = true;
+  };
+  if (server.hasArg("mqtt_prefix")) {
+    String pfx = server.arg("mqtt_prefix");
+    pfx.trim();
+    while (pfx.endsWith("/")) pfx.remove(pfx.length() - 1);
+    if (pfx.indexOf('+') < 0 && pfx.indexOf('#') < 0 && pfx != prefs.getString("mqtt_prefix", "")) {
+      prefs.putString("mqtt_prefix", pfx);
+      mqttChanged = true;
+    }
+  }
+  storeMqtt("mqtt_host", "mqtt_host", true);
+  storeMqtt("mqtt_user", "mqtt_user", true);
+  storeMqtt("mqtt_pass", "mqtt_pass", false);
+  if (mqttChanged) mqttBegin();
+
   // Pro kompatibilitu se stávajícím kódem necháme 302 (AJAX to zvládne)
   server.sendHeader("Location", "/");
   server.send(302);
 }
 
+// === Strojová API: JSON, nebo CBOR při ?fmt=cbor / Accept: application/cbor ===
+// CBOR výpisy posílají názvy polí jednou ("fields") a záznamy jako pole hodnot ve stejném pořadí.
+inline bool clientWantsCbor() {
+  const String fmt = server.arg("fmt");
+  if (fmt.length()) return fmt == "cbor";
+  return server.header("Accept").indexOf("application/cbor") >= 0;
+}
+
+// Chunked CBOR odpověď přes BodySource: step se volá, až si server data dotahuje, takže výpis
+// neomezuje kMaxResponseBytes. Stav mezi kroky si step nese sám (handler už skončil).
+static const size_t kCborRowsPerStep = 16;
+
+inline void sendCborStream(CborStream::Step step) {
+  auto stream = std::make_shared<CborStream>(std::move(step));
+  server.sendStream(200, "application/cbor",
+                    [stream](uint8_t *buf, size_t max) { return stream->read(buf, max); });
+}
+
+inline void cborFieldNames(CborWriter &w, const char *const *names, size_t n) {
+  w.beginArray(n);
+  for (size_t i = 0; i < n; ++i) w.value(names[i]);
+}
+
+inline void handleApiDiag() {
+  if (clientWantsCbor()) {
+    sendCborStream([](CborWriter &w) {
+      writeDiagnostics(w);
+      return false;
+    });
+    return;
+  }
+  server.send(200, "application/json", buildDiagnosticsJson());
+}
+
+// Události RAM historie od nejnovější, s filtrem „jen UNKNOWN“ (společné pro JSON i CBOR).
+template <typename Fn>
+inline void forEachHistoryEvent(Fn &&fn) {
+  for (size_t i = 0; i < histCount; i++) {
+    size_t idx = (histWrite + HISTORY_LEN - 1 - i) % HISTORY_LEN;
+    const IREvent &e = history[idx];
+    LearnedCode learnedCode;
+    const LearnedCode *learned =
+        (e.learnedId > 0 && getLearnedById(static_cast<uint32_t>(e.learnedId), learnedCode)) ? &learnedCode : nullptr;
+    if (g_showOnlyUnknown && !isEffectivelyUnknown(e)) continue;
+    fn(e, learned);
+  }
+}
+
+static const char *const kHistoryFields[] = {
+  "ms", "seq", "proto", "bits", "addr", "cmd", "value", "flags",
+  "learned", "learned_proto", "learned_vendor", "learned_function", "learned_remote"
+};
+
+// RAM historie má jen HISTORY_LEN záznamů – celá v jednom kroku.
+inline void writeHistoryCbor(CborWriter &w) {
+  static const String kEmpty;
+  w.beginMap();
+  w.field("ip", WiFi.localIP().toString());
+  w.field("rssi", WiFi.RSSI());
+  w.field("only_unknown", g_showOnlyUnknown);
+  w.key("fields");
+  cborFieldNames(w, kHistoryFields, sizeof(kHistoryFields) / sizeof(kHistoryFields[0]));
+  w.key("history"); w.beginArray();
+  forEachHistoryEvent([&](const IREvent &e, const LearnedCode *learned) {
+    w.beginArray(sizeof(kHistoryFields) / sizeof(kHistoryFields[0]));
+    w.value(e.ms);
+    w.value(e.seq);
+    if (learned && learned->proto.length()) w.value(learned->proto);
+    else w.value(protoLabel(e.proto));
+    w.value(static_cast<uint32_t>(e.bits));
+    w.value(e.address);
+    w.value(e.command);
+    w.value(e.value);
+    w.value(e.flags);
+    w.value(learned != nullptr);
+    w.value(learned ? learned->proto : kEmpty);
+    w.value(learned ? learned->vendor : kEmpty);
+    w.value(learned ? learned->function : kEmpty);
+    w.value(learned ? learned->remote : kEmpty);
+  });
+  w.end();
+  w.end();
+}
+
 // === /api/history (GET) – beze změn ve struktuře ===
 inline void handleJsonHistory() {
+  if (clientWantsCbor()) {
+    sendCborStream([](CborWriter &w) {
+      writeHistoryCbor(w);
+      return false;
+    });
+    return;
+  }
   String out; out.reserve(3072);
   out += F("{\"ip\":\""); out += WiFi.localIP().toString();
   out += F("\",\"rssi\":"); out += WiFi.RSSI();
   out += F(",\"only_unknown\":"); out += g_showOnlyUnknown ? "true" : "false";
   out += F(",\"history\":[");
   bool first = true;
-  for (size_t i = 0; i < histCount; i++) {
-    size_t idx = (histWrite + HISTORY_LEN - 1 - i) % HISTORY_LEN;
-    const IREvent &e = history[idx];
-    const LearnedCode *learned = getLearnedByIndex(e.learnedIndex);
-    if (g_showOnlyUnknown && !isEffectivelyUnknown(e)) continue;
+  forEachHistoryEvent([&](const IREvent &e, const LearnedCode *learned) {
     if (!first) out += ',';
     out += F("{\"ms\":"); out += e.ms;
+    out += F(",\"seq\":"); out += e.seq;
     out += F(",\"proto\":\"");
     String protoStr = learned && learned->proto.length() ? learned->proto : String(protoName(e.proto));
     out += jsonEscape(protoStr);
@@ -393,7 +552,7 @@ inline void handleJsonHistory() {
     out += F("\",\"learned_remote\":\""); if (learned && learned->remote.length()) out += jsonEscape(learned->remote);
     out += F("\"}");
     first = false;
-  }
+  });
   out += F("]}");
   server.send(200, "application/json", out);
 }
@@ -467,8 +626,8 @@ inline void handleLearnSave() {
 }
 
 // === /learned (GET) – tabulka naučených + inline editor + ODESLAT (repeat) ===
+// Data si stránka bere po stránkách z /api/learned (filtr a řazení dělá server).
 inline void handleLearnedList() {
-  String data = fsReadLearnedAsArrayJSON();
   String html; html.reserve(9000);
   html += F(
     "<!doctype html><html lang='cs'><head><meta charset='utf-8'>"
@@ -481,21 +640,33 @@ inline void handleLearnedList() {
     "th{background:#f5f5f5}"
     "code{font-family:ui-monospace,SFMono-Regular,Consolas,monospace}"
     ".btn{display:inline-block;padding:6px 10px;border-radius:8px;border:1px solid #bbb;background:#fafafa;text-decoration:none;color:#222}"
+    "#filt{display:flex;flex-wrap:wrap;gap:8px;align-items:center;margin:8px 0}"
+    "#filt input[type=text]{padding:4px 6px;width:140px}"
     "#editModal{position:fixed;inset:0;display:none;align-items:center;justify-content:center;background:rgba(0,0,0,.35)}"
     "#editModal .card{background:#fff;padding:16px 16px 12px;border-radius:10px;min-width:320px;max-width:90vw}"
     "#editModal label{display:block;margin:6px 0 2px;font-size:14px}"
     "#editModal input[type=text]{width:100%;padding:6px 8px;font-size:14px}"
     "</style></head><body>"
     "<h1>Naučené kódy</h1>"
+    "<form id='filt'>"
+      "<input type='text' name='vendor' placeholder='výrobce'>"
+      "<input type='text' name='remote' placeholder='ovladač'>"
+      "<input type='text' name='function' placeholder='funkce'>"
+      "<label>Řadit: <select name='sort'><option value='id'>id</option><option value='vendor'>výrobce</option>"
+      "<option value='remote'>ovladač</option><option value='function'>funkce</option></select></label>"
+      "<button type='submit' class='btn'>Filtrovat</button>"
+      "<span id='total' style='color:#666'></span>"
+    "</form>"
     "<table><thead><tr>"
-    "<th>#</th><th>vendor</th><th>proto</th><th>function</th><th>remote_label</th>"
+    "<th>id</th><th>vendor</th><th>proto</th><th>function</th><th>remote_label</th>"
     "<th>bits</th><th>addr</th><th>value</th><th>flags</th><th>Akce</th>"
     "</tr></thead><tbody id='tb'></tbody></table>"
+    "<p><button type='button' class='btn' id='more' style='display:none'>Další</button></p>"
     "<p><a href='/'>← Domů</a></p>"
     "<div id='editModal'><div class='card'>"
       "<h3 style='margin:0 0 8px;font-size:16px'>Upravit kód</h3>"
       "<form id='editForm'>"
-        "<input type='hidden' name='index'>"
+        "<input type='hidden' name='id'>"
         "<label>Protokol:</label><input type='text' name='proto' placeholder='např. NEC' required>"
         "<label>Výrobce:</label><input type='text' name='vendor' placeholder='např. Toshiba' required>"
         "<label>Funkce:</label><input type='text' name='function' placeholder='např. Power, TempUp' required>"
@@ -506,43 +677,282 @@ inline void handleLearnedList() {
         "</div>"
       "</form>"
     "</div></div>"
-    "<script>const data="
-  );
-  html += data;
-  html += F(";"
+    "<script>"
     "const tb=document.getElementById('tb');"
+    "const filt=document.getElementById('filt');"
+    "const moreBtn=document.getElementById('more');"
     "const modal=document.getElementById('editModal');"
     "const form=document.getElementById('editForm');"
     "const cancelBtn=document.getElementById('editCancel');"
-    "const idxInput=form.querySelector('input[name=index]');"
+    "const idInput=form.querySelector('input[name=id]');"
+    "let next=null;"
     "function toHex(num){return '0x'+((num>>>0).toString(16).toUpperCase());}"
-    "function openEdit(idx,obj){idxInput.value=idx;form.proto.value=obj.proto||'UNKNOWN';form.vendor.value=obj.vendor||'';form.function.value=obj.function||'';form.remote_label.value=obj.remote_label||'';modal.style.display='flex'}"
+    "function openEdit(obj){idInput.value=obj.id;form.proto.value=obj.proto||'UNKNOWN';form.vendor.value=obj.vendor||'';form.function.value=obj.function||'';form.remote_label.value=obj.remote_label||'';modal.style.display='flex'}"
     "cancelBtn.onclick=()=>{modal.style.display='none'};"
     "modal.addEventListener('click',e=>{if(e.target===modal){modal.style.display='none'}});"
-    "form.onsubmit=async(e)=>{e.preventDefault();const fd=new FormData(form);const params=new URLSearchParams(fd);try{const r=await fetch('/api/learn_update',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:params});const j=await r.json();if(j.ok){alert('Uloženo.');modal.style.display='none';location.reload();}else{alert('Uložení selhalo.');}}catch(err){alert('Chyba připojení.');}};"
-    "data.forEach((o,i)=>{const tr=document.createElement('tr');"
+    "form.onsubmit=async(e)=>{e.preventDefault();const fd=new FormData(form);const params=new URLSearchParams(fd);try{const r=await fetch('/api/learn_update',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:params});const j=await r.json();if(j.ok){alert('Uloženo.');modal.style.display='none';load(true);}else{alert('Uložení selhalo.');}}catch(err){alert('Chyba připojení.');}};"
+    "function addRow(o){const tr=document.createElement('tr');"
       "function cell(t){const td=document.createElement('td');td.textContent=t;tr.appendChild(td)}"
-      "cell(i+1); cell(o.vendor||''); cell(o.proto||'UNKNOWN'); cell(o.function||''); cell(o.remote_label||'');"
+      "cell(o.id); cell(o.vendor||''); cell(o.proto||'UNKNOWN'); cell(o.function||''); cell(o.remote_label||'');"
       "cell(o.bits||0); cell(toHex(o.addr||0)); cell(toHex(o.value||0)); cell(o.flags||0);"
       "const act=document.createElement('td');"
-      "const edit=document.createElement('button'); edit.className='btn'; edit.textContent='Upravit'; edit.onclick=()=>openEdit(i,o); act.appendChild(edit);"
+      "const edit=document.createElement('button'); edit.className='btn'; edit.textContent='Upravit'; edit.onclick=()=>openEdit(o); act.appendChild(edit);"
       // Odeslat s repeat volbou
       "const sbtn=document.createElement('button'); sbtn.className='btn'; sbtn.textContent='Odeslat'; sbtn.style.marginLeft='6px';"
       "const rep=document.createElement('input'); rep.type='number'; rep.min=0; rep.max=3; rep.value=0; rep.title='repeat'; rep.style.width='56px'; rep.style.marginLeft='6px';"
-      "sbtn.onclick=async()=>{try{const r=await fetch('/api/send?index='+i+'&repeat='+rep.value); const j=await r.json(); if(!j.ok) alert('Odeslání selhalo: '+(j.err||'error'));}catch(e){alert('Chyba odeslání: '+e);}};"
+      "sbtn.onclick=async()=>{try{const r=await fetch('/api/send?id='+o.id+'&repeat='+rep.value); const j=await r.json(); if(!j.ok) alert('Odeslání selhalo: '+(j.err||'error'));}catch(e){alert('Chyba odeslání: '+e);}};"
       "act.appendChild(sbtn); act.appendChild(rep);"
       "const del=document.createElement('button'); del.className='btn'; del.textContent='Smazat'; del.style.marginLeft='6px';"
-      "del.onclick=async()=>{if(!confirm('Smazat tento kód?')) return; const params=new URLSearchParams(); params.set('index',i); try{const r=await fetch('/api/learn_delete',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:params}); const j=await r.json(); if(j.ok){alert('Smazáno.'); location.reload();}else{alert('Smazání selhalo.');}}catch(err){alert('Chyba smazání.');}};"
+      "del.onclick=async()=>{if(!confirm('Smazat tento kód?')) return; const params=new URLSearchParams(); params.set('id',o.id); try{const r=await fetch('/api/learn_delete',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:params}); const j=await r.json(); if(j.ok){alert('Smazáno.'); tr.remove();}else{alert('Smazání selhalo.');}}catch(err){alert('Chyba smazání.');}};"
       "act.appendChild(del); tr.appendChild(act); tb.appendChild(tr);"
-    "});"
+    "}"
+    "async function load(reset){"
+      "const p=new URLSearchParams(new FormData(filt));"
+      "for(const [k,v] of [...p]){if(!v.trim())p.delete(k)}"
+      "p.set('limit','50');if(!reset&&next!==null)p.set('cursor',next);"
+      "try{const r=await fetch('/api/learned?'+p.toString());const j=await r.json();"
+      "if(reset)tb.innerHTML='';"
+      "(j.items||[]).forEach(addRow);next=j.next;"
+      "moreBtn.style.display=(next!==null&&next!==undefined)?'':'none';"
+      "document.getElementById('total').textContent=(j.total||0)+' kódů';"
+      "}catch(e){alert('Chyba načtení.');}"
+    "}"
+    "filt.onsubmit=e=>{e.preventDefault();next=null;load(true)};"
+    "moreBtn.onclick=()=>load(false);"
+    "load(true);"
     "</script></body></html>"
   );
   server.send(200, "text/html; charset=utf-8", html);
 }
 
-// === /api/learned (GET) – JSON list ===
+// === /api/learned (GET) – výpis naučených kódů ===
+// Bez limit/cursor (a bez CBOR) původní tvar: holé JSON pole všech kódů, streamované po stránkách.
+// Stránkovaný výpis: limit (max 100), cursor=<"next" z předchozí stránky>, ?vendor=&remote=&function=
+// (podřetězec, bez ohledu na velikost písmen), sort=id|vendor|remote|function.
+// Odpověď: {"total","items":[…],"next"}.
+// Bez filtru a při řazení podle id se čtou jen potřebné stránky katalogu, jinak jeden průchod
+// souborem s omezeným výběrem top-K (v RAM nejvýš limit+1 kódů).
+enum class LearnedSortKey : uint8_t { Id, Vendor, Remote, Function };
+
+inline const String &learnedSortField(const LearnedCode &e, LearnedSortKey k) {
+  switch (k) {
+    case LearnedSortKey::Vendor: return e.vendor;
+    case LearnedSortKey::Remote: return e.remote;
+    default:                     return e.function;
+  }
+}
+
+// Pořadí výpisu; při shodném textu rozhoduje id, takže kurzor je jednoznačný.
+inline bool learnedSortLess(const LearnedCode &a, const LearnedCode &b, LearnedSortKey k) {
+  if (k != LearnedSortKey::Id) {
+    const int c = strcasecmp(learnedSortField(a, k).c_str(), learnedSortField(b, k).c_str());
+    if (c) return c < 0;
+  }
+  return a.id < b.id;
+}
+
+inline bool learnedFieldContains(const String &field, const String &needleLower) {
+  if (!needleLower.length()) return true;
+  String f = field;
+  f.toLowerCase();
+  return f.indexOf(needleLower) >= 0;
+}
+
+inline void appendLearnedJson(String &out, const LearnedCode &e) {
+  out += F("{\"id\":"); out += e.id;
+  out += F(",\"proto\":\""); out += jsonEscape(e.proto);
+  out += F("\",\"vendor\":\""); out += jsonEscape(e.vendor);
+  out += F("\",\"function\":\""); out += jsonEscape(e.function);
+  out += F("\",\"remote_label\":\""); out += jsonEscape(e.remote);
+  out += F("\",\"bits\":"); out += static_cast<uint32_t>(e.bits);
+  out += F(",\"addr\":"); out += e.addr;
+  out += F(",\"value\":"); out += e.value;
+  out += F(",\"flags\":"); out += e.flags;
+  out += '}';
+}
+
+// Holé pole pro starší klienty: kódy se berou po stránkách katalogu (v RAM jeden blok, soubor
+// se mezi bloky nedrží otevřený); souběžná úprava databáze může kód vynechat, nerozbije výstup.
+class LearnedJsonArrayStream {
+public:
+  size_t read(uint8_t *buf, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+      if (_off >= _pending.length() && !refill()) break;
+      const size_t chunk = std::min(max - n, static_cast<size_t>(_pending.length() - _off));
+      memcpy(buf + n, _pending.c_str() + _off, chunk);
+      _off += chunk;
+      n += chunk;
+    }
+    return n;
+  }
+
+private:
+  String   _pending;
+  size_t   _off = 0;
+  uint32_t _ordinal = 0;
+  bool     _started = false;
+  bool     _first = true;
+  bool     _done = false;
+
+  bool refill() {
+    _pending = "";
+    _off = 0;
+    if (_done) return false;
+    if (!_started) {
+      _pending = '[';
+      _started = true;
+    }
+    ensureLearnedCacheLoaded();
+    const uint32_t total = g_learnedCatalog.count();
+    LearnedCode e;
+    for (uint16_t n = 0; n < LearnedCatalog<LearnedCode>::kPageSize && _ordinal < total; ++n, ++_ordinal) {
+      if (!g_learnedCatalog.getByOrdinal(_ordinal, e)) continue;
+      if (!_first) _pending += ',';
+      appendLearnedJson(_pending, e);
+      _first = false;
+    }
+    if (_ordinal >= total) {
+      _pending += ']';
+      _done = true;
+    }
+    return true;
+  }
+};
+
+static const char *const kLearnedFields[] = {
+  "id", "proto", "vendor", "function", "remote_label", "bits", "addr", "value", "flags"
+};
+
+inline void cborLearnedRow(CborWriter &w, const LearnedCode &e) {
+  w.beginArray(sizeof(kLearnedFields) / sizeof(kLearnedFields[0]));
+  w.value(e.id);
+  w.value(e.proto);
+  w.value(e.vendor);
+  w.value(e.function);
+  w.value(e.remote);
+  w.value(static_cast<uint32_t>(e.bits));
+  w.value(e.addr);
+  w.value(e.value);
+  w.value(e.flags);
+}
+
 inline void handleApiLearned() {
-  server.send(200, "application/json", fsReadLearnedAsArrayJSON());
+  static const size_t kDefaultLimit = 50;
+  static const size_t kMaxLimit = 100;
+
+  if (!server.hasArg("limit") && !server.hasArg("cursor") && !clientWantsCbor()) {
+    auto stream = std::make_shared<LearnedJsonArrayStream>();
+    server.sendStream(200, "application/json",
+                      [stream](uint8_t *buf, size_t max) { return stream->read(buf, max); });
+    return;
+  }
+
+  size_t limit = server.hasArg("limit") ? strtoul(server.arg("limit").c_str(), nullptr, 10) : kDefaultLimit;
+  if (limit == 0 || limit > kMaxLimit) limit = kMaxLimit;
+
+  LearnedSortKey key = LearnedSortKey::Id;
+  const String sort = server.arg("sort");
+  if (sort == "vendor") key = LearnedSortKey::Vendor;
+  else if (sort == "remote") key = LearnedSortKey::Remote;
+  else if (sort == "function") key = LearnedSortKey::Function;
+
+  String fVendor = server.arg("vendor");     fVendor.trim();   fVendor.toLowerCase();
+  String fRemote = server.arg("remote");     fRemote.trim();   fRemote.toLowerCase();
+  String fFunction = server.arg("function"); fFunction.trim(); fFunction.toLowerCase();
+  const bool filtered = fVendor.length() || fRemote.length() || fFunction.length();
+
+  const uint32_t after = server.hasArg("cursor") ? strtoul(server.arg("cursor").c_str(), nullptr, 10) : 0;
+  LearnedCode cursor;
+  cursor.id = after;
+  if (after && key != LearnedSortKey::Id && !getLearnedById(after, cursor)) {
+    // kód z konce předchozí stránky mezitím zmizel – klient musí začít znovu
+    server.send(409, "application/json", "{\"ok\":false,\"err\":\"stale cursor\"}");
+    return;
+  }
+
+  ensureLearnedCacheLoaded();
+  std::vector<LearnedCode> page;
+  page.reserve(limit + 1);
+  uint32_t total = 0;
+  auto less = [key](const LearnedCode &a, const LearnedCode &b) { return learnedSortLess(a, b, key); };
+
+  if (!filtered && key == LearnedSortKey::Id) {
+    total = g_learnedCatalog.count();
+    LearnedCode e;
+    for (uint32_t o = after ? g_learnedCatalog.ordinalForId(after + 1) : 0; o < total && page.size() <= limit; ++o) {
+      if (g_learnedCatalog.getByOrdinal(o, e)) page.push_back(e);
+    }
+  } else {
+    g_learnedCatalog.scan([&](const LearnedCode &e) {
+      if (!learnedFieldContains(e.vendor, fVendor) || !learnedFieldContains(e.remote, fRemote) ||
+          !learnedFieldContains(e.function, fFunction)) {
+        return true;
+      }
+      total++;
+      if (after && !less(cursor, e)) return true;
+      auto pos = std::upper_bound(page.begin(), page.end(), e, less);
+      if (page.size() > limit && pos == page.end()) return true;
+      page.insert(pos, e);
+      if (page.size() > limit + 1) page.pop_back();
+      return true;
+    });
+  }
+
+  const bool more = page.size() > limit;
+  if (more) page.resize(limit);
+
+  if (clientWantsCbor()) {
+    struct Page {
+      std::vector<LearnedCode> items;
+      uint32_t total = 0;
+      bool     more = false;
+      size_t   row = 0;
+      bool     started = false;
+    };
+    auto p = std::make_shared<Page>();
+    p->items.swap(page);
+    p->total = total;
+    p->more = more;
+    sendCborStream([p](CborWriter &w) {
+      if (!p->started) {
+        w.beginMap();
+        w.field("total", p->total);
+        w.key("fields");
+        cborFieldNames(w, kLearnedFields, sizeof(kLearnedFields) / sizeof(kLearnedFields[0]));
+        w.key("items"); w.beginArray(p->items.size());
+        p->started = true;
+      }
+      for (size_t n = 0; n < kCborRowsPerStep && p->row < p->items.size(); ++n) cborLearnedRow(w, p->items[p->row++]);
+      if (p->row < p->items.size()) return true;
+      w.key("next");
+      if (p->more) w.value(p->items.back().id);
+      else w.null();
+      w.end();
+      return false;
+    });
+    return;
+  }
+
+  String out; out.reserve(48 + page.size() * 160);
+  out += F("{\"total\":"); out += total;
+  out += F(",\"items\":[");
+  for (size_t i = 0; i < page.size(); ++i) {
+    if (i) out += ',';
+    appendLearnedJson(out, page[i]);
+  }
+  out += F("],\"next\":");
+  if (more) out += page.back().id;
+  else out += F("null");
+  out += '}';
+  server.send(200, "application/json", out);
+}
+
+// Id kódu z parametru "id", případně ze staršího "index" (pořadí v databázi). 0 = chybí/neznámé.
+inline uint32_t learnedIdFromArgs() {
+  if (server.hasArg("id")) return static_cast<uint32_t>(strtoul(server.arg("id").c_str(), nullptr, 10));
+  if (server.hasArg("index")) return learnedIdForOrdinal(static_cast<uint32_t>(strtoul(server.arg("index").c_str(), nullptr, 10)));
+  return 0;
 }
 
 // === /api/learn_save (POST) – povolí i UNKNOWN, nic neblokuje
@@ -598,59 +1008,133 @@ inline void handleApiLearnSave() {
   server.send(200, "application/json", ok ? "{\"ok\":true}" : "{\"ok\":false}");
 }
 
+// === /api/learn_multi/* – učení z více stisků (RawConsensus) ===
+// start?n=2..8 → stiskni tlačítko n× → status (průběh + odhad kvality) → save (metadata jako learn_save).
+inline void handleApiLearnMultiStart() {
+  long n = server.hasArg("n") ? strtol(server.arg("n").c_str(), nullptr, 10) : 5;
+  if (n < 2) n = 2;
+  if (n > (long)RawConsensus::kMaxCaptures) n = RawConsensus::kMaxCaptures;
+  learnMultiStart(static_cast<uint8_t>(n));
+  server.send(200, "application/json", learnMultiStatusJson());
+}
+
+inline void handleApiLearnMultiStatus() {
+  server.send(200, "application/json", learnMultiStatusJson());
+}
+
+inline void handleApiLearnMultiCancel() {
+  learnMultiCancel();
+  server.send(200, "application/json", "{\"ok\":true}");
+}
+
+// value/bits/addr jsou povinné jako u learn_save (UI je předvyplní z řádku historie) – jsou klíčem
+// pro párování a bez nich by všechny takto naučené kódy sdílely klíč (0,0,0). flags/proto jsou
+// volitelné, RAW je vždy kanonický.
+inline void handleApiLearnMultiSave() {
+  auto need = [&](const char* k){ return server.hasArg(k) && server.arg(k).length() > 0; };
+  if (!(need("value") && need("bits") && need("addr") && need("vendor") && need("function"))) {
+    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing params\"}");
+    return;
+  }
+  if (!learnMultiActive()) {
+    server.send(409, "application/json", "{\"ok\":false,\"err\":\"learn mode not active\"}");
+    return;
+  }
+  const RawConsensus::Result r = learnMultiResult();
+  if (!r.ok) {
+    String out = F("{\"ok\":false,\"err\":\"");
+    out += r.err;
+    out += F("\"}");
+    server.send(409, "application/json", out);
+    return;
+  }
+
+  auto argU32 = [&](const char* k){ return need(k) ? (uint32_t) strtoul(server.arg(k).c_str(), nullptr, 10) : 0UL; };
+  String proto  = need("proto") ? server.arg("proto") : String(F("UNKNOWN")); proto.trim();
+  String vendor = server.arg("vendor");  vendor.trim();
+  String func   = server.arg("function");func.trim();
+  String remote = server.hasArg("remote_label") ? server.arg("remote_label") : "";
+  remote.trim();
+
+  bool ok = fsAppendLearned(argU32("value"), (uint8_t) argU32("bits"), argU32("addr"), argU32("flags"),
+                            proto, vendor, func, remote, &r.raw, 38, r.quality);   // sniffer nosnou neměří
+  if (!ok) {
+    server.send(200, "application/json", "{\"ok\":false}");
+    return;
+  }
+  learnMultiCancel();
+  String out; out.reserve(96);
+  out += F("{\"ok\":true,\"quality\":");  out += (uint32_t) r.quality;
+  out += F(",\"used\":");                  out += (uint32_t) r.used;
+  out += F(",\"rejected\":");              out += (uint32_t) r.rejected;
+  out += F(",\"len\":");                   out += (uint32_t) r.raw.size();
+  out += '}';
+  server.send(200, "application/json", out);
+}
+
+
+// Přepis databáze během /api/export by stream rozbil – klient to má zkusit po dokončení exportu.
+inline bool rejectWhileExporting() {
+  if (!learnedExportActive()) return false;
+  server.send(409, "application/json", "{\"ok\":false,\"err\":\"export in progress\"}");
+  return true;
+}
 
 // === /api/learn_update (POST) – update metadat ===
 inline void handleApiLearnUpdate() {
   auto need = [&](const char* k){ return server.hasArg(k) && server.arg(k).length() > 0; };
-  if (!need("index") || !need("proto") || !need("vendor") || !need("function")) {
+  if (!(need("id") || need("index")) || !need("proto") || !need("vendor") || !need("function")) {
     server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing params\"}");
     return;
   }
-  size_t index = static_cast<size_t>(strtoul(server.arg("index").c_str(), nullptr, 10));
+  if (rejectWhileExporting()) return;
+  const uint32_t id = learnedIdFromArgs();
   String proto  = server.arg("proto");        proto.trim();
   String vendor = server.arg("vendor");       vendor.trim();
   String func   = server.arg("function");     func.trim();
   String remote = server.hasArg("remote_label") ? server.arg("remote_label") : ""; remote.trim();
-  bool ok = fsUpdateLearned(index, proto, vendor, func, remote);
+  bool ok = id && fsUpdateLearned(id, proto, vendor, func, remote);
   server.send(200, "application/json", ok ? "{\"ok\":true}" : "{\"ok\":false}");
 }
 
 inline void handleApiLearnDelete() {
-  if (!server.hasArg("index")) {
-    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing index\"}");
+  if (!server.hasArg("id") && !server.hasArg("index")) {
+    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing id\"}");
     return;
   }
-  size_t index = static_cast<size_t>(strtoul(server.arg("index").c_str(), nullptr, 10));
-  bool ok = fsDeleteLearned(index);
+  if (rejectWhileExporting()) return;
+  const uint32_t id = learnedIdFromArgs();
+  bool ok = id && fsDeleteLearned(id);
   server.send(ok ? 200 : 500, "application/json", ok ? "{\"ok\":true}" : "{\"ok\":false}");
 }
 
 // === /api/send (GET) – odeslání naučeného kódu (support repeat) ===
 // === /api/send (GET) – odeslání naučeného kódu (nová verze) ===
 inline void handleApiSend() {
-  if (!server.hasArg("index")) {
-    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing index\"}");
+  if (!server.hasArg("id") && !server.hasArg("index")) {
+    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing id\"}");
     return;
   }
-  const int idx = strtol(server.arg("index").c_str(), nullptr, 10);
+  const uint32_t id = learnedIdFromArgs();
   uint8_t reps = 0;
   if (server.hasArg("repeat")) {
     long r = strtol(server.arg("repeat").c_str(), nullptr, 10);
     if (r < 0) r = 0; if (r > 3) r = 3; reps = (uint8_t)r;
   }
 
-  const bool ok = irSendLearnedByIndex(idx, reps);
+  const bool ok = id && irSendLearnedById(id, reps);
   if (ok) { server.send(200, "application/json", "{\"ok\":true}"); return; }
 
   server.send(501, "application/json", "{\"ok\":false,\"err\":\"no mapped proto and no RAW\"}");
 }
 
 inline void handleApiHistorySend() {
-  if (!server.hasArg("ms")) {
-    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing ms\"}");
+  const bool bySeq = server.hasArg("seq");
+  if (!bySeq && !server.hasArg("ms")) {
+    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing seq or ms\"}");
     return;
   }
-  uint32_t targetMs = static_cast<uint32_t>(strtoul(server.arg("ms").c_str(), nullptr, 10));
+  const uint32_t target = static_cast<uint32_t>(strtoul(server.arg(bySeq ? "seq" : "ms").c_str(), nullptr, 10));
   uint8_t repeats = 0;
   if (server.hasArg("repeat")) {
     long r = strtol(server.arg("repeat").c_str(), nullptr, 10);
@@ -659,16 +1143,24 @@ inline void handleApiHistorySend() {
     repeats = static_cast<uint8_t>(r);
   }
 
+  // seq je jednoznačné; ms zůstává kvůli kompatibilitě (po přetečení millis() může být nejednoznačné)
   const IREvent* match = nullptr;
   for (size_t i = 0; i < histCount; ++i) {
     size_t idx = (histWrite + HISTORY_LEN - 1 - i) % HISTORY_LEN;
     const IREvent &ev = history[idx];
-    if (ev.ms == targetMs) {
+    if ((bySeq ? ev.seq : ev.ms) == target) {
       match = &ev;
       break;
     }
   }
 
+  IREvent fromLog;
+  IrLogRecord rec;
+  if (!match && bySeq && g_eventLog.findBySeq(target, rec)) {
+    fromLog = eventFromLogRecord(rec);
+    match = &fromLog;
+  }
+
   if (!match) {
     server.send(404, "application/json", "{\"ok\":false,\"err\":\"not found\"}");
     return;
@@ -678,8 +1170,93 @@ inline void handleApiHistorySend() {
   server.send(ok ? 200 : 500, "application/json", ok ? "{\"ok\":true}" : "{\"ok\":false,\"err\":\"send failed\"}");
 }
 
-inline void handleApiDiag() {
-  server.send(200, "application/json", buildDiagnosticsJson());
+// === /api/events (GET) – stránkovaný dotaz do trvalého logu ===
+// ?from_seq=N (výchozí nejstarší), ?t1=&t2= (unix s, volitelné), ?limit= (max 100).
+// Další stránku vrací kurzor next_seq (0 = konec).
+inline void handleApiEvents() {
+  auto argU32 = [](const char *k, uint32_t def) {
+    return server.hasArg(k) ? static_cast<uint32_t>(strtoul(server.arg(k).c_str(), nullptr, 10)) : def;
+  };
+  const uint32_t fromSeq = argU32("from_seq", g_eventLog.oldestSeq());
+  const uint32_t t1 = argU32("t1", 0);
+  const uint32_t t2 = argU32("t2", 0);
+  const size_t limit = argU32("limit", 50);
+
+  std::vector<IrLogRecord> recs;
+  uint32_t nextSeq = 0;
+  g_eventLog.query(fromSeq, t1, t2, limit, recs, nextSeq);
+
+  if (clientWantsCbor()) {
+    static const char *const kFields[] = {
+      "seq", "t", "boot", "ms", "proto", "bits", "addr", "cmd", "value", "flags", "learned_id"
+    };
+    static const size_t kFieldCount = sizeof(kFields) / sizeof(kFields[0]);
+    struct Page {
+      std::vector<IrLogRecord> recs;
+      uint32_t nextSeq = 0;
+      size_t   row = 0;
+      bool     started = false;
+    };
+    auto p = std::make_shared<Page>();
+    p->recs.swap(recs);
+    p->nextSeq = nextSeq;
+    sendCborStream([p](CborWriter &w) {
+      if (!p->started) {
+        w.beginMap();
+        w.field("ok", true);
+        w.field("oldest_seq", g_eventLog.oldestSeq());
+        w.field("next_seq", p->nextSeq);
+        w.field("now", IrEventLog::nowEpoch());
+        w.key("fields");
+        cborFieldNames(w, kFields, kFieldCount);
+        w.key("events"); w.beginArray(p->recs.size());
+        p->started = true;
+      }
+      for (size_t n = 0; n < kCborRowsPerStep && p->row < p->recs.size(); ++n) {
+        const IrLogRecord &r = p->recs[p->row++];
+        w.beginArray(kFieldCount);
+        w.value(r.seq);
+        w.value(r.epoch);
+        w.value(static_cast<uint32_t>(r.boot));
+        w.value(r.uptimeMs);
+        w.value(protoLabel(static_cast<decode_type_t>(r.proto)));
+        w.value(static_cast<uint32_t>(r.bits));
+        w.value(r.address);
+        w.value(r.command);
+        w.value(r.value);
+        w.value(static_cast<uint32_t>(r.flags));
+        w.value(r.learnedId);
+      }
+      if (p->row < p->recs.size()) return true;
+      w.end();
+      return false;
+    });
+    return;
+  }
+
+  String out; out.reserve(96 + recs.size() * 140);
+  out += F("{\"ok\":true,\"oldest_seq\":"); out += g_eventLog.oldestSeq();
+  out += F(",\"next_seq\":"); out += nextSeq;
+  out += F(",\"now\":"); out += IrEventLog::nowEpoch();
+  out += F(",\"events\":[");
+  for (size_t i = 0; i < recs.size(); ++i) {
+    const IrLogRecord &r = recs[i];
+    if (i) out += ',';
+    out += F("{\"seq\":"); out += r.seq;
+    out += F(",\"t\":"); out += r.epoch;
+    out += F(",\"boot\":"); out += static_cast<uint32_t>(r.boot);
+    out += F(",\"ms\":"); out += r.uptimeMs;
+    out += F(",\"proto\":\""); out += protoName(static_cast<decode_type_t>(r.proto));
+    out += F("\",\"bits\":"); out += static_cast<uint32_t>(r.bits);
+    out += F(",\"addr\":"); out += r.address;
+    out += F(",\"cmd\":"); out += r.command;
+    out += F(",\"value\":"); out += r.value;
+    out += F(",\"flags\":"); out += r.flags;
+    out += F(",\"learned_id\":"); out += static_cast<long>(r.learnedId);
+    out += '}';
+  }
+  out += F("]}");
+  server.send(200, "application/json", out);
 }
 
 inline void handleApiToshibaSend() {
@@ -693,13 +1270,7 @@ inline void handleApiToshibaSend() {
     s.powerOn = (server.arg("power") != "0");
   }
   if (server.hasArg("mode")) {
-    String m = server.arg("mode");
-    m.toLowerCase();
-    if (m == "auto") s.mode = ToshibaACIR::Mode::AUTO;
-    else if (m == "cool") s.mode = ToshibaACIR::Mode::COOL;
-    else if (m == "heat") s.mode = ToshibaACIR::Mode::HEAT;
-    else if (m == "dry") s.mode = ToshibaACIR::Mode::DRY;
-    else if (m == "fan") s.mode = ToshibaACIR::Mode::AUTO;
+    toshibaModeFromString(server.arg("mode"), s.mode);
   }
   if (server.hasArg("temp")) {
     long t = strtol(server.arg("temp").c_str(), nullptr, 10);
@@ -708,24 +1279,38 @@ inline void handleApiToshibaSend() {
     s.tempC = static_cast<uint8_t>(t);
   }
   if (server.hasArg("fan")) {
-    String f = server.arg("fan");
-    f.toLowerCase();
-    if (f == "auto") s.fan = ToshibaACIR::Fan::AUTO;
-    else if (f == "1") s.fan = ToshibaACIR::Fan::F1;
-    else if (f == "2") s.fan = ToshibaACIR::Fan::F2;
-    else if (f == "3") s.fan = ToshibaACIR::Fan::F3;
-    else if (f == "4") s.fan = ToshibaACIR::Fan::F4;
-    else if (f == "5") s.fan = ToshibaACIR::Fan::F5;
+    toshibaFanFromString(server.arg("fan"), s.fan);
   }
 
-  bool ok = toshiba.send(s);
+  bool ok = toshibaSend(s);
   if (ok) {
+    noteToshibaState(s);
     server.send(200, "application/json", "{\"ok\":true}");
   } else {
     server.send(500, "application/json", "{\"ok\":false,\"err\":\"toshiba send failed\"}");
   }
 }
 
+// === /api/send_batch (POST, JSON pole) – více příkazů v jednom požadavku ===
+inline void handleApiSendBatch() {
+  if (!server.hasArg("plain")) {
+    server.send(400, "application/json", "{\"ok\":false,\"err\":\"missing body\"}");
+    return;
+  }
+
+  std::vector<SendBatchItem> items;
+  String err;
+  int errIndex = -1;
+  if (!parseSendBatch(server.arg("plain"), items, err, errIndex)) {
+    server.send(400, "application/json", sendBatchErrorJson(err, errIndex));
+    return;
+  }
+
+  std::vector<SendBatchResult> results;
+  runSendBatch(items, results);
+  server.send(200, "application/json", sendBatchResultJson(results));
+}
+
 inline void handleApiRawSend() {
   uint8_t repeats = 0;
   if (server.hasArg("repeat")) {
@@ -742,6 +1327,61 @@ inline void handleApiRawDump() {
   server.send(200, "application/json", buildRawDumpJson());
 }
 
+// === /api/export (GET) – binární záloha celé learned databáze (stream, chunked) ===
+inline void handleApiExport() {
+  auto stream = std::make_shared<LearnedExportStream>();
+  server.sendHeader("Content-Disposition", "attachment; filename=\"learned.irdb\"");
+  server.sendStream(200, "application/octet-stream",
+                    [stream](uint8_t *buf, size_t max) { return stream->read(buf, max); });
+}
+
+// === /api/import (POST multipart, pole "file") – upload se ukládá do dočasného souboru ===
+static File g_importFile;
+static bool g_importUploadOk = false;
+
+inline void handleApiImportUpload() {
+  HTTPUpload &up = server.upload();
+  if (up.status == UPLOAD_FILE_START) {
+    if (g_importFile) g_importFile.close();
+    g_importFile = LittleFS.open(BACKUP_TMP_FILE, FILE_WRITE);
+    g_importUploadOk = static_cast<bool>(g_importFile);
+  } else if (up.status == UPLOAD_FILE_WRITE) {
+    if (g_importUploadOk && g_importFile.write(up.buf, up.currentSize) != up.currentSize) {
+      g_importUploadOk = false;
+    }
+  } else if (up.status == UPLOAD_FILE_END || up.status == UPLOAD_FILE_ABORTED) {
+    if (g_importFile) g_importFile.close();
+    if (up.status == UPLOAD_FILE_ABORTED) g_importUploadOk = false;
+  }
+}
+
+inline void handleApiImport() {
+  if (!g_importUploadOk) {
+    LittleFS.remove(BACKUP_TMP_FILE);
+    server.send(400, "application/json", "{\"ok\":false,\"err\":\"upload failed\"}");
+    return;
+  }
+  g_importUploadOk = false;
+
+  const bool replace = !(server.hasArg("mode") && server.arg("mode") == "append");
+  if (rejectWhileExporting()) {
+    LittleFS.remove(BACKUP_TMP_FILE);
+    return;
+  }
+  uint32_t count = 0;
+  String err;
+  const bool ok = fsImportLearned(BACKUP_TMP_FILE, replace, count, err);
+  LittleFS.remove(BACKUP_TMP_FILE);
+
+  String out;
+  if (ok) {
+    out = F("{\"ok\":true,\"imported\":"); out += count; out += '}';
+  } else {
+    out = F("{\"ok\":false,\"err\":\""); out += jsonEscape(err); out += F("\"}");
+  }
+  server.send(ok ? 200 : 400, "application/json", out);
+}
+
 
 // ====== Router a běh webu ======
 inline void startWebServer() {
@@ -755,14 +1395,22 @@ inline void startWebServer() {
   server.on("/api/history", handleJsonHistory);
   server.on("/api/learned", handleApiLearned);
   server.on("/api/learn_save", HTTP_POST, handleApiLearnSave);
+  server.on("/api/learn_multi/start", HTTP_POST, handleApiLearnMultiStart);
+  server.on("/api/learn_multi/status", handleApiLearnMultiStatus);
+  server.on("/api/learn_multi/save", HTTP_POST, handleApiLearnMultiSave);
+  server.on("/api/learn_multi/cancel", HTTP_POST, handleApiLearnMultiCancel);
   server.on("/api/learn_update", HTTP_POST, handleApiLearnUpdate);
   server.on("/api/learn_delete", HTTP_POST, handleApiLearnDelete);
   server.on("/api/send", handleApiSend);
   server.on("/api/history_send", handleApiHistorySend);
+  server.on("/api/events", handleApiEvents);
   server.on("/api/diag", handleApiDiag);
   server.on("/api/toshiba_send", handleApiToshibaSend);
+  server.on("/api/send_batch", HTTP_POST, handleApiSendBatch);
   server.on("/api/raw_send", handleApiRawSend);
   server.on("/api/raw_dump", handleApiRawDump);
+  server.on("/api/export", HTTP_GET, handleApiExport);
+  server.on("/api/import", HTTP_POST, handleApiImport, handleApiImportUpload);
 
   server.begin();
   Serial.println(F("[NET] WebServer běží na portu 80"));
@@ -0,0 +1,28 @@
+#pragma once
+// Minimální kostra hostových testů: CHECK() hlásí soubor:řádek, main vrací počet chyb.
+#include <stdio.h>
+
+static int g_hostTestFailures = 0;
+
+#define CHECK(cond)                                                        \
+  do {                                                                     \
+    if (!(cond)) {                                                         \
+      fprintf(stderr, "%s:%d: CHECK(%s) selhal\n", __FILE__, __LINE__, #cond); \
+      g_hostTestFailures++;                                                \
+    }                                                                      \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                     \
+  do {                                                                     \
+    const long long _va = static_cast<long long>(a);                       \
+    const long long _vb = static_cast<long long>(b);                       \
+    if (_va != _vb) {                                                      \
+      fprintf(stderr, "%s:%d: %s == %s selhal (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _va, _vb); \
+      g_hostTestFailures++;                                                \
+    }                                                                      \
+  } while (0)
+
+static inline int hostTestResult(const char *name) {
+  printf("%s: %s\n", name, g_hostTestFailures ? "FAIL" : "OK");
+  return g_hostTestFailures ? 1 : 0;
+}
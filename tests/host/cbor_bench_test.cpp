@@ -0,0 +1,419 @@
+// CborWriter / CborStream: stejná data jako /api/diag a /api/history (záznamy jako pole hodnot
+// s "fields") se zakódují do CBORu i do JSONu, CBOR se dekóduje zpět a porovná se zdrojem.
+// Vypíše velikosti a časy obou kódování; CborStream čtený po malých blocích musí dát stejné bajty
+// jako přímý zápis a velký výpis (nad limit odpovědi HttpServer) projde po krocích.
+#include <chrono>
+#include <string>
+#include <vector>
+#include "CborWriter.h"
+#include "HostTest.h"
+
+namespace {
+
+struct Event {
+  uint32_t    ms, seq;
+  std::string proto;
+  uint32_t    bits, addr, cmd, value, flags;
+  int32_t     learnedId;
+  std::string vendor, function, remote;
+};
+
+struct DiagField {
+  const char *section;
+  const char *key;
+  uint32_t    num;
+  std::string text;     // neprázdný = textová hodnota
+};
+
+const char *const kFields[] = {
+  "ms", "seq", "proto", "bits", "addr", "cmd", "value", "flags", "learned_id", "vendor", "function", "remote"
+};
+const size_t kFieldCount = sizeof(kFields) / sizeof(kFields[0]);
+
+std::vector<Event> makeHistory(size_t n) {
+  static const char *const vendors[] = { "Toshiba", "Samsung", "LG", "Sony" };
+  static const char *const functions[] = { "Power", "TempUp", "TempDown", "Mode", "Fan", "Vol+" };
+  std::vector<Event> h;
+  for (size_t i = 0; i < n; ++i) {
+    Event e;
+    e.ms = 1000 + static_cast<uint32_t>(i) * 373;
+    e.seq = 5000 + static_cast<uint32_t>(i);
+    e.proto = i % 3 ? "NEC" : "UNKNOWN";
+    e.bits = 32;
+    e.addr = i % 17;
+    e.cmd = i & 0xFF;
+    e.value = static_cast<uint32_t>(i * 7919u * 31337u + 13);
+    e.flags = i % 4;
+    e.learnedId = i % 3 ? static_cast<int32_t>(i + 1) : -1;
+    if (e.learnedId > 0) {
+      e.vendor = vendors[i % 4];
+      e.function = functions[i % 6];
+      e.remote = "Obyvak " + std::to_string(i % 5);
+    }
+    h.push_back(e);
+  }
+  return h;
+}
+
+std::vector<DiagField> makeDiag() {
+  return {
+    { "", "uptime_ms", 86400123, "" },    { "", "free_heap", 142312, "" },
+    { "", "min_free_heap", 98304, "" },   { "", "reset_reason", 0, "POWERON" },
+    { "", "version", 0, "1.9.0" },        { "wifi", "rssi", 0, "" },
+    { "wifi", "ip", 0, "192.168.1.57" },  { "wifi", "reconnects", 3, "" },
+    { "ir", "frames", 12873, "" },        { "ir", "dropped", 2, "" },
+    { "ir", "queue_high_water", 4, "" },  { "ir", "sent", 733, "" },
+    { "http", "requests", 40211, "" },    { "http", "connections", 5120, "" },
+    { "http", "oversized", 0, "" },       { "http", "max_poll_us", 3481, "" },
+    { "log", "records", 4096, "" },       { "log", "oldest_seq", 901, "" },
+    { "mqtt", "state", 0, "connected" },  { "mqtt", "published", 1844, "" },
+    { "mqtt", "received", 61, "" },       { "mqtt", "dropped", 0, "" },
+  };
+}
+
+// ---- JSON (stejný tvar jako ruční skládání String v .ino) ----
+
+void jsonStr(std::string &out, const std::string &s) {
+  out += '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') out += '\\';
+    out += c;
+  }
+  out += '"';
+}
+
+void jsonNum(std::string &out, int64_t v) { out += std::to_string(v); }
+
+std::string historyJson(const std::vector<Event> &h) {
+  std::string out;
+  out.reserve(64 + h.size() * 220);
+  out += "{\"only_unknown\":false,\"history\":[";
+  for (size_t i = 0; i < h.size(); ++i) {
+    const Event &e = h[i];
+    if (i) out += ',';
+    out += "{\"ms\":"; jsonNum(out, e.ms);
+    out += ",\"seq\":"; jsonNum(out, e.seq);
+    out += ",\"proto\":"; jsonStr(out, e.proto);
+    out += ",\"bits\":"; jsonNum(out, e.bits);
+    out += ",\"addr\":"; jsonNum(out, e.addr);
+    out += ",\"cmd\":"; jsonNum(out, e.cmd);
+    out += ",\"value\":"; jsonNum(out, e.value);
+    out += ",\"flags\":"; jsonNum(out, e.flags);
+    out += ",\"learned_id\":"; jsonNum(out, e.learnedId);
+    out += ",\"vendor\":"; jsonStr(out, e.vendor);
+    out += ",\"function\":"; jsonStr(out, e.function);
+    out += ",\"remote\":"; jsonStr(out, e.remote);
+    out += '}';
+  }
+  out += "]}";
+  return out;
+}
+
+std::string diagJson(const std::vector<DiagField> &d) {
+  std::string out = "{";
+  std::string section;
+  bool first = true;
+  for (const DiagField &f : d) {
+    if (section != f.section) {
+      if (!section.empty()) out += '}';
+      out += ",\"";
+      out += f.section;
+      out += "\":{";
+      section = f.section;
+      first = true;
+    }
+    if (!first) out += ',';
+    first = false;
+    out += '"'; out += f.key; out += "\":";
+    if (f.text.empty()) jsonNum(out, f.num);
+    else jsonStr(out, f.text);
+  }
+  if (!section.empty()) out += '}';
+  out += '}';
+  return out;
+}
+
+// ---- CBOR (stejné volání writeru jako handlery ve WebUI.h) ----
+
+void historyRow(CborWriter &w, const Event &e) {
+  w.beginArray(kFieldCount);
+  w.value(e.ms);
+  w.value(e.seq);
+  w.value(e.proto);
+  w.value(e.bits);
+  w.value(e.addr);
+  w.value(e.cmd);
+  w.value(e.value);
+  w.value(e.flags);
+  w.value(e.learnedId);
+  w.value(e.vendor);
+  w.value(e.function);
+  w.value(e.remote);
+}
+
+void historyHead(CborWriter &w, size_t n) {
+  w.beginMap();
+  w.field("only_unknown", false);
+  w.key("fields");
+  w.beginArray(kFieldCount);
+  for (const char *f : kFields) w.value(f);
+  w.key("history");
+  w.beginArray(n);
+}
+
+void historyCbor(CborWriter &w, const std::vector<Event> &h) {
+  historyHead(w, h.size());
+  for (const Event &e : h) historyRow(w, e);
+  w.end();
+}
+
+void diagCbor(CborWriter &w, const std::vector<DiagField> &d) {
+  std::string section;
+  w.beginMap();
+  for (const DiagField &f : d) {
+    if (section != f.section) {
+      if (!section.empty()) w.end();
+      w.key(f.section);
+      w.beginMap();
+      section = f.section;
+    }
+    if (f.text.empty()) w.field(f.key, f.num);
+    else w.field(f.key, f.text);
+  }
+  if (!section.empty()) w.end();
+  w.end();
+}
+
+std::vector<uint8_t> encode(void (*fn)(CborWriter &, const void *), const void *arg) {
+  std::vector<uint8_t> out;
+  {
+    CborWriter w([&](const uint8_t *d, size_t n) { out.insert(out.end(), d, d + n); });
+    fn(w, arg);
+  }
+  return out;
+}
+
+// ---- minimální dekodér (jen to, co writer vyrábí) ----
+
+struct Item {
+  enum Kind { UInt, NInt, Bytes, Text, Array, Map, Bool, Null } kind = Null;
+  uint64_t          num = 0;      // UInt: hodnota, NInt: -1 - num, Bool: 0/1
+  std::string       str;
+  std::vector<Item> items;        // Map: klíč, hodnota, klíč, hodnota…
+
+  int64_t integer() const { return kind == NInt ? -1 - static_cast<int64_t>(num) : static_cast<int64_t>(num); }
+  const Item *get(const std::string &k) const {
+    for (size_t i = 0; i + 1 < items.size(); i += 2)
+      if (items[i].str == k) return &items[i + 1];
+    return nullptr;
+  }
+};
+
+class Decoder {
+public:
+  Decoder(const uint8_t *p, size_t n) : _p(p), _n(n) {}
+  bool ok() const { return _ok && _pos == _n; }
+
+  Item item() {
+    Item it;
+    const uint8_t ib = byte();
+    const uint8_t major = ib >> 5, info = ib & 0x1F;
+    if (ib == 0xF4 || ib == 0xF5) { it.kind = Item::Bool; it.num = ib == 0xF5; return it; }
+    if (ib == 0xF6) return it;
+    const bool indef = info == 31;
+    const uint64_t len = indef ? 0 : arg(info);
+    switch (major) {
+      case 0: it.kind = Item::UInt; it.num = len; break;
+      case 1: it.kind = Item::NInt; it.num = len; break;
+      case 2:
+      case 3:
+        it.kind = major == 2 ? Item::Bytes : Item::Text;
+        if (indef || _pos + len > _n) { _ok = false; break; }
+        it.str.assign(reinterpret_cast<const char *>(_p + _pos), len);
+        _pos += len;
+        break;
+      case 4:
+      case 5: {
+        it.kind = major == 4 ? Item::Array : Item::Map;
+        const uint64_t count = major == 5 ? len * 2 : len;
+        if (indef) {
+          while (_ok && _pos < _n && _p[_pos] != 0xFF) it.items.push_back(item());
+          if (byte() != 0xFF) _ok = false;
+          if (major == 5 && it.items.size() % 2) _ok = false;
+        } else {
+          for (uint64_t i = 0; i < count && _ok; ++i) it.items.push_back(item());
+        }
+        break;
+      }
+      default: _ok = false;
+    }
+    return it;
+  }
+
+private:
+  const uint8_t *_p;
+  size_t _n, _pos = 0;
+  bool _ok = true;
+
+  uint8_t byte() {
+    if (_pos >= _n) { _ok = false; return 0xFF; }
+    return _p[_pos++];
+  }
+  uint64_t arg(uint8_t info) {
+    if (info < 24) return info;
+    if (info > 27) { _ok = false; return 0; }
+    uint64_t v = 0;
+    for (int i = 0; i < (1 << (info - 24)); ++i) v = (v << 8) | byte();
+    return v;
+  }
+};
+
+Item decode(const std::vector<uint8_t> &buf) {
+  Decoder d(buf.data(), buf.size());
+  Item it = d.item();
+  CHECK(d.ok());
+  return it;
+}
+
+// ---- round-trip ----
+
+void checkHistory(const Item &doc, const std::vector<Event> &h) {
+  CHECK(doc.kind == Item::Map);
+  const Item *fields = doc.get("fields");
+  const Item *rows = doc.get("history");
+  CHECK(fields && rows && doc.get("only_unknown") && doc.get("only_unknown")->kind == Item::Bool);
+  if (!fields || !rows) return;
+  CHECK_EQ(fields->items.size(), kFieldCount);
+  for (size_t i = 0; i < fields->items.size() && i < kFieldCount; ++i) CHECK(fields->items[i].str == kFields[i]);
+  CHECK_EQ(rows->items.size(), h.size());
+  for (size_t i = 0; i < rows->items.size() && i < h.size(); ++i) {
+    const std::vector<Item> &r = rows->items[i].items;
+    const Event &e = h[i];
+    CHECK_EQ(r.size(), kFieldCount);
+    if (r.size() != kFieldCount) return;
+    CHECK(r[0].integer() == e.ms && r[1].integer() == e.seq && r[2].str == e.proto);
+    CHECK(r[3].integer() == e.bits && r[4].integer() == e.addr && r[5].integer() == e.cmd);
+    CHECK(r[6].integer() == e.value && r[7].integer() == e.flags && r[8].integer() == e.learnedId);
+    CHECK(r[9].str == e.vendor && r[10].str == e.function && r[11].str == e.remote);
+  }
+}
+
+void checkDiag(const Item &doc, const std::vector<DiagField> &d) {
+  CHECK(doc.kind == Item::Map);
+  for (const DiagField &f : d) {
+    const Item *sec = *f.section ? doc.get(f.section) : &doc;
+    const Item *v = sec ? sec->get(f.key) : nullptr;
+    CHECK(v != nullptr);
+    if (!v) continue;
+    if (f.text.empty()) CHECK(v->kind == Item::UInt && v->num == f.num);
+    else CHECK(v->kind == Item::Text && v->str == f.text);
+  }
+}
+
+template <typename Fn>
+double usPerRun(int runs, Fn &&fn) {
+  const auto t = std::chrono::steady_clock::now();
+  for (int k = 0; k < runs; ++k) fn();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t).count() / runs;
+}
+
+void testRoundTripAndBench() {
+  const std::vector<Event> hist = makeHistory(100);
+  const std::vector<DiagField> diag = makeDiag();
+
+  const std::vector<uint8_t> hc = encode([](CborWriter &w, const void *a) {
+    historyCbor(w, *static_cast<const std::vector<Event> *>(a));
+  }, &hist);
+  const std::vector<uint8_t> dc = encode([](CborWriter &w, const void *a) {
+    diagCbor(w, *static_cast<const std::vector<DiagField> *>(a));
+  }, &diag);
+  const std::string hj = historyJson(hist), dj = diagJson(diag);
+  checkHistory(decode(hc), hist);
+  checkDiag(decode(dc), diag);
+
+  const int runs = 500;
+  volatile size_t sink = 0;
+  const double hjUs = usPerRun(runs, [&] { sink = sink + historyJson(hist).size(); });
+  const double hcUs = usPerRun(runs, [&] {
+    CborWriter w([&](const uint8_t *, size_t n) { sink = sink + n; });
+    historyCbor(w, hist);
+  });
+  const double djUs = usPerRun(runs, [&] { sink = sink + diagJson(diag).size(); });
+  const double dcUs = usPerRun(runs, [&] {
+    CborWriter w([&](const uint8_t *, size_t n) { sink = sink + n; });
+    diagCbor(w, diag);
+  });
+  printf("cbor history x100: json %zu B %.1f us | cbor %zu B %.1f us (%.0f %%)\n",
+         hj.size(), hjUs, hc.size(), hcUs, 100.0 * hc.size() / hj.size());
+  printf("cbor diag: json %zu B %.1f us | cbor %zu B %.1f us (%.0f %%)\n",
+         dj.size(), djUs, dc.size(), dcUs, 100.0 * dc.size() / dj.size());
+  CHECK(hc.size() * 2 < hj.size());
+  CHECK(dc.size() < dj.size());
+}
+
+// Výpis po kStep řádcích jako handlery ve WebUI.h, čtený po blocích jako HttpServer.
+std::vector<uint8_t> drainStream(const std::vector<Event> &h, size_t block, size_t &maxRead) {
+  static const size_t kStep = 16;
+  size_t row = 0;
+  bool started = false;
+  CborStream s([&](CborWriter &w) {
+    if (!started) {
+      historyHead(w, h.size());
+      started = true;
+    }
+    for (size_t n = 0; n < kStep && row < h.size(); ++n) historyRow(w, h[row++]);
+    if (row < h.size()) return true;
+    w.end();
+    return false;
+  });
+  std::vector<uint8_t> out, buf(block);
+  maxRead = 0;
+  for (;;) {
+    const size_t n = s.read(buf.data(), buf.size());
+    if (!n) break;
+    maxRead = std::max(maxRead, n);
+    out.insert(out.end(), buf.data(), buf.data() + n);
+  }
+  CHECK_EQ(s.read(buf.data(), buf.size()), 0);     // konec zůstává koncem
+  return out;
+}
+
+void testStream() {
+  const std::vector<Event> small = makeHistory(37);
+  const std::vector<uint8_t> direct = encode([](CborWriter &w, const void *a) {
+    historyCbor(w, *static_cast<const std::vector<Event> *>(a));
+  }, &small);
+  for (size_t block : { size_t(1), size_t(7), size_t(61), size_t(512), size_t(4096) }) {
+    size_t maxRead = 0;
+    CHECK(drainStream(small, block, maxRead) == direct);
+    CHECK(maxRead <= block);
+  }
+
+  // nad 32 KB (kMaxResponseBytes) – přes BodySource projde celé
+  const std::vector<Event> big = makeHistory(2000);
+  size_t maxRead = 0;
+  const std::vector<uint8_t> out = drainStream(big, 1024, maxRead);
+  CHECK(out.size() > 32768);
+  checkHistory(decode(out), big);
+
+  // prázdný výpis i krok bez výstupu
+  int calls = 0;
+  CborStream empty([&](CborWriter &w) {
+    if (++calls < 3) return true;                  // nic nezapsal, stream pokračuje
+    w.beginArray(0);
+    return false;
+  });
+  uint8_t b[8];
+  CHECK_EQ(empty.read(b, sizeof(b)), 1);
+  CHECK_EQ(b[0], 0x80);
+  CHECK_EQ(empty.read(b, sizeof(b)), 0);
+  CHECK_EQ(calls, 3);
+}
+
+}  // namespace
+
+int main() {
+  testRoundTripAndBench();
+  testStream();
+  return hostTestResult("cbor_bench_test");
+}
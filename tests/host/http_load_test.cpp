@@ -0,0 +1,171 @@
+// Zátěž http::Core: souběžní keep-alive klienti + klient, který data neodebírá.
+// Měří req/s a p99 latenci; handler nesmí čekat na pomalého klienta (dřív až 3 s).
+#include <arpa/inet.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HttpServer.h"
+#include "HostTest.h"
+
+namespace {
+
+constexpr uint16_t kPort = 28082;
+constexpr int      kClients = 4;
+constexpr uint32_t kRunMs = 2000;
+
+std::atomic<bool> g_stop(false);
+std::mutex g_latMutex;
+std::vector<uint32_t> g_latUs;
+
+// /big ~ hlavní stránka WebUI (18 KB), /stall těsně pod limitem, /huge přes limit, jinak malé JSON API.
+struct Handler : http::Core::Callbacks {
+  std::string big = std::string(18000, 'h');
+  std::string stall = std::string(30000, 's');
+  std::string small = "{\"ok\":true,\"requests\":12345}";
+  void onRequest(http::Connection &c, http::Request &r) override {
+    const std::string *body = &small;
+    std::string huge;
+    if (r.path == "/big") body = &big;
+    if (r.path == "/stall") body = &stall;
+    if (r.path == "/huge") {
+      huge.assign(http::kMaxResponseBytes + 1, 'x');
+      body = &huge;
+    }
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body->size()) + "\r\n\r\n";
+    c.write(head);
+    c.write(*body);
+  }
+};
+
+int connectLocal(int rcvBuf = 0) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (rcvBuf) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+  sockaddr_in a{};
+  a.sin_family = AF_INET;
+  a.sin_port = htons(kPort);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&a), sizeof(a)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+uint32_t nowUs() {
+  using namespace std::chrono;
+  return static_cast<uint32_t>(duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+// Jeden požadavek a celá odpověď; false = spojení skončilo.
+bool roundTrip(int fd, const char *path, std::string &in, std::string *head = nullptr) {
+  std::string req = std::string("GET ") + path + " HTTP/1.1\r\nHost: x\r\n\r\n";
+  if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) <= 0) return false;
+  char buf[8192];
+  for (;;) {
+    size_t he = in.find("\r\n\r\n");
+    if (he != std::string::npos) {
+      size_t cl = std::stoul(in.substr(in.find("Content-Length: ") + 16));
+      if (in.size() >= he + 4 + cl) {
+        if (head) head->assign(in, 0, he);
+        in.erase(0, he + 4 + cl);
+        return true;
+      }
+    }
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n <= 0) return false;
+    in.append(buf, static_cast<size_t>(n));
+  }
+}
+
+void client(int idx) {
+  std::vector<uint32_t> lat;
+  std::string in;
+  int fd = connectLocal();
+  uint32_t i = 0;
+  while (fd >= 0 && !g_stop) {
+    const uint32_t t0 = nowUs();
+    if (!roundTrip(fd, (++i + idx) % 4 ? "/api/diag" : "/big", in)) {
+      close(fd);
+      in.clear();
+      fd = connectLocal();
+      continue;
+    }
+    lat.push_back(nowUs() - t0);
+  }
+  if (fd >= 0) close(fd);
+  std::lock_guard<std::mutex> lock(g_latMutex);
+  g_latUs.insert(g_latUs.end(), lat.begin(), lat.end());
+}
+
+// Pošle řadu požadavků a nic nečte: zaplní socket buffery (na loopbacku i přes 1 MB),
+// pak zůstane plná fronta na serveru.
+int stalledClient() {
+  int fd = connectLocal(4096);
+  std::string reqs;
+  for (int i = 0; i < 99; ++i) reqs += "GET /stall HTTP/1.1\r\nHost: x\r\n\r\n";
+  send(fd, reqs.data(), reqs.size(), MSG_NOSIGNAL);
+  return fd;
+}
+
+}  // namespace
+
+int main() {
+  Handler handler;
+  http::Core core(kPort, handler);
+  if (!core.begin()) {
+    fprintf(stderr, "port %u obsazen\n", kPort);
+    return 1;
+  }
+  std::atomic<bool> serverRun(true);
+  uint32_t slowestPollUs = 0;
+  std::thread loop([&] {
+    while (serverRun) {
+      const uint32_t t0 = nowUs();
+      core.poll();
+      slowestPollUs = std::max(slowestPollUs, nowUs() - t0);
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  });
+
+  const int stalled = stalledClient();
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kClients; ++i) clients.emplace_back(client, i);
+  std::this_thread::sleep_for(std::chrono::milliseconds(kRunMs));
+  g_stop = true;
+  for (auto &t : clients) t.join();
+
+  // Odpověď nad kMaxResponseBytes: místo ní 500 a zavření spojení, server běží dál.
+  int fd = connectLocal();
+  std::string in, status;
+  CHECK(roundTrip(fd, "/huge", in, &status));
+  CHECK(status.compare(0, 12, "HTTP/1.1 500") == 0);
+  CHECK(status.find("Connection: close") != std::string::npos);
+  char tail;
+  CHECK_EQ(recv(fd, &tail, 1, 0), 0);   // čisté zavření, ne reset
+  close(fd);
+  fd = connectLocal();
+  in.clear();
+  CHECK(roundTrip(fd, "/api/diag", in));
+  close(fd);
+
+  serverRun = false;
+  loop.join();
+  close(stalled);
+  core.stop();
+
+  std::sort(g_latUs.begin(), g_latUs.end());
+  const size_t n = g_latUs.size();
+  const uint32_t p50 = n ? g_latUs[n / 2] : 0;
+  const uint32_t p99 = n ? g_latUs[std::min(n - 1, n * 99 / 100)] : 0;
+  printf("%zu req in %u ms = %.0f req/s, p50 %.2f ms, p99 %.2f ms, slowest poll %.2f ms, oversized %u\n",
+         n, kRunMs, n * 1000.0 / kRunMs, p50 / 1000.0, p99 / 1000.0, slowestPollUs / 1000.0, core.oversized());
+
+  CHECK(n > 1000);
+  CHECK(p99 < 100 * 1000);             // s blokujícím flush by pomalý klient držel všechny ~3 s
+  CHECK(slowestPollUs < 100 * 1000);
+  CHECK_EQ(core.oversized(), 1);
+  return hostTestResult("http_load_test");
+}
@@ -0,0 +1,222 @@
+// IrRxPipeline pod zátěží webu: task pipeline obsluhuje dva zdroje (sniffer, dekodér) a plní
+// frontu, loop() střídá obsluhu HTTP (http::Core, několik klientů bez pauzy) se service() a občas
+// vysílá v TxScope jako send z HTTP/MQTT. Ověřuje, že se při saturovaném HTTP žádný rámec
+// neztratí, pořadí zůstane zachované a zdroje nikdy neběží souběžně s vysíláním.
+#include <arpa/inet.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "HttpServer.h"
+#include "IrPipeline.h"
+#include "HostTest.h"
+
+namespace {
+
+constexpr uint16_t kPort = 28081;
+constexpr size_t   kQueueLen = 6;            // IR_FRAME_QUEUE_LEN
+constexpr size_t   kFramesPerService = 4;    // IR_FRAMES_PER_SERVICE
+constexpr uint32_t kFrameIntervalMs = 5;     // nejrychlejší ovladače opakují po ~40 ms
+constexpr uint32_t kFrames = 600;
+constexpr uint32_t kTxEveryLoops = 40;       // vysílání z loop() mezi obsluhou webu
+constexpr uint32_t kTxMs = 3;
+constexpr int      kClients = static_cast<int>(http::kMaxConnections);
+
+struct Frame {
+  bool     decoded;
+  uint32_t id;
+  uint16_t rawLen;
+  uint8_t  codes[1024];                      // RAW_ISR_CODE_BYTES – stejná velikost kopie jako IrFrame
+};
+
+std::atomic<bool> g_stop(false);
+std::atomic<uint32_t> g_responses(0);
+
+// Zdroje: rámce přichází po kFrameIntervalMs, sudé id ze snifferu, liché z dekodéru.
+std::atomic<uint32_t> g_nextId(0);
+uint32_t g_nextDueMs = 0;
+std::atomic<int> g_inSource(0);
+std::atomic<bool> g_transmitting(false);
+std::atomic<uint32_t> g_overlaps(0), g_suspends(0), g_resumes(0);
+
+IrRxPoll emit(Frame &work, bool decoded) {
+  g_inSource++;
+  if (g_transmitting) g_overlaps++;
+  IrRxPoll r = IrRxPoll::Idle;
+  const uint32_t id = g_nextId;
+  if (id < kFrames && (id % 2 == 1) == decoded && static_cast<int32_t>(http::nowMs() - g_nextDueMs) >= 0) {
+    work.decoded = decoded;
+    work.id = id;
+    work.rawLen = 200;
+    for (uint16_t k = 0; k < work.rawLen; ++k) work.codes[k] = static_cast<uint8_t>(id + k);
+    g_nextDueMs = http::nowMs() + kFrameIntervalMs;
+    g_nextId = id + 1;
+    r = IrRxPoll::Frame;
+  }
+  g_inSource--;
+  return r;
+}
+
+IrRxPoll sniffer(Frame &work) { return emit(work, false); }
+IrRxPoll decoder(Frame &work) { return emit(work, true); }
+
+uint32_t g_processed = 0, g_outOfOrder = 0, g_corrupt = 0, g_wrongSource = 0;
+
+void process(const Frame &f) {
+  if (f.id != g_processed + g_outOfOrder) g_outOfOrder++;
+  if (f.codes[f.rawLen - 1] != static_cast<uint8_t>(f.id + f.rawLen - 1)) g_corrupt++;
+  if (f.decoded != (f.id % 2 == 1)) g_wrongSource++;
+  g_processed++;
+}
+
+void radioSuspend() {
+  g_suspends++;
+  if (g_inSource) g_overlaps++;
+  g_transmitting = true;
+}
+
+void radioResume() {
+  g_transmitting = false;
+  g_resumes++;
+}
+
+typedef IrRxPipeline<Frame, kQueueLen, kFramesPerService> Pipeline;
+Pipeline g_pipeline(sniffer, decoder, process);
+
+// Odpověď velikosti stránky /api/learned (~6 KB).
+struct Handler : http::Core::Callbacks {
+  std::string body;
+  Handler() {
+    for (int i = 0; i < 60; ++i) body += "{\"id\":123,\"vendor\":\"Toshiba\",\"function\":\"power on\",\"v\":1},";
+  }
+  void onRequest(http::Connection &c, http::Request &) override {
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: ";
+    head += std::to_string(body.size());
+    head += "\r\n\r\n";
+    c.write(head);
+    c.write(body);
+  }
+};
+
+int connectLocal() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in a{};
+  a.sin_family = AF_INET;
+  a.sin_port = htons(kPort);
+  a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&a), sizeof(a)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// Keep-alive klient: požadavek, celá odpověď, hned další.
+void client() {
+  int fd = connectLocal();
+  std::string in;
+  char buf[4096];
+  while (fd >= 0 && !g_stop) {
+    const char req[] = "GET /api/learned HTTP/1.1\r\nHost: x\r\n\r\n";
+    if (send(fd, req, sizeof(req) - 1, MSG_NOSIGNAL) <= 0) break;
+    for (;;) {
+      size_t he = in.find("\r\n\r\n");
+      if (he != std::string::npos) {
+        size_t cl = std::stoul(in.substr(in.find("Content-Length: ") + 16));
+        if (in.size() >= he + 4 + cl) {
+          in.erase(0, he + 4 + cl);
+          g_responses++;
+          break;
+        }
+      }
+      ssize_t n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0) { close(fd); fd = -1; break; }
+      in.append(buf, static_cast<size_t>(n));
+    }
+    if (fd < 0) fd = connectLocal();   // server zavřel po kMaxRequestsPerConnection
+  }
+  if (fd >= 0) close(fd);
+}
+
+// Bez tasku (fallback) service() obslouží zdroje i spotřebitele v jednom volání.
+void testFallback() {
+  g_nextId = kFrames - 2;
+  g_nextDueMs = 0;
+  const uint32_t before = g_processed;
+  g_processed = kFrames - 2;
+  CHECK(!g_pipeline.taskRunning());
+  CHECK_EQ(g_pipeline.service(), 1);                 // sniffer: id kFrames-2
+  g_nextDueMs = 0;
+  CHECK_EQ(g_pipeline.service(), 1);                 // dekodér: id kFrames-1
+  CHECK_EQ(g_pipeline.service(), 0);
+  CHECK_EQ(g_processed, kFrames);
+  g_processed = before;
+}
+
+}  // namespace
+
+int main() {
+  Handler handler;
+  http::Core core(kPort, handler);
+  if (!core.begin()) {
+    fprintf(stderr, "port %u obsazen\n", kPort);
+    return 1;
+  }
+
+  std::vector<std::thread> clients;
+  for (int i = 0; i < kClients; ++i) clients.emplace_back(client);
+  g_pipeline.setRadioHooks(radioSuspend, radioResume);
+  CHECK(g_pipeline.startTask("ir-rx", 4096, 5));
+
+  uint32_t loops = 0, sends = 0;
+  const uint32_t start = http::nowMs();
+  const uint32_t deadline = start + kFrames * kFrameIntervalMs * 3;
+  while (g_processed < kFrames && http::nowMs() < deadline) {
+    core.poll();                                  // serviceClient()
+    g_pipeline.service();                         // irPipelineService()
+    if (++loops % kTxEveryLoops == 0) {           // irSendRawPulses() z handleru
+      Pipeline::TxScope tx(g_pipeline);
+      pipelineYield(kTxMs);
+      sends++;
+    }
+    pipelineYield(1);                             // delay(1) v serviceClient()
+  }
+  const uint32_t elapsed = http::nowMs() - start;
+
+  g_stop = true;
+  g_pipeline.stopTask();
+  for (int i = 0; i < 50; ++i) { core.poll(); pipelineYield(1); }   // dokončit rozpracované odpovědi
+  core.stop();
+  for (auto &t : clients) t.join();
+
+  const BoundedQueue<Frame, kQueueLen> &q = g_pipeline.queue();
+  printf("frames %u/%u dropped %u high_water %zu, %u sends, http %u req (%.0f req/s), %u loops in %u ms\n",
+         g_processed, kFrames, q.dropped(), q.highWater(), sends, g_responses.load(),
+         g_responses.load() * 1000.0 / (elapsed ? elapsed : 1), loops, elapsed);
+
+  CHECK_EQ(q.dropped(), 0);
+  CHECK_EQ(g_processed, kFrames);
+  CHECK_EQ(g_outOfOrder, 0);
+  CHECK_EQ(g_corrupt, 0);
+  CHECK_EQ(g_wrongSource, 0);
+  CHECK(q.highWater() < kQueueLen);
+  CHECK(g_responses.load() > kFrames);            // HTTP opravdu běželo naplno
+  CHECK(sends > 0);
+  CHECK_EQ(g_suspends.load(), sends);
+  CHECK_EQ(g_resumes.load(), sends);
+  CHECK_EQ(g_overlaps.load(), 0);                 // zdroj nikdy neběžel během vysílání
+  CHECK(!g_pipeline.taskRunning());
+
+  testFallback();
+
+  // tryPush(T&&): přesun místo kopie, při plné frontě se položka nesmí vyprázdnit.
+  BoundedQueue<std::string, 1> notify;
+  std::string line(200, 'x');
+  CHECK(notify.tryPush(std::move(line)));
+  std::string second(200, 'y');
+  CHECK(!notify.tryPush(std::move(second)));
+  CHECK_EQ(second.size(), 200);
+  std::string out;
+  CHECK(notify.tryPop(out) && out.size() == 200 && out[0] == 'x');
+  return hostTestResult("ir_pipeline_stress_test");
+}
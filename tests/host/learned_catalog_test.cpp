@@ -0,0 +1,148 @@
+// LearnedCatalog nad JSONL v RAM FS: vyhledání podle id / pořadí / klíče, stránky, append,
+// detekce migrace a strop indexu kMaxEntries.
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "LearnedCatalog.h"
+#include "HostTest.h"
+
+namespace {
+
+const char *kPath = "/learned.jsonl";
+
+struct Entry {
+  uint32_t id = 0;
+  uint32_t value = 0;
+  uint8_t  bits = 0;
+  uint32_t addr = 0;
+};
+
+bool field(const String &line, const char *key, uint32_t &out) {
+  const String k = String("\"") + key + "\":";
+  const int p = line.indexOf(k);
+  if (p < 0) return false;
+  out = strtoul(line.c_str() + p + k.length(), nullptr, 10);
+  return true;
+}
+
+bool parse(const String &line, Entry &e) {
+  uint32_t v = 0;
+  if (!field(line, "value", e.value) || !field(line, "addr", e.addr)) return false;
+  if (field(line, "bits", v)) e.bits = static_cast<uint8_t>(v);
+  if (field(line, "id", v)) e.id = v;
+  return true;
+}
+
+std::string line(uint32_t id, uint32_t value, uint32_t addr = 4) {
+  return "{\"id\":" + std::to_string(id) + ",\"value\":" + std::to_string(value) +
+         ",\"bits\":32,\"addr\":" + std::to_string(addr) + ",\"vendor\":\"v\"}\n";
+}
+
+void writeFile(const std::string &content) {
+  fs::memfs().files.clear();
+  File f = LittleFS.open(kPath, FILE_WRITE);
+  f.write(reinterpret_cast<const uint8_t *>(content.data()), content.size());
+  f.close();
+}
+
+void testLookups() {
+  std::string s = "{\"note\":\"není kód\"}\n";
+  for (uint32_t i = 1; i <= 100; ++i) s += line(i * 3, 1000 + i);   // id 3, 6, … 300
+  writeFile(s);
+
+  LearnedCatalog<Entry> cat(kPath, parse);
+  bool migrate = true;
+  CHECK(cat.build(migrate));
+  CHECK(!migrate);
+  CHECK_EQ(cat.count(), 100);
+  CHECK_EQ(cat.pageCount(), 4);
+  CHECK_EQ(cat.nextId(), 301);
+
+  Entry e;
+  CHECK(cat.getById(150, e) && e.value == 1050);
+  CHECK(!cat.getById(151, e));
+  CHECK(cat.getByOrdinal(0, e) && e.id == 3);
+  CHECK(cat.getByOrdinal(99, e) && e.id == 300);
+  CHECK(!cat.getByOrdinal(100, e));
+  CHECK_EQ(cat.ordinalForId(1), 0);
+  CHECK_EQ(cat.ordinalForId(97), 32);      // id 99 = první na druhé stránce
+  CHECK_EQ(cat.ordinalForId(301), 100);
+  CHECK(cat.findByKey(1077, 32, 4, e) && e.id == 231);
+  CHECK(!cat.findByKey(1077, 16, 4, e));
+  CHECK(cat.cachedPages() <= LearnedCatalog<Entry>::kPageCache);
+}
+
+void testAppend() {
+  writeFile(line(1, 10) + line(2, 20));
+  LearnedCatalog<Entry> cat(kPath, parse);
+  bool migrate = false;
+  cat.build(migrate);
+  Entry e;
+  CHECK(cat.getById(2, e));                // stránka 0 v cache
+
+  File f = LittleFS.open(kPath, FILE_APPEND);
+  const uint32_t offset = static_cast<uint32_t>(f.size());
+  const std::string l = line(7, 70);
+  f.write(reinterpret_cast<const uint8_t *>(l.data()), l.size());
+  f.close();
+  Entry added;
+  added.id = 7;
+  added.value = 70;
+  added.bits = 32;
+  added.addr = 4;
+  cat.noteAppended(added, offset);
+
+  CHECK_EQ(cat.count(), 3);
+  CHECK_EQ(cat.nextId(), 8);
+  CHECK(cat.getById(7, e) && e.value == 70);   // neúplná stránka se z cache zahodila
+  CHECK(cat.findByKey(70, 32, 4, e) && e.id == 7);
+}
+
+void testMigrationDetection() {
+  LearnedCatalog<Entry> cat(kPath, parse);
+  bool migrate = false;
+  writeFile(line(5, 1) + line(3, 2));              // id neroste
+  cat.build(migrate);
+  CHECK(migrate);
+  writeFile("{\"value\":1,\"addr\":2}\n");         // bez id
+  cat.build(migrate);
+  CHECK(migrate);
+  std::string glued = line(1, 1);
+  glued.pop_back();
+  writeFile(glued + line(2, 2));                   // slepené objekty "}{"
+  cat.build(migrate);
+  CHECK(migrate);
+}
+
+// Nad kMaxEntries se kódy nezaindexují, ale build() to ohlásí a jejich id zůstanou rezervovaná.
+void testIndexLimit() {
+  const uint32_t total = LearnedCatalog<Entry>::kMaxEntries + 5;
+  std::string s;
+  s.reserve(total * 48);
+  for (uint32_t i = 1; i <= total; ++i) s += line(i, i);
+  writeFile(s);
+
+  LearnedCatalog<Entry> cat(kPath, parse);
+  bool migrate = false;
+  CHECK(!cat.build(migrate));
+  CHECK(cat.full());
+  CHECK_EQ(cat.count(), LearnedCatalog<Entry>::kMaxEntries);
+  CHECK_EQ(cat.skipped(), 5);
+  CHECK_EQ(cat.nextId(), total + 1);
+  Entry e;
+  CHECK(cat.getById(LearnedCatalog<Entry>::kMaxEntries, e));
+  CHECK(!cat.getById(total, e));
+  CHECK(cat.indexBytes() < 5 * LearnedCatalog<Entry>::kMaxEntries);   // ~4 B na kód
+
+  cat.invalidate();
+  CHECK_EQ(cat.skipped(), 0);
+}
+
+}  // namespace
+
+int main() {
+  testLookups();
+  testAppend();
+  testMigrationDetection();
+  testIndexLimit();
+  return hostTestResult("learned_catalog_test");
+}
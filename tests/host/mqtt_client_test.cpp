@@ -0,0 +1,384 @@
+// mqtt::Client proti lokálnímu brokeru: minimální MQTT 3.1.1 broker ve vlastním vlákně
+// (jeden klient, QoS 0/1 směrem ke klientovi) zapisuje přijaté pakety do logu a test
+// ověřuje CONNECT (last will, přihlášení), SUBSCRIBE, PUBLISH oběma směry, keep-alive,
+// frontu během výpadku, obnovu odběrů po reconnectu, odmítnutí přihlášení, čisté stop()
+// a cache DNS (jméno brokeru se při reconnectu znovu nepřekládá).
+#include <arpa/inet.h>
+#include <poll.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "MqttClient.h"
+#include "HostTest.h"
+
+namespace {
+
+constexpr uint16_t kPort = 28083;
+
+class Broker {
+public:
+  std::atomic<uint8_t> connAckCode{0};      // 0 = přijmout, 5 = not authorized
+
+  bool start() {
+    _listen = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in a{};
+    a.sin_family = AF_INET;
+    a.sin_port = htons(kPort);
+    a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(_listen, reinterpret_cast<sockaddr *>(&a), sizeof(a)) != 0 || listen(_listen, 4) != 0) return false;
+    _thread = std::thread([this] { run(); });
+    return true;
+  }
+
+  void stop() {
+    _stop = true;
+    _thread.join();
+    if (_client >= 0) close(_client);
+    close(_listen);
+  }
+
+  std::vector<std::string> log() {
+    std::lock_guard<std::mutex> g(_mu);
+    return _log;
+  }
+
+  size_t count(const std::string &prefix) {
+    size_t n = 0;
+    for (const std::string &l : log()) n += l.compare(0, prefix.size(), prefix) == 0;
+    return n;
+  }
+
+  void clearLog() {
+    std::lock_guard<std::mutex> g(_mu);
+    _log.clear();
+  }
+
+  // PUBLISH ke klientovi; qos 1 nese packet id 0x1234.
+  void publish(const std::string &topic, const std::string &payload, uint8_t qos = 0) {
+    std::string body;
+    appendStr(body, topic);
+    if (qos) body.append("\x12\x34", 2);
+    body += payload;
+    std::lock_guard<std::mutex> g(_mu);
+    appendPacket(_out, static_cast<uint8_t>(0x30 | (qos << 1)), body);
+  }
+
+  // Spojení zavře bez DISCONNECT (výpadek sítě / restart brokeru).
+  void drop() { _drop = true; }
+
+private:
+  int _listen = -1;
+  int _client = -1;
+  std::thread _thread;
+  std::atomic<bool> _stop{false};
+  std::atomic<bool> _drop{false};
+  std::mutex _mu;
+  std::vector<std::string> _log;
+  std::string _in, _out;
+  std::string _will;
+
+  static void appendStr(std::string &s, const std::string &v) {
+    s += static_cast<char>(v.size() >> 8);
+    s += static_cast<char>(v.size() & 0xFF);
+    s += v;
+  }
+
+  static void appendPacket(std::string &out, uint8_t type, const std::string &body) {
+    out += static_cast<char>(type);
+    size_t len = body.size();
+    do {
+      uint8_t b = len & 0x7F;
+      len >>= 7;
+      if (len) b |= 0x80;
+      out += static_cast<char>(b);
+    } while (len);
+    out += body;
+  }
+
+  static std::string readStr(const std::string &b, size_t &p) {
+    if (p + 2 > b.size()) return std::string();
+    const size_t n = (static_cast<uint8_t>(b[p]) << 8) | static_cast<uint8_t>(b[p + 1]);
+    std::string s = b.substr(p + 2, n);
+    p += 2 + n;
+    return s;
+  }
+
+  void note(const std::string &line) {
+    std::lock_guard<std::mutex> g(_mu);
+    _log.push_back(line);
+  }
+
+  void closeClient(bool graceful) {
+    if (!graceful && !_will.empty()) note("WILL " + _will);
+    close(_client);
+    _client = -1;
+    _in.clear();
+    _will.clear();
+    std::lock_guard<std::mutex> g(_mu);
+    _out.clear();
+  }
+
+  void run() {
+    while (!_stop) {
+      pollfd p[2] = { { _listen, POLLIN, 0 }, { _client, POLLIN, 0 } };
+      poll(p, _client >= 0 ? 2 : 1, 5);
+      if (p[0].revents & POLLIN) {
+        int fd = accept(_listen, nullptr, nullptr);
+        if (_client >= 0) closeClient(false);
+        _client = fd;
+      }
+      if (_client < 0) continue;
+      if (_drop.exchange(false)) {
+        closeClient(false);
+        continue;
+      }
+      if (p[1].revents & (POLLIN | POLLHUP)) {
+        char buf[4096];
+        ssize_t n = recv(_client, buf, sizeof(buf), 0);
+        if (n <= 0) {
+          closeClient(false);
+          continue;
+        }
+        _in.append(buf, static_cast<size_t>(n));
+        if (!parse()) continue;
+      }
+      std::string out;
+      {
+        std::lock_guard<std::mutex> g(_mu);
+        out.swap(_out);
+      }
+      if (!out.empty()) send(_client, out.data(), out.size(), MSG_NOSIGNAL);
+    }
+  }
+
+  // false = spojení se zavřelo.
+  bool parse() {
+    while (_in.size() >= 2) {
+      size_t len = 0, pos = 1;
+      uint32_t mult = 1;
+      for (;;) {
+        if (pos >= _in.size()) return true;
+        const uint8_t b = static_cast<uint8_t>(_in[pos++]);
+        len += (b & 0x7F) * mult;
+        if (!(b & 0x80)) break;
+        mult <<= 7;
+      }
+      if (_in.size() < pos + len) return true;
+      const uint8_t header = static_cast<uint8_t>(_in[0]);
+      const std::string body = _in.substr(pos, len);
+      _in.erase(0, pos + len);
+      if (!handle(header, body)) return false;
+    }
+    return true;
+  }
+
+  bool handle(uint8_t header, const std::string &b) {
+    size_t p = 0;
+    switch (header >> 4) {
+      case 1: {                                          // CONNECT
+        const std::string proto = readStr(b, p);
+        const uint8_t level = static_cast<uint8_t>(b[p]);
+        const uint8_t flags = static_cast<uint8_t>(b[p + 1]);
+        const uint16_t keepAlive = (static_cast<uint8_t>(b[p + 2]) << 8) | static_cast<uint8_t>(b[p + 3]);
+        p += 4;
+        std::string line = "CONNECT " + proto + "/" + std::to_string(level) + " id=" + readStr(b, p) +
+                           " ka=" + std::to_string(keepAlive) + " clean=" + std::to_string((flags >> 1) & 1);
+        if (flags & 0x04) {
+          const std::string topic = readStr(b, p);
+          _will = topic + " " + readStr(b, p) + ((flags & 0x20) ? " r" : "");
+          line += " will=" + _will;
+        }
+        if (flags & 0x80) line += " user=" + readStr(b, p);
+        if (flags & 0x40) line += " pass=" + readStr(b, p);
+        note(line);
+        const uint8_t rc = connAckCode;
+        const char ack[4] = { 0x20, 0x02, 0x00, static_cast<char>(rc) };
+        send(_client, ack, sizeof(ack), MSG_NOSIGNAL);
+        if (rc) {
+          _will.clear();
+          closeClient(true);
+          return false;
+        }
+        return true;
+      }
+      case 3: {                                          // PUBLISH (klient posílá jen QoS 0)
+        const std::string topic = readStr(b, p);
+        note("PUB " + topic + " " + b.substr(p) + ((header & 0x01) ? " r" : "") +
+             ((header & 0x06) ? " qos>0" : ""));
+        return true;
+      }
+      case 4:                                            // PUBACK
+        note("PUBACK " + std::to_string((static_cast<uint8_t>(b[0]) << 8) | static_cast<uint8_t>(b[1])));
+        return true;
+      case 8: {                                          // SUBSCRIBE
+        std::string ack;
+        ack.append(b, 0, 2);
+        p = 2;
+        while (p < b.size()) {
+          const std::string filter = readStr(b, p);
+          note("SUB " + filter + " qos=" + std::to_string(static_cast<uint8_t>(b[p++])));
+          ack += '\x00';
+        }
+        std::lock_guard<std::mutex> g(_mu);
+        appendPacket(_out, 0x90, ack);
+        return true;
+      }
+      case 12: {                                         // PINGREQ
+        note("PING");
+        std::lock_guard<std::mutex> g(_mu);
+        _out.append("\xD0\x00", 2);
+        return true;
+      }
+      case 14:                                           // DISCONNECT: last will se nepošle
+        note("DISCONNECT");
+        _will.clear();
+        closeClient(true);
+        return false;
+      default:
+        note("? " + std::to_string(header));
+        return true;
+    }
+  }
+};
+
+template <typename Pred>
+bool pollUntil(mqtt::Client &c, Pred done, uint32_t timeoutMs) {
+  const uint32_t start = mqtt::nowMs();
+  while (!done()) {
+    if (mqtt::nowMs() - start > timeoutMs) return false;
+    c.poll();
+    usleep(1000);                                        // jako delay(1) v loop()
+  }
+  return true;
+}
+
+bool has(Broker &b, const std::string &line) {
+  for (const std::string &l : b.log()) if (l == line) return true;
+  return false;
+}
+
+}  // namespace
+
+int main() {
+  Broker broker;
+  if (!broker.start()) {
+    fprintf(stderr, "port %u obsazený\n", kPort);
+    return 1;
+  }
+
+  mqtt::Client client;
+  std::vector<std::pair<std::string, std::string>> rx;
+  client.onMessage([&](const std::string &t, const std::string &p) { rx.emplace_back(t, p); });
+
+  mqtt::Config cfg;
+  cfg.host = "127.0.0.1";
+  cfg.port = kPort;
+  cfg.clientId = "irbridge-test";
+  cfg.user = "ir";
+  cfg.pass = "secret";
+  cfg.statusTopic = "ir/status";
+  cfg.keepAliveS = 1;
+  client.begin(cfg);
+  client.subscribe("ir/cmd/#");
+
+  // 1) CONNECT s last will a přihlášením, po CONNACK odběr a retain "online"
+  CHECK(pollUntil(client, [&] { return client.connected() && broker.count("SUB ") == 1 &&
+                                       broker.count("PUB ir/status") == 1; }, 2000));
+  CHECK(has(broker, "CONNECT MQTT/4 id=irbridge-test ka=1 clean=1 will=ir/status offline r user=ir pass=secret"));
+  CHECK(has(broker, "SUB ir/cmd/# qos=0"));
+  CHECK(has(broker, "PUB ir/status online r"));
+  CHECK_EQ(client.connects(), 1);
+
+  // 2) zprávy od brokeru (QoS 0 i QoS 1 s PUBACK)
+  broker.publish("ir/cmd/send", "{\"id\":7}");
+  broker.publish("ir/cmd/ac", "{\"temp\":22}", 1);
+  CHECK(pollUntil(client, [&] { return rx.size() == 2 && broker.count("PUBACK") == 1; }, 2000));
+  CHECK(rx.size() == 2 && rx[0].first == "ir/cmd/send" && rx[0].second == "{\"id\":7}");
+  CHECK(rx.size() == 2 && rx[1].first == "ir/cmd/ac" && rx[1].second == "{\"temp\":22}");
+  CHECK(has(broker, "PUBACK 4660"));
+  CHECK_EQ(client.received(), 2);
+
+  // 3) publish: pořadí a retain příznak
+  broker.clearLog();
+  for (int i = 0; i < 100; ++i) CHECK(client.publish("ir/event", std::to_string(i)));
+  CHECK(client.publish("ir/state", "on", true));
+  CHECK(pollUntil(client, [&] { return broker.count("PUB ") == 101; }, 2000));
+  std::vector<std::string> log = broker.log();
+  size_t k = 0;
+  for (const std::string &l : log) {
+    if (l.compare(0, 4, "PUB ") != 0) continue;
+    CHECK(k == 100 ? l == "PUB ir/state on r" : l == "PUB ir/event " + std::to_string(k));
+    k++;
+  }
+  CHECK(broker.count("PUB ir/event") == 100);
+
+  // 4) keep-alive: při nečinnosti PINGREQ po polovině intervalu, spojení drží
+  broker.clearLog();
+  CHECK(pollUntil(client, [&] { return broker.count("PING") >= 2; }, 3000));
+  CHECK(client.connected());
+
+  // 5) výpadek: broker pošle last will, zprávy čekají ve frontě (retain se slučují),
+  //    po reconnectu se obnoví odběr, "online" a fronta se odešle ve stejném pořadí
+  broker.clearLog();
+  broker.drop();
+  CHECK(pollUntil(client, [&] { return !client.connected(); }, 2000));
+  CHECK(has(broker, "WILL ir/status offline r"));
+  CHECK(std::string(client.lastError()) == "closed by broker");
+  client.publish("ir/event", "a");
+  client.publish("ir/state", "off", true);
+  client.publish("ir/event", "b");
+  client.publish("ir/state", "on", true);
+  CHECK_EQ(client.queued(), 3);
+  CHECK(pollUntil(client, [&] { return client.connected() && broker.count("PUB ") == 4; }, 3000));
+  CHECK_EQ(client.connects(), 2);
+  CHECK_EQ(client.queued(), 0);
+  std::vector<std::string> pubs;
+  for (const std::string &l : broker.log()) {
+    if (l.compare(0, 4, "PUB ") == 0 || l.compare(0, 4, "SUB ") == 0) pubs.push_back(l);
+  }
+  CHECK(pubs.size() == 5 && pubs[0] == "SUB ir/cmd/# qos=0" && pubs[1] == "PUB ir/status online r" &&
+        pubs[2] == "PUB ir/event a" && pubs[3] == "PUB ir/state on r" && pubs[4] == "PUB ir/event b");
+  broker.publish("ir/cmd/send", "after");
+  CHECK(pollUntil(client, [&] { return rx.size() == 3; }, 2000));
+
+  // 6) stop(): "offline" a DISCONNECT, broker last will nepošle
+  broker.clearLog();
+  client.stop();
+  usleep(100 * 1000);
+  CHECK(has(broker, "PUB ir/status offline r"));
+  CHECK(has(broker, "DISCONNECT"));
+  CHECK(broker.count("WILL") == 0);
+  CHECK(!client.publish("ir/event", "x"));
+
+  // 7) odmítnuté přihlášení: chyba, odstup a další pokus bez zahlcení brokeru
+  broker.clearLog();
+  broker.connAckCode = 5;
+  client.begin(cfg);
+  CHECK(pollUntil(client, [&] { return std::string(client.lastError()) == "not authorized"; }, 2000));
+  CHECK(!client.connected());
+  CHECK_EQ(client.backoffMs(), mqtt::kReconnectMinMs * 2);
+  pollUntil(client, [] { return false; }, 500);
+  CHECK_EQ(broker.count("CONNECT"), 1);
+  broker.connAckCode = 0;
+  CHECK(pollUntil(client, [&] { return client.connected(); }, 3000));
+  CHECK_EQ(client.backoffMs(), mqtt::kReconnectMinMs);
+
+  // 8) broker jako jméno: DNS jen při prvním spojení, reconnect použije adresu z cache
+  client.stop();
+  cfg.host = "localhost";
+  client.begin(cfg);
+  CHECK(pollUntil(client, [&] { return client.connected(); }, 3000));
+  CHECK_EQ(client.dnsLookups(), 1);
+  broker.drop();
+  CHECK(pollUntil(client, [&] { return !client.connected(); }, 2000));
+  CHECK(pollUntil(client, [&] { return client.connected(); }, 3000));
+  CHECK_EQ(client.dnsLookups(), 1);
+
+  client.stop();
+  broker.stop();
+  return hostTestResult("mqtt_client_test");
+}
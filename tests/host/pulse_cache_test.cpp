@@ -0,0 +1,114 @@
+// PulseBufferCache: počty hit/miss, pořadí LRU, rozpočet bajtů, negativní položky (kód bez RAW),
+// buffer větší než rozpočet a zneplatnění jednoho kódu i celé cache.
+#include <vector>
+#include "PulseCache.h"
+#include "HostTest.h"
+
+namespace {
+
+typedef PulseBufferCache Cache;
+
+std::vector<uint16_t> pulses(size_t n, uint16_t v) { return std::vector<uint16_t>(n, v); }
+
+void testHitMiss() {
+  Cache c;
+  CHECK(c.get(1) == nullptr);
+  const std::vector<uint16_t> p = pulses(68, 560);
+  const Cache::Entry *e = c.put(1, 38, p.data(), p.size());
+  CHECK(e && e->key == 1 && e->khz == 38 && e->pulses == p);
+  e = c.get(1);
+  CHECK(e && e->pulses.size() == 68);
+  CHECK(c.get(2) == nullptr);
+  CHECK_EQ(c.hits(), 1);
+  CHECK_EQ(c.misses(), 2);
+  CHECK_EQ(c.bytes(), 68 * sizeof(uint16_t));
+
+  // negativní položka: kód bez RAW je hit s prázdnými pulzy, nic nestojí
+  CHECK(c.put(2, 38, nullptr, 0) != nullptr);
+  e = c.get(2);
+  CHECK(e && e->pulses.empty());
+  CHECK_EQ(c.bytes(), 68 * sizeof(uint16_t));
+
+  // nahrazení stejného klíče neduplikuje
+  const std::vector<uint16_t> q = pulses(10, 600);
+  c.put(1, 36, q.data(), q.size());
+  CHECK_EQ(c.entries(), 2);
+  CHECK_EQ(c.bytes(), 10 * sizeof(uint16_t));
+  e = c.get(1);
+  CHECK(e && e->khz == 36 && e->pulses == q);
+}
+
+void testLruByCount() {
+  Cache c;
+  const std::vector<uint16_t> p = pulses(4, 500);
+  for (int32_t k = 0; k < static_cast<int32_t>(Cache::kMaxEntries); ++k) c.put(k, 38, p.data(), p.size());
+  CHECK_EQ(c.entries(), Cache::kMaxEntries);
+  CHECK(c.get(0) != nullptr);                          // 0 je teď nejnověji použitý
+  c.put(100, 38, p.data(), p.size());                  // vyhodí nejdéle nepoužitý = 1
+  CHECK_EQ(c.entries(), Cache::kMaxEntries);
+  CHECK_EQ(c.evictions(), 1);
+  CHECK(c.get(1) == nullptr);
+  CHECK(c.get(0) != nullptr);
+  CHECK(c.get(100) != nullptr);
+  c.put(101, 38, p.data(), p.size());                  // další nejstarší = 2
+  CHECK(c.get(2) == nullptr);
+  CHECK(c.get(3) != nullptr);
+}
+
+void testByteBudget() {
+  Cache c;
+  const size_t quarter = Cache::kMaxBytes / sizeof(uint16_t) / 4;
+  const std::vector<uint16_t> p = pulses(quarter, 700);
+  for (int32_t k = 1; k <= 4; ++k) c.put(k, 38, p.data(), p.size());
+  CHECK_EQ(c.bytes(), Cache::kMaxBytes);
+  CHECK(c.get(1) && c.get(2) && c.get(3));            // 4 zůstává nejstarší
+  const std::vector<uint16_t> half = pulses(quarter * 2, 800);
+  c.put(5, 38, half.data(), half.size());              // uvolní 4, pak 1
+  CHECK(c.bytes() <= Cache::kMaxBytes);
+  CHECK_EQ(c.evictions(), 2);
+  CHECK(c.get(4) == nullptr);
+  CHECK(c.get(1) == nullptr);
+  CHECK(c.get(5) && c.get(2) && c.get(3));
+
+  // větší než celý rozpočet: necachuje se, obsah cache zůstane
+  const std::vector<uint16_t> huge = pulses(Cache::kMaxBytes / sizeof(uint16_t) + 1, 900);
+  CHECK(c.put(6, 38, huge.data(), huge.size()) == nullptr);
+  CHECK_EQ(c.entries(), 3);
+  CHECK(c.get(6) == nullptr);
+  // ... ale starou verzi stejného klíče zahodí (nesmí se poslat zastaralý RAW)
+  CHECK(c.put(5, 38, huge.data(), huge.size()) == nullptr);
+  CHECK(c.get(5) == nullptr);
+  CHECK_EQ(c.bytes(), 2 * quarter * sizeof(uint16_t));
+}
+
+void testInvalidate() {
+  Cache c;
+  const std::vector<uint16_t> a = pulses(8, 1), b = pulses(16, 2), d = pulses(32, 3);
+  c.put(1, 38, a.data(), a.size());
+  c.put(2, 38, b.data(), b.size());
+  c.put(3, 38, d.data(), d.size());
+  c.invalidate(1);                                     // poslední položka se přesune na místo 1
+  CHECK_EQ(c.entries(), 2);
+  CHECK_EQ(c.bytes(), (16 + 32) * sizeof(uint16_t));
+  CHECK(c.get(1) == nullptr);
+  const Cache::Entry *e = c.get(3);
+  CHECK(e && e->pulses == d);
+  e = c.get(2);
+  CHECK(e && e->pulses == b);
+  c.invalidate(42);                                    // neznámý klíč nic nemění
+  CHECK_EQ(c.entries(), 2);
+  c.clear();
+  CHECK_EQ(c.entries(), 0);
+  CHECK_EQ(c.bytes(), 0);
+  CHECK(c.get(2) == nullptr);
+}
+
+}  // namespace
+
+int main() {
+  testHitMiss();
+  testLruByCount();
+  testByteBudget();
+  testInvalidate();
+  return hostTestResult("pulse_cache_test");
+}
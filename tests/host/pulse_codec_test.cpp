@@ -0,0 +1,123 @@
+// PulseCodec: zápis a čtení délek pulzů v ISR bufferu snifferu. Ověřuje chybu kvantizace
+// v celém 1B rozsahu, escape (přesné dlouhé mezery, saturace), úsporu místa a průchod
+// typických rámců (NEC, Sony, RC5, Toshiba AC, Daikin s dlouhou mezerou) kódováním a zpět.
+#include <math.h>
+#include <vector>
+#include "PulseCodec.h"
+#include "HostTest.h"
+
+namespace {
+
+void addBits(std::vector<uint32_t> &v, uint64_t bits, int n, uint32_t mark, uint32_t zero, uint32_t one) {
+  for (int i = 0; i < n; ++i) {
+    v.push_back(mark);
+    v.push_back((bits >> i) & 1 ? one : zero);
+  }
+}
+
+void testQuantization() {
+  double worst = 0;
+  for (uint32_t us = 0; us < RAW_CODE_ESCAPE_US; ++us) {
+    const uint8_t code = isrEncodePulse(us);
+    CHECK(code != RAW_CODE_ESCAPE);
+    const uint16_t back = decodePulseCode(code);
+    if (us < 32) {
+      CHECK_EQ(back, us);
+      continue;
+    }
+    worst = std::max(worst, fabs(static_cast<double>(back) - us) / us);
+  }
+  printf("pulse codec: max chyba kvantizace %.3f %%\n", worst * 100);
+  CHECK(worst <= 0.0304);
+
+  // kódy jsou monotónní – žádné dva pulzy se „nepřehodí“
+  for (uint32_t us = 1; us < RAW_CODE_ESCAPE_US; ++us) CHECK(isrEncodePulse(us) >= isrEncodePulse(us - 1));
+  CHECK(isrEncodePulse(RAW_CODE_ESCAPE_US - 1) < RAW_CODE_ESCAPE);
+}
+
+void testEscape() {
+  volatile uint8_t buf[16];
+  uint16_t pos = 0;
+  CHECK_EQ(pulseCodeBytes(RAW_CODE_ESCAPE_US - 1), 1);
+  CHECK_EQ(pulseCodeBytes(RAW_CODE_ESCAPE_US), 3);
+  pulseCodeWrite(buf, pos, 560);
+  pulseCodeWrite(buf, pos, 29428);           // Daikin mezera mezi rámci – přesně
+  pulseCodeWrite(buf, pos, 100000);          // saturace
+  pulseCodeWrite(buf, pos, RAW_CODE_ESCAPE_US);
+  CHECK_EQ(pos, 10);
+
+  uint16_t rd = 0;
+  const uint16_t first = pulseCodeRead(buf, rd);
+  CHECK(first >= 543 && first <= 577);
+  CHECK_EQ(pulseCodeRead(buf, rd), 29428);
+  CHECK_EQ(pulseCodeRead(buf, rd), 0xFFFF);
+  CHECK_EQ(pulseCodeRead(buf, rd), RAW_CODE_ESCAPE_US);
+  CHECK_EQ(rd, pos);
+}
+
+// Celý rámec zapsaný jako v ISR a přečtený jako v přijímacím tasku.
+void roundTrip(const char *name, const std::vector<uint32_t> &pulses, size_t expectBytes) {
+  std::vector<uint8_t> buf(pulses.size() * 3);
+  uint16_t pos = 0;
+  for (uint32_t us : pulses) pulseCodeWrite(buf.data(), pos, us);
+  CHECK_EQ(pos, expectBytes);
+
+  uint16_t rd = 0;
+  double worst = 0;
+  for (uint32_t us : pulses) {
+    const uint16_t back = pulseCodeRead(buf.data(), rd);
+    worst = std::max(worst, fabs(static_cast<double>(back) - us) / us);
+  }
+  CHECK_EQ(rd, pos);
+  if (worst > 0.0304) fprintf(stderr, "%s: chyba %.2f %%\n", name, worst * 100);
+  CHECK(worst <= 0.0304);
+}
+
+void testCorpus() {
+  std::vector<uint32_t> nec = { 9000, 4500 };
+  addBits(nec, 0x20DF10EF, 32, 560, 560, 1690);
+  nec.push_back(560);
+  roundTrip("NEC", nec, nec.size());        // 68 B místo 136 B (uint16_t)
+
+  std::vector<uint32_t> sony = { 2400 };
+  for (int i = 0; i < 12; ++i) {
+    sony.push_back(600);
+    sony.push_back((0x95A >> i) & 1 ? 1200 : 600);
+  }
+  roundTrip("Sony12", sony, sony.size());
+
+  const std::vector<uint32_t> rc5 = { 889, 889, 1778, 889, 889, 1778, 1778, 889, 889, 889, 889,
+                                      1778, 889, 889, 889, 889, 1778, 1778, 889, 889, 889 };
+  roundTrip("RC5", rc5, rc5.size());
+
+  std::vector<uint32_t> toshiba;
+  for (int r = 0; r < 2; ++r) {
+    toshiba.push_back(4400);
+    toshiba.push_back(4300);
+    addBits(toshiba, 0xF20D03FC01ULL, 40, 543, 543, 1623);
+    addBits(toshiba, 0x21, 32, 543, 543, 1623);
+    toshiba.push_back(543);
+    toshiba.push_back(7048);
+  }
+  toshiba.pop_back();
+  roundTrip("Toshiba-AC", toshiba, toshiba.size());
+
+  std::vector<uint32_t> daikin = { 3650, 1623 };
+  addBits(daikin, 0x11DA2700ULL, 64, 428, 428, 1280);
+  daikin.push_back(428);
+  daikin.push_back(29428);                   // jediný escape
+  daikin.push_back(3650);
+  daikin.push_back(1623);
+  addBits(daikin, 0x11DA2700C5ULL, 64, 428, 428, 1280);
+  daikin.push_back(428);
+  roundTrip("Daikin", daikin, daikin.size() + 2);
+}
+
+}  // namespace
+
+int main() {
+  testQuantization();
+  testEscape();
+  testCorpus();
+  return hostTestResult("pulse_codec_test");
+}
@@ -0,0 +1,126 @@
+// RawConsensus: konsenzus z několika zachycení NEC rámce s jitterem přijímače. Ověřuje vyřazení
+// přehozeného bitu a repeat kódu, volbu nejčetnější délky, odmítnutí nesouhlasných zachycení
+// a hlavně přesnost: chyba výsledku vůči skutečnému kódu je několikanásobně menší než u jednoho zachycení.
+#include <math.h>
+#include <random>
+#include "RawConsensus.h"
+#include "HostTest.h"
+
+namespace {
+
+constexpr int kMarkBias = 60;                // přijímač prodlužuje marky a zkracuje mezery
+
+std::mt19937 g_rng(1);
+
+std::vector<uint16_t> nec(uint32_t value) {
+  std::vector<uint16_t> r = { 9000, 4500 };
+  for (int i = 0; i < 32; ++i) {
+    r.push_back(560);
+    r.push_back((value >> i) & 1 ? 1690 : 560);
+  }
+  r.push_back(560);
+  r.push_back(40000);
+  return r;
+}
+
+// Jedno zachycení: systematický posun marků/mezer + relativní gaussovský šum, náhodná koncová mezera.
+std::vector<uint16_t> capture(const std::vector<uint16_t> &ideal, double sd) {
+  std::normal_distribution<double> noise(0, sd);
+  std::vector<uint16_t> r = ideal;
+  for (size_t i = 0; i + 1 < r.size(); ++i) {
+    const double bias = (i % 2 == 0) ? kMarkBias : -kMarkBias;
+    r[i] = static_cast<uint16_t>(std::max(50.0, r[i] + bias + noise(g_rng) * r[i]));
+  }
+  r.back() = static_cast<uint16_t>(20000 + g_rng() % 30000);
+  return r;
+}
+
+// Průměrná relativní chyba vůči tomu, co vysílač skutečně poslal (včetně posunu přijímače).
+double relError(const std::vector<uint16_t> &raw, const std::vector<uint16_t> &ideal) {
+  double sum = 0;
+  for (size_t i = 0; i + 1 < ideal.size(); ++i) {
+    const double ref = ideal[i] + ((i % 2 == 0) ? kMarkBias : -kMarkBias);
+    sum += fabs(raw[i] - ref) / ref;
+  }
+  return sum / (ideal.size() - 1);
+}
+
+void testOutliers() {
+  const std::vector<uint16_t> ideal = nec(0x20DF10EF);
+  RawConsensus c;
+  c.reset(6);
+  for (int k = 0; k < 4; ++k) {
+    const std::vector<uint16_t> x = capture(ideal, 0.02);
+    CHECK(c.add(x.data(), x.size()));
+  }
+  const std::vector<uint16_t> flipped = capture(nec(0x20DF10EE), 0.02);   // jiný bit 0
+  CHECK(c.add(flipped.data(), flipped.size()));
+  const uint16_t repeat[] = { 9000, 2250, 560, 40000 };                  // NEC repeat – příliš krátký
+  CHECK(!c.add(repeat, 4));
+  CHECK_EQ(c.ignored(), 1);
+  const std::vector<uint16_t> shorter(ideal.begin(), ideal.end() - 4);   // useknutý rámec = jiná délka
+  CHECK(c.add(shorter.data(), shorter.size()));
+  CHECK(c.complete());
+
+  const RawConsensus::Result r = c.compute();
+  CHECK(r.ok);
+  CHECK_EQ(r.used, 4);
+  CHECK_EQ(r.rejected, 2);
+  CHECK_EQ(r.raw.size(), ideal.size());
+  CHECK_EQ(r.clusters, 5);                   // marky 9000/560, mezery 4500/1690/560
+  CHECK(r.quality > 50);
+  CHECK(relError(r.raw, ideal) < 0.01);
+  for (size_t i = 2; i + 1 < ideal.size(); i += 2) CHECK_EQ(r.raw[i], r.raw[2]);   // přichycené marky
+}
+
+void testDisagree() {
+  RawConsensus c;
+  c.reset(3);
+  for (uint32_t v : { 0x1u, 0x2u, 0x4u }) {
+    const std::vector<uint16_t> x = nec(v * 0x01010101u);
+    c.add(x.data(), x.size());
+  }
+  const RawConsensus::Result r = c.compute();
+  CHECK(!r.ok);
+  CHECK(r.err && std::string(r.err) == "captures disagree");
+
+  RawConsensus one;
+  one.reset(1);                              // cíl se zarovná na 2..kMaxCaptures
+  CHECK_EQ(one.target(), 2);
+  const std::vector<uint16_t> x = nec(1);
+  one.add(x.data(), x.size());
+  CHECK(!one.compute().ok);
+}
+
+// Chyba konsenzu z 5 zachycení proti chybě jednoho zachycení při 2% jitteru (průměr z 50 pokusů;
+// vychází ~7× menší, většinu zbytku tvoří hlavička, kterou shluky nepokryjí).
+void testAccuracy() {
+  const std::vector<uint16_t> ideal = nec(0x20DF10EF);
+  const int trials = 50;
+  double cons = 0, single = 0;
+  for (int t = 0; t < trials; ++t) {
+    RawConsensus c;
+    c.reset(5);
+    for (int k = 0; k < 5; ++k) {
+      const std::vector<uint16_t> x = capture(ideal, 0.02);
+      c.add(x.data(), x.size());
+    }
+    const RawConsensus::Result r = c.compute();
+    CHECK(r.ok);
+    if (r.ok) cons += relError(r.raw, ideal);
+    single += relError(capture(ideal, 0.02), ideal);
+  }
+  cons /= trials;
+  single /= trials;
+  printf("raw consensus: chyba 1 zachycení %.4f, konsenzus z 5 %.4f (%.0fx)\n", single, cons, single / cons);
+  CHECK(cons * 5 < single);
+}
+
+}  // namespace
+
+int main() {
+  testOutliers();
+  testDisagree();
+  testAccuracy();
+  return hostTestResult("raw_consensus_test");
+}
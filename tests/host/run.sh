@@ -0,0 +1,21 @@
+#!/bin/sh
+# Hostové testy portabilních hlaviček (bez ESP32 toolchainu).
+#   tests/host/run.sh                 všechny *_test.cpp
+#   tests/host/run.sh event_log_test  jen vybrané
+# Arduino/LittleFS/NVS nahrazují stubs/ (RAM), binárky jdou do $OUT.
+set -e
+cd "$(dirname "$0")"
+OUT=${OUT:-${TMPDIR:-/tmp}/irbridge-host-tests}
+CXX=${CXX:-g++}
+mkdir -p "$OUT"
+
+tests=$*
+[ -n "$tests" ] || tests=$(ls *_test.cpp | sed 's/\.cpp$//')
+
+failed=0
+for t in $tests; do
+  $CXX -std=gnu++17 -O1 -g -Wall -Wno-unused-function -Istubs -I../.. \
+    "$t.cpp" stubs/stubs.cpp -o "$OUT/$t" -lpthread
+  "$OUT/$t" || failed=$((failed + 1))
+done
+[ "$failed" -eq 0 ] || { echo "$failed test(ů) selhalo"; exit 1; }
@@ -0,0 +1,127 @@
+#pragma once
+// Hostová náhrada Arduino core pro testy v tests/host (String, millis(), Serial …).
+// millis()/micros() řídí test přes g_fakeMillis/g_fakeMicros.
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string>
+#include <algorithm>
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define PSTR(s) (s)
+#define IRAM_ATTR
+#define HEX 16
+#define DEC 10
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define CHANGE 3
+#define digitalPinToInterrupt(p) (p)
+template<class T, class L, class H> auto constrain(T a, L l, H h) -> T { return a < l ? l : (a > h ? h : a); }
+inline bool isDigit(char c){return isdigit((unsigned char)c);}
+extern uint32_t g_fakeMillis; extern uint32_t g_fakeMicros;
+uint32_t millis(); uint32_t micros(); void delay(uint32_t); void yield();
+int digitalRead(uint8_t); void digitalWrite(uint8_t,uint8_t); void pinMode(uint8_t,uint8_t);
+void attachInterrupt(uint8_t, void(*)(), int); void noInterrupts(); void interrupts();
+class String {
+ public:
+  std::string s;
+  String() {}
+  String(const char* c) : s(c ? c : "") {}
+  String(const std::string& c) : s(c) {}
+  String(const __FlashStringHelper* c) : s(reinterpret_cast<const char*>(c)) {}
+  String(char c) : s(1, c) {}
+  String(int v, int base = 10) { char b[40]; snprintf(b, 40, base==16?"%x":"%d", v); s=b; }
+  String(unsigned v, int base = 10) { char b[40]; snprintf(b, 40, base==16?"%x":"%u", v); s=b; }
+  String(long v, int base = 10) { char b[40]; snprintf(b, 40, base==16?"%lx":"%ld", v); s=b; }
+  String(unsigned long v, int base = 10) { char b[40]; snprintf(b, 40, base==16?"%lx":"%lu", v); s=b; }
+  String(unsigned char v, int base = 10) : String((unsigned)v, base) {}
+  String(float v, unsigned d = 2) { char b[40]; snprintf(b, 40, "%.*f", d, v); s=b; }
+  String(double v, unsigned d = 2) { char b[40]; snprintf(b, 40, "%.*f", d, v); s=b; }
+  unsigned length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  bool reserve(unsigned n) { s.reserve(n); return true; }
+  char operator[](unsigned i) const { return i < s.size() ? s[i] : 0; }
+  char& operator[](unsigned i) { return s[i]; }
+  char charAt(unsigned i) const { return (*this)[i]; }
+  int indexOf(char c, unsigned from = 0) const { auto p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+  int indexOf(const String& c, unsigned from = 0) const { auto p = s.find(c.s, from); return p == std::string::npos ? -1 : (int)p; }
+  int lastIndexOf(char c) const { auto p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+  String substring(unsigned a) const { return a >= s.size() ? String() : String(s.substr(a)); }
+  String substring(unsigned a, unsigned b) const { if (a > b) std::swap(a,b); if (a >= s.size()) return String(); return String(s.substr(a, b - a)); }
+  void trim() { size_t a = 0; while (a < s.size() && isspace((unsigned char)s[a])) a++; size_t b = s.size(); while (b > a && isspace((unsigned char)s[b-1])) b--; s = s.substr(a, b - a); }
+  void toUpperCase() { for (auto& c : s) c = toupper(c); }
+  void toLowerCase() { for (auto& c : s) c = tolower(c); }
+  bool startsWith(const String& p) const { return s.compare(0, p.s.size(), p.s) == 0; }
+  bool endsWith(const String& p) const { return s.size() >= p.s.size() && s.compare(s.size()-p.s.size(), p.s.size(), p.s) == 0; }
+  long toInt() const { return atol(s.c_str()); }
+  void replace(const String& a, const String& b) { size_t p = 0; while ((p = s.find(a.s, p)) != std::string::npos) { s.replace(p, a.s.size(), b.s); p += b.s.size(); } }
+  void remove(unsigned i) { if (i < s.size()) s.erase(i); }
+  void remove(unsigned i, unsigned n) { if (i < s.size()) s.erase(i, n); }
+  bool concat(const char* c, unsigned n) { s.append(c, n); return true; }
+  bool concat(const String& c) { s += c.s; return true; }
+  bool concat(char c) { s += c; return true; }
+  bool equals(const String& o) const { return s == o.s; }
+  bool equalsIgnoreCase(const String& o) const { if (s.size()!=o.s.size()) return false; for (size_t i=0;i<s.size();i++) if (tolower(s[i])!=tolower(o.s[i])) return false; return true; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  String& operator+=(const __FlashStringHelper* o) { s += reinterpret_cast<const char*>(o); return *this; }
+  String& operator+=(char c) { s += c; return *this; }
+  String& operator+=(unsigned char v) { s += std::to_string(v); return *this; }
+  String& operator+=(int v) { s += std::to_string(v); return *this; }
+  String& operator+=(unsigned v) { s += std::to_string(v); return *this; }
+  String& operator+=(long v) { s += std::to_string(v); return *this; }
+  String& operator+=(unsigned long v) { s += std::to_string(v); return *this; }
+  String& operator+=(long long v) { s += std::to_string(v); return *this; }
+  String& operator+=(unsigned long long v) { s += std::to_string(v); return *this; }
+  String& operator+=(float v) { s += String(v).s; return *this; }
+  String& operator+=(double v) { s += String(v).s; return *this; }
+  bool operator==(const String& o) const { return s == o.s; }
+  bool operator==(const char* o) const { return s == o; }
+  bool operator==(const __FlashStringHelper* o) const { return s == reinterpret_cast<const char*>(o); }
+  bool operator!=(const String& o) const { return s != o.s; }
+  bool operator!=(const char* o) const { return s != o; }
+  bool operator<(const String& o) const { return s < o.s; }
+  int compareTo(const String& o) const { return s.compare(o.s); }
+};
+inline String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+inline String operator+(const String& a, const char* b) { return String(a.s + b); }
+inline String operator+(const String& a, char b) { return String(a.s + b); }
+inline String operator+(const char* a, const String& b) { return String(std::string(a) + b.s); }
+inline String operator+(const String& a, int b) { return String(a.s + std::to_string(b)); }
+inline String operator+(const String& a, unsigned b) { return String(a.s + std::to_string(b)); }
+inline String operator+(const String& a, unsigned long b) { return String(a.s + std::to_string(b)); }
+inline String operator+(const String& a, const __FlashStringHelper* b) { return String(a.s + reinterpret_cast<const char*>(b)); }
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) { return 1; }
+  virtual size_t write(const uint8_t*, size_t n) { return n; }
+  size_t print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const __FlashStringHelper* s) { return print(reinterpret_cast<const char*>(s)); }
+  size_t print(char c) { return write((const uint8_t*)&c, 1); }
+  size_t print(int, int = DEC) { return 1; }
+  size_t print(unsigned, int = DEC) { return 1; }
+  size_t print(long, int = DEC) { return 1; }
+  size_t print(unsigned long, int = DEC) { return 1; }
+  size_t print(unsigned char, int = DEC) { return 1; }
+  size_t print(double, int = 2) { return 1; }
+  template<class T> size_t println(const T& v) { return print(v); }
+  template<class T> size_t println(const T& v, int b) { return print(v, b); }
+  size_t println() { return 1; }
+  size_t printf(const char*, ...) { return 0; }
+};
+class Stream : public Print {
+ public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+};
+class HardwareSerial : public Stream { public: void begin(unsigned long) {} };
+extern HardwareSerial Serial;
+inline void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr) {}
@@ -0,0 +1,62 @@
+#pragma once
+// Hostová náhrada FS: LittleFS nad mapou v RAM (fs::memfs()), test ji může číst i mazat.
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <vector>
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+namespace fs {
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+struct MemFS { std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files; std::map<std::string, bool> dirs; };
+MemFS& memfs();
+class File : public Stream {
+ public:
+  std::shared_ptr<std::vector<uint8_t>> d; size_t pos = 0; bool wr = false; std::string nm; bool isdir = false; std::vector<std::string> kids; size_t kidPos = 0;
+  explicit operator bool() const { return d != nullptr || isdir; }
+  size_t write(uint8_t b) override { return write(&b, 1); }
+  size_t write(const uint8_t* p, size_t n) override { if (!d || !wr) return 0; if (pos + n > d->size()) d->resize(pos + n); memcpy(d->data() + pos, p, n); pos += n; return n; }
+  int available() override { return d && !wr ? (int)(d->size() - pos) : 0; }
+  int read() override { if (!d || pos >= d->size()) return -1; return (*d)[pos++]; }
+  int peek() { if (!d || pos >= d->size()) return -1; return (*d)[pos]; }
+  size_t read(uint8_t* p, size_t n) { if (!d) return 0; size_t k = std::min(n, d->size() - std::min(pos, d->size())); memcpy(p, d->data() + pos, k); pos += k; return k; }
+  size_t readBytes(char* p, size_t n) { return read((uint8_t*)p, n); }
+  String readStringUntil(char t) { std::string s; int c; while ((c = read()) >= 0 && c != t) s += (char)c; return String(s); }
+  bool seek(uint32_t p, SeekMode m = SeekSet) { if (!d) return false; size_t np = m == SeekSet ? p : m == SeekCur ? pos + p : d->size() + p; if (np > d->size()) return false; pos = np; return true; }
+  size_t position() const { return pos; }
+  size_t size() const { return d ? d->size() : 0; }
+  void flush() {}
+  void close() { d.reset(); isdir = false; }
+  const char* name() const { auto p = nm.rfind('/'); return nm.c_str() + (p == std::string::npos ? 0 : p + 1); }
+  const char* path() const { return nm.c_str(); }
+  bool isDirectory() { return isdir; }
+  File openNextFile() { File f; while (kidPos < kids.size()) { auto it = memfs().files.find(kids[kidPos++]); if (it != memfs().files.end()) { f.d = it->second; f.nm = it->first; return f; } } return f; }
+};
+class FS {
+ public:
+  bool begin(bool = false) { return true; }
+  File open(const String& p, const char* m = FILE_READ, bool = false) { return open(p.c_str(), m); }
+  File open(const char* p, const char* m = FILE_READ, bool = false) {
+    File f; std::string path(p); auto& fs = memfs();
+    if (fs.dirs.count(path)) { f.isdir = true; f.nm = path; for (auto& kv : fs.files) if (kv.first.rfind(path + "/", 0) == 0 && kv.first.find('/', path.size() + 1) == std::string::npos) f.kids.push_back(kv.first); return f; }
+    if (m[0] == 'r') { auto it = fs.files.find(path); if (it == fs.files.end()) return f; f.d = it->second; }
+    else if (m[0] == 'w') { f.d = std::make_shared<std::vector<uint8_t>>(); fs.files[path] = f.d; f.wr = true; }
+    else { auto& v = fs.files[path]; if (!v) v = std::make_shared<std::vector<uint8_t>>(); f.d = v; f.pos = v->size(); f.wr = true; }
+    f.nm = path; return f; }
+  bool exists(const String& p) { return exists(p.c_str()); }
+  bool exists(const char* p) { return memfs().files.count(p) || memfs().dirs.count(p); }
+  bool remove(const String& p) { return remove(p.c_str()); }
+  bool remove(const char* p) { return memfs().files.erase(p) > 0; }
+  bool rename(const String& a, const String& b) { return rename(a.c_str(), b.c_str()); }
+  bool rename(const char* a, const char* b) { auto& fs = memfs().files; auto it = fs.find(a); if (it == fs.end()) return false; auto v = it->second; fs.erase(it); fs[b] = v; return true; }
+  bool mkdir(const String& p) { return mkdir(p.c_str()); }
+  bool mkdir(const char* p) { memfs().dirs[p] = true; return true; }
+  bool rmdir(const char* p) { return memfs().dirs.erase(p) > 0; }
+  size_t totalBytes() { return 0; }
+  size_t usedBytes() { return 0; }
+};
+}
+using fs::File;
+using fs::FS;
+using fs::SeekSet; using fs::SeekCur; using fs::SeekEnd;
@@ -0,0 +1,23 @@
+#pragma once
+// Hostová náhrada NVS (Preferences) nad mapami v RAM; writes() počítá zápisy (opotřebení).
+#include <map>
+#include <string>
+#include <Arduino.h>
+class Preferences {
+ public:
+  std::map<std::string, uint32_t> u32;
+  std::map<std::string, std::string> strs;
+  uint32_t writes = 0;
+  bool begin(const char*, bool) { return true; }
+  void end() {}
+  bool getBool(const char* k, bool d) { return getUInt(k, d) != 0; }
+  size_t putBool(const char* k, bool v) { return putUInt(k, v) ? 1 : 0; }
+  int32_t getInt(const char* k, int32_t d) { return static_cast<int32_t>(getUInt(k, static_cast<uint32_t>(d))); }
+  size_t putInt(const char* k, int32_t v) { return putUInt(k, static_cast<uint32_t>(v)); }
+  uint16_t getUShort(const char* k, uint16_t d) { return static_cast<uint16_t>(getUInt(k, d)); }
+  size_t putUShort(const char* k, uint16_t v) { return putUInt(k, v) ? 2 : 0; }
+  uint32_t getUInt(const char* k, uint32_t d) { auto it = u32.find(k); return it == u32.end() ? d : it->second; }
+  size_t putUInt(const char* k, uint32_t v) { u32[k] = v; writes++; return 4; }
+  String getString(const char* k, const String& d) { auto it = strs.find(k); return it == strs.end() ? d : String(it->second.c_str()); }
+  size_t putString(const char* k, const String& v) { strs[k] = v.c_str(); writes++; return v.length(); }
+};
@@ -0,0 +1,20 @@
+// Definice globálů hostových náhrad (Serial, LittleFS, falešné hodiny).
+#include <Arduino.h>
+#include <LittleFS.h>
+
+fs::MemFS &fs::memfs() { static MemFS m; return m; }
+HardwareSerial Serial;
+fs::FS LittleFS;
+
+uint32_t g_fakeMillis = 0;
+uint32_t g_fakeMicros = 0;
+uint32_t millis() { return g_fakeMillis; }
+uint32_t micros() { return g_fakeMicros; }
+void delay(uint32_t ms) { g_fakeMillis += ms; }
+void yield() {}
+int digitalRead(uint8_t) { return HIGH; }
+void digitalWrite(uint8_t, uint8_t) {}
+void pinMode(uint8_t, uint8_t) {}
+void attachInterrupt(uint8_t, void (*)(), int) {}
+void noInterrupts() {}
+void interrupts() {}